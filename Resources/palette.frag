@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform usampler2D indexTexture;
+uniform sampler2D paletteTexture;
+uniform int emphasis;
+
+void main()
+{
+    uint index = texture(indexTexture, TexCoord).r & 0x3Fu;
+    FragColor = texelFetch(paletteTexture, ivec2(int(index), emphasis), 0);
+}
\ No newline at end of file
@@ -1,13 +1,41 @@
 #include "mapper.h"
-#include "mapper0.h"
+#include "console.h"
+#include <cassert>
 
 uint8_t Mapper::memGet(uint16_t addr, bool peek) { return 0; };
 void Mapper::memSet(uint16_t addr, uint8_t val) {};
 uint8_t Mapper::PPUmemGet(uint16_t addr, bool peek) { return 0; };
 void Mapper::PPUmemSet(uint16_t addr, uint8_t val) {};
-void Mapper::loadData(std::ifstream &file) {};
 void Mapper::powerOn() {};
 void Mapper::reset() {};
 void Mapper::CPUstep() {};
 void Mapper::PPUstep() {};
-void Mapper::PPUbusAddrChanged(uint16_t newAddr) {};
\ No newline at end of file
+void Mapper::PPUbusAddrChanged(uint16_t newAddr) {};
+bool Mapper::clockedByPPU() { return false; };
+bool Mapper::watchesPPUfetches() { return false; };
+unsigned int Mapper::PRGbank(uint16_t /*addr*/) { return 0; };
+unsigned int Mapper::CHRbank(uint16_t addr) { return (addr % 0x2000) / 0x400; };
+
+void Mapper::mapPRG(unsigned int first, unsigned int count, ROMSpan mem, size_t offset)
+{
+    //An empty span has nothing for offsets to wrap around. GAMEPAK::loadROM turns down images without PRG,
+    //and mappers put CHR RAM in place of missing CHR
+    assert(mem.size > 0);
+    for(unsigned int page = 0; page < count; ++page) {
+        const uint8_t *start = mem.data + (offset + page * 0x2000) % mem.size;
+        PRGpages[first + page] = start;
+        console.cpu.mapMemory(0x8000 + (first + page) * 0x2000, 0x2000, start, 0x2000);
+    }
+}
+
+void Mapper::mapCHR(unsigned int first, unsigned int count, ROMSpan mem, size_t offset)
+{
+    assert(mem.size > 0);
+    for(unsigned int page = 0; page < count; ++page)
+        CHRpages[first + page] = mem.data + (offset + page * 0x400) % mem.size;
+}
+
+void Mapper::mirrorNametables(uint8_t *VRAM, unsigned int nt0, unsigned int nt1, unsigned int nt2, unsigned int nt3)
+{
+    nametables = {VRAM + nt0 * 0x400, VRAM + nt1 * 0x400, VRAM + nt2 * 0x400, VRAM + nt3 * 0x400};
+}
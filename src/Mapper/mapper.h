@@ -1,10 +1,36 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 #include "gamepak.h"
+#include "romimage.h"
+#include <array>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+//Cache line aligned storage for cartridge RAM
+template<class T>
+struct CacheAlignedAllocator {
+    using value_type = T;
+    static const size_t ALIGNMENT = 64;
+
+    CacheAlignedAllocator() = default;
+    template<class U> CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+    T *allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(ALIGNMENT))); }
+    void deallocate(T *p, size_t) { ::operator delete(p, std::align_val_t(ALIGNMENT)); }
+    template<class U> bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+    template<class U> bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+using ROMBuffer = std::vector<uint8_t, CacheAlignedAllocator<uint8_t>>;
+
+class Console;
 
 class Mapper {
     public:
+    explicit Mapper(Console &console) : console(console) {}
+    virtual ~Mapper() = default;
+
     //Memory access functions for CPU mappable memory banks 0x4020 - 0xFFFF (PRGROM/PRGRAM)
     //0x4020-0x5FFF often empty (open bus behavior)
     //0x6000-0x7FFF normally PRGRAM
@@ -19,9 +45,6 @@ class Mapper {
     virtual uint8_t PPUmemGet(uint16_t addr, bool peek = false);
     virtual void PPUmemSet(uint16_t addr, uint8_t val);
 
-    //Load rom file into memory
-    virtual void loadData(std::ifstream &file);
-
     //Handles mapper behavior at powerOn or reset
     virtual void powerOn();
     virtual void reset();
@@ -32,5 +55,75 @@ class Mapper {
 
     //For mappers which react to changes to A12 or other signals
     virtual void PPUbusAddrChanged(uint16_t newAddr);
+
+    //True while PPUstep or PPUbusAddrChanged can have effects the CPU can see (eg IRQs)
+    //The PPU then has to run in lockstep with the CPU instead of catching up on register access
+    //Checked again after every mapper register write
+    virtual bool clockedByPPU();
+
+    //True if the mapper reacts to the order or timing of PPU fetches (eg A12 counters)
+    //The PPU then renders dot by dot instead of a scanline at a time
+    virtual bool watchesPPUfetches();
+
+    //Number of the PRG bank currently mapped at addr, in the mapper's own bank size
+    //Used to tell apart code that runs at the same address from different banks
+    virtual unsigned int PRGbank(uint16_t addr);
+
+    //Number of the 1KB CHR bank currently mapped at pattern table address addr
+    //Keys the PPU's decoded tile cache, so it has to be unique for each 1KB of CHR
+    virtual unsigned int CHRbank(uint16_t addr);
+
+    //Pages below, for GAMEPAK to read the PPU's fetches through when the mapper doesn't watch them
+    const uint8_t *const *CHRpageTable() const { return CHRpages.data(); }
+    const uint8_t *const *nametablePageTable() const { return nametables.data(); }
+
+    protected:
+    Console &console;	//Console the cartridge is plugged into
+
+    //PRG and CHR ROM are read straight out of the ROM image, RAM is one flat buffer apiece. The pages
+    //below point into them and are only moved when a bank register is written, so an access is a
+    //single lookup
+    std::array<const uint8_t*, 4> PRGpages{};	//8KB each, 0x8000-0xFFFF
+    std::array<const uint8_t*, 8> CHRpages{};	//1KB each, 0x0000-0x1FFF
+    std::array<uint8_t*, 4> nametables{};	//1KB each, 0x2000-0x2FFF and mirrored up to 0x3EFF
+
+    //Point count pages, starting at page first, at mem from byte offset on
+    //Offsets wrap around the buffer like bank numbers wrap on the cartridge. PRG pages also go into
+    //the CPU's page table. mem can't be empty
+    void mapPRG(unsigned int first, unsigned int count, ROMSpan mem, size_t offset);
+    void mapCHR(unsigned int first, unsigned int count, ROMSpan mem, size_t offset);
+    //Each argument picks the 1KB of VRAM seen at 0x2000, 0x2400, 0x2800 and 0x2C00
+    void mirrorNametables(uint8_t *VRAM, unsigned int nt0, unsigned int nt1, unsigned int nt2, unsigned int nt3);
+
+    uint8_t PRGread(uint16_t addr) const { return PRGpages[(addr >> 13) & 3][addr & 0x1FFF]; }
+    uint8_t CHRbyte(uint16_t addr) const { return CHRpages[(addr >> 10) & 7][addr & 0x3FF]; }
+    //Pages only give read access, so CHR RAM is written through the buffer the page points into
+    uint8_t &CHRRAMbyte(ROMBuffer &RAM, uint16_t addr) { return RAM[CHRpages[(addr >> 10) & 7] - RAM.data() + (addr & 0x3FF)]; }
+    uint8_t &nametableByte(uint16_t addr) { return nametables[(addr >> 10) & 3][addr & 0x3FF]; }
+
+    static ROMSpan span(ROMBuffer &mem) { return ROMSpan{mem.data(), mem.size()}; }
 };
 
+//Builds the GAMEPAK::MapperBus for a concrete mapper. Instantiate it from the mapper's own source
+//file (its bus() function) so the calls below can be inlined. Qualified calls skip the vtable, and
+//steps the mapper doesn't override are left null so the CPU loop doesn't call them at all
+template<class M>
+GAMEPAK::MapperBus makeBus()
+{
+    GAMEPAK::MapperBus bus;
+    bus.CPUmemGet = [](Mapper *m, uint16_t addr, bool peek) { return static_cast<M*>(m)->M::memGet(addr, peek); };
+    bus.CPUmemSet = [](Mapper *m, uint16_t addr, uint8_t val) { static_cast<M*>(m)->M::memSet(addr, val); };
+    bus.PPUmemGet = [](Mapper *m, uint16_t addr, bool peek) { return static_cast<M*>(m)->M::PPUmemGet(addr, peek); };
+    bus.PPUmemSet = [](Mapper *m, uint16_t addr, uint8_t val) { static_cast<M*>(m)->M::PPUmemSet(addr, val); };
+    bus.CPUstep = nullptr;
+    if(!std::is_same<decltype(&M::CPUstep), void (Mapper::*)()>::value)
+        bus.CPUstep = [](Mapper *m) { static_cast<M*>(m)->M::CPUstep(); };
+    bus.PPUstep = nullptr;
+    if(!std::is_same<decltype(&M::PPUstep), void (Mapper::*)()>::value)
+        bus.PPUstep = [](Mapper *m) { static_cast<M*>(m)->M::PPUstep(); };
+    bus.PPUbusAddrChanged = [](Mapper *m, uint16_t newAddr) { static_cast<M*>(m)->M::PPUbusAddrChanged(newAddr); };
+    bus.clockedByPPU = [](Mapper *m) { return static_cast<M*>(m)->M::clockedByPPU(); };
+    bus.watchesPPUfetches = [](Mapper *m) { return static_cast<M*>(m)->M::watchesPPUfetches(); };
+    bus.CHRbank = [](Mapper *m, uint16_t addr) { return static_cast<M*>(m)->M::CHRbank(addr); };
+    return bus;
+}
@@ -1,47 +1,52 @@
 #include "mapper0.h"
-#include "ppu.h"
-#include "cpu.h"
+#include "console.h"
 #include "utils.h"
 #include <iostream>
 #include <algorithm>
 
-Mapper0::Mapper0(GAMEPAK::ROMInfo romInfo, std::ifstream &file)
+Mapper0::Mapper0(Console &console, GAMEPAK::ROMInfo romInfo, ROMSpan PRG, ROMSpan CHRROM) :
+    Mapper(console)
 {
 	vertMirroring = romInfo.mirroringMode;
 	PRGRAM.resize(0x2000); //For compatability, always 8k
-	PRGROM.resize(romInfo.PRGROMsize);
+	PRGROM = PRG;
 	if(romInfo.PRGROMsize > 0x8000)
 		std::cerr << "PRGROM larger than expected. Will ignore extra data" << std::endl;
-	CHR.resize(0x2000); //Always 8k
-	if(romInfo.CHRROMsize == 0)
+	if(CHRROM.size == 0) {
 		usingCHRRAM = true;
+		CHRRAM.resize(0x2000); //Always 8k
+		CHR = span(CHRRAM);
+	}
+	else CHR = CHRROM;
     VRAM.resize(0x800); //Uses standard VRAM
 	
 	std::fill(PRGRAM.begin(), PRGRAM.end(), 0);
-	std::fill(CHR.begin(), CHR.end(), 0);
+	std::fill(CHRRAM.begin(), CHRRAM.end(), 0);
 	std::fill(VRAM.begin(), VRAM.end(), 0);
 
-	loadData(file);
+	mapCHR(0, 8, CHR, 0);
+	if(vertMirroring) mirrorNametables(VRAM.data(), 0, 1, 0, 1);
+	else mirrorNametables(VRAM.data(), 0, 0, 1, 1);
 }
 
 uint8_t Mapper0::memGet(uint16_t addr, bool peek)
 {
-	uint8_t returnedValue = CPU::busVal;
+	uint8_t returnedValue = console.cpu.busVal;
     if(addr >= 0x6000 && addr < 0x8000) {
-		returnedValue = PRGRAM.at(addr - 0x6000);
+		returnedValue = PRGRAM[addr - 0x6000];
 	}
 	else if(addr >= 0x8000) {
-		returnedValue = PRGROM.at((addr - 0x8000) % PRGROM.size());
+		returnedValue = PRGread(addr);
 	}
 	if(peek) return returnedValue;
-	CPU::busVal = returnedValue;
-	return CPU::busVal;
+	console.cpu.busVal = returnedValue;
+	return console.cpu.busVal;
 }
 
 void Mapper0::memSet(uint16_t addr, uint8_t val)
 {
     if(addr >= 0x6000 && addr < 0x8000) {
-		PRGRAM.at(addr - 0x6000) = val;
+		PRGRAM[addr - 0x6000] = val;
 	}
 	else {
 		//std::cerr << "Invalid write attempt to " << int_to_hex(addr) << std::endl;
@@ -54,28 +59,15 @@ uint8_t Mapper0::PPUmemGet(uint16_t addr, bool peek)
     //Mirror addresses higher than 0x3FFF
 	addr %= 0x4000;
 	if(addr < 0x2000) {
-		return CHR.at(addr % CHR.size());
+		return CHRbyte(addr);
 	}
 	else if(addr < 0x3F00) {
-		addr = 0x2000 + addr % 0x1000;
-		if(vertMirroring == 0) { //Horizontal mirroring
-			if(addr < 0x2800)
-				return VRAM.at(addr % 0x0400);
-			else
-				return VRAM.at(0x0400 + addr % 0x0400);
-		}
-		else {	//Vertical mirroring
-			if(addr < 0x2800)
-				return VRAM.at(addr - 0x2000);
-			else
-				return VRAM.at(addr - 0x2800);
-		}
+		return nametableByte(addr);
 	}
-	else if(addr < 0x4000) {
+	else {
 		//Internal to PPU. Never mapped.
-		return PPU::getPalette((uint8_t)(addr % 0x20));
+		return console.ppu.getPalette((uint8_t)(addr % 0x20));
 	}
-    return 0;
 }
 
 void Mapper0::PPUmemSet(uint16_t addr, uint8_t val)
@@ -83,43 +75,27 @@ void Mapper0::PPUmemSet(uint16_t addr, uint8_t val)
     //Mirror addresses higher than 0x3FFF
 	addr %= 0x4000;
 	if(addr < 0x2000) {
-		if(usingCHRRAM)
-			CHR.at(addr % CHR.size()) = val;
+		if(usingCHRRAM) {
+			CHRRAMbyte(CHRRAM, addr) = val;
+			console.ppu.CHRwritten(addr);
+		}
 	}
 	else if(addr < 0x3F00) {
-		addr = 0x2000 + addr % 0x1000;
-		if(vertMirroring == 0) { //Horizontal mirroring
-			if(addr < 0x2800)
-				VRAM.at(addr % 0x0400) = val;
-			else
-				VRAM.at(0x0400 + addr % 0x0400) = val;
-		}
-		else {	//Vertical mirroring
-			if(addr < 0x2800)
-				VRAM.at(addr - 0x2000) = val;
-			else
-				VRAM.at(addr - 0x2800) = val;
-		}
+		nametableByte(addr) = val;
 	}
-	else if(addr < 0x4000) {
+	else {
 		//Internal to PPU. Never mapped.
-		PPU::setPalette((uint8_t)(addr % 0x20), val);
+		console.ppu.setPalette((uint8_t)(addr % 0x20), val);
 	}
 }
 
-void Mapper0::loadData(std::ifstream &file)
+void Mapper0::powerOn()
 {
-	for(unsigned int idx=0; idx < PRGROM.size(); ++idx) {
-		if(file.eof())
-			throw std::out_of_range("Reached EOF unexpectantly while loading ROM");
-		file.read((char*)&PRGROM[idx],1);
-	}
+	console.cpu.mapMemory(0x6000, 0x2000, PRGRAM.data(), PRGRAM.size(), true);
+	mapPRG(0, 4, PRGROM, 0);
+}
 
-	if(usingCHRRAM == false) {
-		for(unsigned int idx=0; idx < CHR.size(); ++idx) {
-			if(file.eof())
-				throw std::out_of_range("Reached EOF unexpectantly while loading ROM");
-			file.read((char*)&CHR[idx],1);
-		}
-	}
-}
\ No newline at end of file
+GAMEPAK::MapperBus Mapper0::bus()
+{
+    return makeBus<Mapper0>();
+}
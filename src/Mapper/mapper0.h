@@ -6,17 +6,20 @@
 #include "mapper.h"
 
 
-class Mapper0 : public Mapper {
+class Mapper0 final : public Mapper {
     protected:
     bool vertMirroring;
     bool usingCHRRAM = false;
-    std::vector<uint8_t> VRAM, PRGROM, CHR, PRGRAM;
+    ROMBuffer VRAM, PRGRAM, CHRRAM;
+    ROMSpan PRGROM, CHR;
 
     public:
-    Mapper0(GAMEPAK::ROMInfo romInfo, std::ifstream &file);
+    Mapper0(Console &console, GAMEPAK::ROMInfo romInfo, ROMSpan PRG, ROMSpan CHRROM);
+    GAMEPAK::MapperBus bus();
     uint8_t memGet(uint16_t addr, bool peek = false) override;
     void memSet(uint16_t addr, uint8_t val) override;
     uint8_t PPUmemGet(uint16_t addr, bool peek = false) override;
     void PPUmemSet(uint16_t addr, uint8_t val) override;
-    void loadData(std::ifstream &file) override;
+
+    void powerOn() override;
 };
\ No newline at end of file
@@ -1,92 +1,50 @@
 #include "mapper1.h"
-#include "ppu.h"
-#include "cpu.h"
+#include "console.h"
 #include <iostream>
 #include <algorithm>
 
 //TODO: Add save ability for battery backed up PRG-RAM
-Mapper1::Mapper1(GAMEPAK::ROMInfo romInfo, std::ifstream &file)
+Mapper1::Mapper1(Console &console, GAMEPAK::ROMInfo romInfo, ROMSpan PRG, ROMSpan CHRROM) :
+    Mapper(console)
 {
+	PRGROM = PRG;
+	usingCHRRAM = (CHRROM.size == 0);
 	if(romInfo.iNESversion == 1) {
 		//Have to assume 8k PRG-RAM. Won't work with a few uncommon games that use bankable PRG-RAM
-		PRGRAM.resize(1, std::vector<uint8_t>(0x2000, 0));
-		PRGROM.resize(romInfo.PRGROMsize / 0x4000, std::vector<uint8_t>(0x4000, 0));
-		if(romInfo.CHRROMsize == 0) {
-			usingCHRRAM = true;
-			CHR.resize(2, std::vector<uint8_t>(0x1000, 0));
-		}
-		else {
-			usingCHRRAM = false;
-			CHR.resize(romInfo.CHRROMsize / 0x1000, std::vector<uint8_t>(0x1000, 0));
-		}
-		VRAM.resize(0x800);
+		PRGRAM.resize(0x2000, 0);
+		if(usingCHRRAM) CHRRAM.resize(0x2000, 0);
 	}
 	else {
 		if(romInfo.batteryPresent && romInfo.PRGNVRAMsize > 0)
-			PRGRAM.resize(romInfo.PRGNVRAMsize / 0x2000, std::vector<uint8_t>(0x2000, 0));
+			PRGRAM.resize(romInfo.PRGNVRAMsize / 0x2000 * 0x2000, 0);
 		else if(romInfo.PRGRAMsize > 0)
-			PRGRAM.resize(romInfo.PRGRAMsize / 0x2000, std::vector<uint8_t>(0x2000, 0));
-		
-		PRGROM.resize(romInfo.PRGROMsize / 0x4000, std::vector<uint8_t>(0x4000, 0));
-		if(romInfo.CHRROMsize == 0) {
-			usingCHRRAM = true;
-			CHR.resize(romInfo.CHRRAMsize / 0x1000, std::vector<uint8_t>(0x1000, 0));
-		}
-		else {
-			usingCHRRAM = false;
-			CHR.resize(romInfo.CHRROMsize / 0x1000, std::vector<uint8_t>(0x1000, 0));
-		}
-		VRAM.resize(0x800);
+			PRGRAM.resize(romInfo.PRGRAMsize / 0x2000 * 0x2000, 0);
+		if(usingCHRRAM) CHRRAM.resize(std::max(romInfo.CHRRAMsize, 0x2000L), 0);
 	}
-
-	std::fill(VRAM.begin(), VRAM.end(), 0);
-
-	loadData(file);
+	CHR = usingCHRRAM ? span(CHRRAM) : CHRROM;
+	VRAM.resize(0x800, 0);
 }
 
 uint8_t Mapper1::memGet(uint16_t addr, bool peek)
 {
-	uint8_t returnedValue = CPU::busVal;
+	uint8_t returnedValue = console.cpu.busVal;
     if(addr >= 0x6000 && addr < 0x8000) {
-		addr -= 0x6000;
 		if(PRGRAM.size() > 0)
-			returnedValue = PRGRAM.at(PRGRAMbank).at(addr);
+			returnedValue = PRGRAM[(PRGRAMbank * 0x2000 + addr - 0x6000) % PRGRAM.size()];
 	}
-	else if(addr >= 0x8000 && addr < 0xC000) {
-		addr -= 0x8000;
-		if(PRGbankmode <= 1) {
-			returnedValue = PRGROM.at(PRGROMbank & 0xE).at(addr);
-		}
-		else if(PRGbankmode == 2) {
-			returnedValue = PRGROM.at(0).at(addr % 0x8000);
-		}
-		else {
-			returnedValue = PRGROM.at(PRGROMbank & 0xF).at(addr);
-		}
-	}
-	else if(addr >= 0xC000) {
-		addr -= 0xC000;
-		if(PRGbankmode <= 1) {
-			returnedValue = PRGROM.at((PRGROMbank & 0xE) + 1).at(addr);
-		}
-		else if(PRGbankmode == 2) {
-			returnedValue = PRGROM.at(PRGROMbank & 0xF).at(addr);
-		}
-		else {
-			returnedValue = PRGROM.back().at(addr);
-		}
+	else if(addr >= 0x8000) {
+		returnedValue = PRGread(addr);
 	}
 	if(peek) return returnedValue;
-	CPU::busVal = returnedValue;
-	return CPU::busVal;
+	console.cpu.busVal = returnedValue;
+	return console.cpu.busVal;
 }
 
 void Mapper1::memSet(uint16_t addr, uint8_t val)
 {
     if(addr >= 0x6000 && addr < 0x8000) {
-		addr -= 0x6000;
 		if(PRGRAM.size() > 0)
-			PRGRAM.at(PRGRAMbank).at(addr) = val;
+			PRGRAM[(PRGRAMbank * 0x2000 + addr - 0x6000) % PRGRAM.size()] = val;
 	}
     else if(addr >= 0x8000) {	//MMC control
 		if((val >> 7) == 1) {	//Clear shift register
@@ -102,15 +60,21 @@ void Mapper1::memSet(uint16_t addr, uint8_t val)
 						mirroringMode = MMCshiftReg & 0x3;
 						PRGbankmode = (MMCshiftReg & 0xC) >> 2;
 						CHRbankmode = (MMCshiftReg & 0x10) >> 4;
+						updateMirroring();
+						updatePRGpages();
+						updateCHRpages();
 						break;
 					case 1:
 						CHRbank0 = MMCshiftReg;
+						updateCHRpages();
 						break;
 					case 2:
 						CHRbank1 = MMCshiftReg;
+						updateCHRpages();
 						break;
 					case 3:
 						PRGROMbank = MMCshiftReg;
+						updatePRGpages();
 						break;
 				}
 				MMCshiftReg = 0;
@@ -122,129 +86,36 @@ void Mapper1::memSet(uint16_t addr, uint8_t val)
 
 uint8_t Mapper1::PPUmemGet(uint16_t addr, bool peek)
 {
-	try {
     //Mirror addresses higher than 0x3FFF
 	addr %= 0x4000;
-	if(addr < 0x1000) {
-		if(CHRbankmode == 0) {
-			return CHR.at(CHRbank0 & 0x1E).at(addr);
-		}
-		else {
-			return CHR.at(CHRbank0).at(addr);
-		}
-	}
-	else if(addr < 0x2000) {
-		if(CHRbankmode == 0) {
-			return CHR.at((CHRbank0 & 0x1E) + 1).at(addr % 0x1000);
-		}
-		else {
-			return CHR.at(CHRbank1).at(addr % 0x1000);
-		}
+	if(addr < 0x2000) {
+		return CHRbyte(addr);
 	}
 	else if(addr < 0x3F00) {
-		if(addr > 0x2FFF) addr -= 0x1000;
-		if(mirroringMode == 0) {
-			return VRAM.at(addr % 0x0400);
-		}
-		else if(mirroringMode == 1) {
-			return VRAM.at((addr % 0x0400) + 0x400);
-		}
-		else if(mirroringMode == 2) {
-			if(addr < 0x2800)
-				return VRAM.at(addr - 0x2000);
-			else
-				return VRAM.at(addr - 0x2800);
-		}
-		else {
-			if(addr < 0x2800)
-				return VRAM.at(addr % 0x0400);
-			else
-				return VRAM.at(0x0400 + addr % 0x0400);
-		}
+		return nametableByte(addr);
 	}
-	else if(addr < 0x4000) {
+	else {
 		//Internal to PPU. Never mapped.
-		return PPU::getPalette((uint8_t)(addr % 0x20));
-	}
+		return console.ppu.getPalette((uint8_t)(addr % 0x20));
 	}
-	catch(const std::out_of_range err)
-	{
-		std::cerr << "Out of range error when trying to get addr: " << addr << std::endl;
-	}
-    return 0;
 }
 
 void Mapper1::PPUmemSet(uint16_t addr, uint8_t val)
 {
-	try {
     //Mirror addresses higher than 0x3FFF
 	addr %= 0x4000;
-	if(addr < 0x1000) {
-		if(CHRbankmode == 0) {
-			CHR.at(CHRbank0 & 0x1E).at(addr) = val;
-		}
-		else {
-			CHR.at(CHRbank0).at(addr) = val;
-		}
-	}
-	else if(addr < 0x2000) {
-		if(CHRbankmode == 0) {
-			CHR.at((CHRbank0 & 0x1E) + 1).at(addr % 0x1000) = val;
-		}
-		else {
-			CHR.at(CHRbank1).at(addr % 0x1000) = val;
+	if(addr < 0x2000) {
+		if(usingCHRRAM) {
+			CHRRAMbyte(CHRRAM, addr) = val;
+			console.ppu.CHRwritten(addr);
 		}
 	}
 	else if(addr < 0x3F00) {
-		if(addr > 0x2FFF) addr -= 0x1000;
-		if(mirroringMode == 0) {
-			VRAM.at(addr % 0x0400) = val;
-		}
-		else if(mirroringMode == 1) {
-			VRAM.at((addr % 0x0400) + 0x400) = val;
-		}
-		else if(mirroringMode == 2) {
-			if(addr < 0x2800)
-				VRAM.at(addr - 0x2000) = val;
-			else
-				VRAM.at(addr - 0x2800) = val;
-		}
-		else {
-			if(addr < 0x2800)
-				VRAM.at(addr % 0x0400) = val;
-			else
-				VRAM.at(0x0400 + addr % 0x0400) = val;
-		}
+		nametableByte(addr) = val;
 	}
-	else if(addr < 0x4000) {
+	else {
 		//Internal to PPU. Never mapped.
-		PPU::setPalette((uint8_t)(addr % 0x20), val);
-	}
-	}
-	catch(const std::out_of_range err)
-	{
-		std::cerr << "Out of range error when trying to set addr: " << addr << std::endl;
-	}
-}
-
-void Mapper1::loadData(std::ifstream &file)
-{
-	for(unsigned int bank=0; bank < PRGROM.size(); ++bank) {
-		for(unsigned int idx=0; idx < PRGROM[bank].size(); ++idx) {
-			if(file.eof())
-				throw std::out_of_range("Reached EOF unexpectantly while loading ROM");
-			file.read((char*)&PRGROM[bank][idx],1);
-		}
-	}
-
-	if(usingCHRRAM == false) {
-		for(unsigned int bank=0; bank < CHR.size(); ++bank) {
-			for(unsigned int idx=0; idx < CHR[bank].size(); ++idx) {
-				if(file.eof())
-					throw std::out_of_range("Reached EOF unexpectantly while loading ROM");
-				file.read((char*)&CHR[bank][idx],1);
-			}
-		}
+		console.ppu.setPalette((uint8_t)(addr % 0x20), val);
 	}
 }
 
@@ -257,4 +128,68 @@ void Mapper1::powerOn()
 	PRGRAMbank = PRGROMbank = 0;
 	MMCshiftReg = 0;
 	writeCounter = 0;
-}
\ No newline at end of file
+	updateMirroring();
+	updatePRGpages();
+	updateCHRpages();
+}
+
+void Mapper1::updatePRGpages()
+{
+	if(PRGRAM.size() > 0)
+		console.cpu.mapMemory(0x6000, 0x2000, &PRGRAM[(PRGRAMbank * 0x2000) % PRGRAM.size()], 0x2000, true);
+
+	//16KB banks at 0x8000 and 0xC000
+	unsigned int lowBank, highBank;
+	if(PRGbankmode <= 1) {
+		lowBank = PRGROMbank & 0xE;
+		highBank = (PRGROMbank & 0xE) + 1;
+	}
+	else if(PRGbankmode == 2) {
+		lowBank = 0;
+		highBank = PRGROMbank & 0xF;
+	}
+	else {
+		lowBank = PRGROMbank & 0xF;
+		highBank = PRGROM.size / 0x4000 - 1;
+	}
+	mapPRG(0, 2, PRGROM, lowBank * 0x4000);
+	mapPRG(2, 2, PRGROM, highBank * 0x4000);
+}
+
+void Mapper1::updateCHRpages()
+{
+	//4KB banks, or one 8KB bank when CHRbankmode is 0
+	if(CHRbankmode == 0) {
+		mapCHR(0, 8, CHR, (CHRbank0 & 0x1E) * 0x1000);
+	}
+	else {
+		mapCHR(0, 4, CHR, CHRbank0 * 0x1000);
+		mapCHR(4, 4, CHR, CHRbank1 * 0x1000);
+	}
+}
+
+void Mapper1::updateMirroring()
+{
+	switch(mirroringMode) {
+		case 0: mirrorNametables(VRAM.data(), 0, 0, 0, 0); break;	//One screen, lower
+		case 1: mirrorNametables(VRAM.data(), 1, 1, 1, 1); break;	//One screen, upper
+		case 2: mirrorNametables(VRAM.data(), 0, 1, 0, 1); break;	//Vertical
+		default: mirrorNametables(VRAM.data(), 0, 0, 1, 1); break;	//Horizontal
+	}
+}
+
+unsigned int Mapper1::PRGbank(uint16_t addr)
+{
+	if(addr < 0x8000) return 0;
+	return (PRGpages[(addr >> 13) & 3] - PRGROM.data) / 0x4000;
+}
+
+unsigned int Mapper1::CHRbank(uint16_t addr)
+{
+	return (CHRpages[(addr >> 10) & 7] - CHR.data) / 0x400;
+}
+
+GAMEPAK::MapperBus Mapper1::bus()
+{
+    return makeBus<Mapper1>();
+}
@@ -6,23 +6,30 @@
 #include "mapper.h"
 
 
-class Mapper1 : public Mapper {
+class Mapper1 final : public Mapper {
     protected:
     uint8_t mirroringMode, PRGbankmode, CHRbankmode;
-    std::vector<uint8_t> VRAM;
-    std::vector<std::vector<uint8_t>> PRGROM, PRGRAM, CHR;
+    ROMBuffer VRAM, PRGRAM, CHRRAM;
+    ROMSpan PRGROM, CHR;
     uint8_t CHRbank0, CHRbank1, PRGRAMbank, PRGROMbank;
     uint8_t MMCshiftReg;
     int writeCounter;
     bool usingCHRRAM = false;
 
+    void updatePRGpages();
+    void updateCHRpages();
+    void updateMirroring();
+
     public:
-    Mapper1(GAMEPAK::ROMInfo romInfo, std::ifstream &file);
+    Mapper1(Console &console, GAMEPAK::ROMInfo romInfo, ROMSpan PRG, ROMSpan CHRROM);
+    GAMEPAK::MapperBus bus();
     uint8_t memGet(uint16_t addr, bool peek = false) override;
     void memSet(uint16_t addr, uint8_t val) override;
     uint8_t PPUmemGet(uint16_t addr, bool peek = false) override;
     void PPUmemSet(uint16_t addr, uint8_t val) override;
-    void loadData(std::ifstream &file) override;
 
     void powerOn() override;
+
+    unsigned int PRGbank(uint16_t addr) override;
+    unsigned int CHRbank(uint16_t addr) override;
 };
\ No newline at end of file
@@ -1,52 +1,50 @@
 #include "mapper2.h"
-#include "ppu.h"
-#include "cpu.h"
+#include "console.h"
 #include "utils.h"
 #include <iostream>
 #include <algorithm>
 
-Mapper2::Mapper2(GAMEPAK::ROMInfo romInfo, std::ifstream &file)
+Mapper2::Mapper2(Console &console, GAMEPAK::ROMInfo romInfo, ROMSpan PRG, ROMSpan CHRROM) :
+    Mapper(console)
 {
 	vertMirroring = romInfo.mirroringMode;
 
-    PRGROM.resize(romInfo.PRGROMsize / 0x4000, std::vector<uint8_t>(0x4000, 0));
-    if(romInfo.CHRROMsize > 0) {
+    PRGROM = PRG;
+    if(CHRROM.size > 0) {
         usingCHRRAM = false;
-        CHR.resize(romInfo.CHRROMsize);
+        CHR = CHRROM;
     }
     else {
         usingCHRRAM = true;
-        CHR.resize(0x2000);
+        CHRRAM.resize(0x2000, 0);
+        CHR = span(CHRRAM);
     }
 	
     VRAM.resize(0x800); //Uses standard VRAM
-
-    std::fill(CHR.begin(), CHR.end(), 0);
 	std::fill(VRAM.begin(), VRAM.end(), 0);
 
-	loadData(file);
-
     PRGROMbank = 0;
+	mapCHR(0, 8, CHR, 0);
+	if(vertMirroring) mirrorNametables(VRAM.data(), 0, 1, 0, 1);
+	else mirrorNametables(VRAM.data(), 0, 0, 1, 1);
 }
 
 uint8_t Mapper2::memGet(uint16_t addr, bool peek)
 {
-	uint8_t returnedValue = CPU::busVal;
-	if(addr >= 0x8000 && addr < 0xC000) {
-		returnedValue = PRGROM.at(PRGROMbank).at((addr - 0x8000) % 0x4000);
+	uint8_t returnedValue = console.cpu.busVal;
+	if(addr >= 0x8000) {
+		returnedValue = PRGread(addr);
 	}
-    else if(addr >= 0xC000) {
-        returnedValue = PRGROM.back().at((addr - 0xC000) % 0x4000);
-    }
 	if(peek) return returnedValue;
-	CPU::busVal = returnedValue;
-	return CPU::busVal;
+	console.cpu.busVal = returnedValue;
+	return console.cpu.busVal;
 }
 
 void Mapper2::memSet(uint16_t addr, uint8_t val)
 {
     if(addr >= 0x8000) {
-        PRGROMbank = val % PRGROM.size();
+        PRGROMbank = val % (PRGROM.size / 0x4000);
+        updatePRGpages();
     }
 }
 
@@ -55,29 +53,15 @@ uint8_t Mapper2::PPUmemGet(uint16_t addr, bool peek)
     //Mirror addresses higher than 0x3FFF
 	addr %= 0x4000;
 	if(addr < 0x2000) {
-        //Bankable CHR
-		return CHR.at(addr);
+		return CHRbyte(addr);
 	}
 	else if(addr < 0x3F00) {
-		addr = 0x2000 + addr % 0x1000;
-		if(vertMirroring == 0) { //Horizontal mirroring
-			if(addr < 0x2800)
-				return VRAM.at(addr % 0x0400);
-			else
-				return VRAM.at(0x0400 + addr % 0x0400);
-		}
-		else {	//Vertical mirroring
-			if(addr < 0x2800)
-				return VRAM.at(addr - 0x2000);
-			else
-				return VRAM.at(addr - 0x2800);
-		}
+		return nametableByte(addr);
 	}
-	else if(addr < 0x4000) {
+	else {
 		//Internal to PPU. Never mapped.
-		return PPU::getPalette((uint8_t)(addr % 0x20));
+		return console.ppu.getPalette((uint8_t)(addr % 0x20));
 	}
-    return 0;
 }
 
 void Mapper2::PPUmemSet(uint16_t addr, uint8_t val)
@@ -85,49 +69,40 @@ void Mapper2::PPUmemSet(uint16_t addr, uint8_t val)
     //Mirror addresses higher than 0x3FFF
 	addr %= 0x4000;
 	if(addr < 0x2000) {
-		CHR.at(addr) = val;
+		if(usingCHRRAM) {
+			CHRRAMbyte(CHRRAM, addr) = val;
+			console.ppu.CHRwritten(addr);
+		}
 	}
 	else if(addr < 0x3F00) {
-		addr = 0x2000 + addr % 0x1000;
-		if(vertMirroring == 0) { //Horizontal mirroring
-			if(addr < 0x2800)
-				VRAM.at(addr % 0x0400) = val;
-			else
-				VRAM.at(0x0400 + addr % 0x0400) = val;
-		}
-		else {	//Vertical mirroring
-			if(addr < 0x2800)
-				VRAM.at(addr - 0x2000) = val;
-			else
-				VRAM.at(addr - 0x2800) = val;
-		}
+		nametableByte(addr) = val;
 	}
-	else if(addr < 0x4000) {
+	else {
 		//Internal to PPU. Never mapped.
-		PPU::setPalette((uint8_t)(addr % 0x20), val);
+		console.ppu.setPalette((uint8_t)(addr % 0x20), val);
 	}
 }
 
-void Mapper2::loadData(std::ifstream &file)
+void Mapper2::powerOn()
 {
-	for(unsigned int bank=0; bank < PRGROM.size(); ++bank) {
-		for(unsigned int idx=0; idx < PRGROM[bank].size(); ++idx) {
-			if(file.eof())
-				throw std::out_of_range("Reached EOF unexpectantly while loading ROM");
-			file.read((char*)&PRGROM[bank][idx],1);
-		}
-	}
+	PRGROMbank = 0;
+	updatePRGpages();
+}
 
-	if(usingCHRRAM == false) {
-		for(unsigned int idx=0; idx < CHR.size(); ++idx) {
-			if(file.eof())
-				throw std::out_of_range("Reached EOF unexpectantly while loading ROM");
-			file.read((char*)&CHR[idx],1);
-		}
-	}
+void Mapper2::updatePRGpages()
+{
+	//Switchable 16KB bank at 0x8000, last bank fixed at 0xC000
+	mapPRG(0, 2, PRGROM, PRGROMbank * 0x4000);
+	mapPRG(2, 2, PRGROM, PRGROM.size - 0x4000);
 }
 
-void Mapper2::powerOn()
+unsigned int Mapper2::PRGbank(uint16_t addr)
 {
-	PRGROMbank = 0;
-}
\ No newline at end of file
+	if(addr < 0x8000) return 0;
+	return (PRGpages[(addr >> 13) & 3] - PRGROM.data) / 0x4000;
+}
+
+GAMEPAK::MapperBus Mapper2::bus()
+{
+    return makeBus<Mapper2>();
+}
@@ -6,21 +6,25 @@
 #include "mapper.h"
 
 
-class Mapper2 : public Mapper {
+class Mapper2 final : public Mapper {
     protected:
     uint8_t vertMirroring;
-    std::vector<uint8_t> VRAM, CHR;
-    std::vector<std::vector<uint8_t>> PRGROM;
+    ROMBuffer VRAM, CHRRAM;
+    ROMSpan PRGROM, CHR;
     uint8_t PRGROMbank;
     bool usingCHRRAM = false;
 
+    void updatePRGpages();
+
     public:
-    Mapper2(GAMEPAK::ROMInfo romInfo, std::ifstream &file);
+    Mapper2(Console &console, GAMEPAK::ROMInfo romInfo, ROMSpan PRG, ROMSpan CHRROM);
+    GAMEPAK::MapperBus bus();
     uint8_t memGet(uint16_t addr, bool peek = false) override;
     void memSet(uint16_t addr, uint8_t val) override;
     uint8_t PPUmemGet(uint16_t addr, bool peek = false) override;
     void PPUmemSet(uint16_t addr, uint8_t val) override;
-    void loadData(std::ifstream &file) override;
 
     void powerOn() override;
+
+    unsigned int PRGbank(uint16_t addr) override;
 };
\ No newline at end of file
@@ -1,39 +1,47 @@
 #include "mapper3.h"
-#include "ppu.h"
-#include "cpu.h"
+#include "console.h"
 #include "utils.h"
 #include <iostream>
 #include <algorithm>
 
-Mapper3::Mapper3(GAMEPAK::ROMInfo romInfo, std::ifstream &file)
+Mapper3::Mapper3(Console &console, GAMEPAK::ROMInfo romInfo, ROMSpan PRG, ROMSpan CHRROM) :
+    Mapper(console)
 {
 	vertMirroring = romInfo.mirroringMode;
-	PRGROM.resize(romInfo.PRGROMsize);
+	PRGROM = PRG;
 	if(romInfo.PRGROMsize > 0x8000)
 		std::cerr << "PRGROM larger than expected. Will ignore extra data" << std::endl;
-	CHRROM.resize(romInfo.CHRROMsize / 0x2000, std::vector<uint8_t>(0x2000, 0));
+	if(CHRROM.size == 0) {
+		//Boards without CHR ROM have 8k of RAM in its place, like NROM
+		usingCHRRAM = true;
+		CHRRAM.resize(0x2000, 0);
+		CHR = span(CHRRAM);
+	}
+	else CHR = CHRROM;
     VRAM.resize(0x800); //Uses standard VRAM
 
 	std::fill(VRAM.begin(), VRAM.end(), 0);
 
-	loadData(file);
+	if(vertMirroring) mirrorNametables(VRAM.data(), 0, 1, 0, 1);
+	else mirrorNametables(VRAM.data(), 0, 0, 1, 1);
 }
 
 uint8_t Mapper3::memGet(uint16_t addr, bool peek)
 {
-	uint8_t returnedValue = CPU::busVal;
+	uint8_t returnedValue = console.cpu.busVal;
 	if(addr >= 0x8000) {
-		returnedValue = PRGROM.at((addr - 0x8000) % PRGROM.size());
+		returnedValue = PRGread(addr);
 	}
 	if(peek) return returnedValue;
-	CPU::busVal = returnedValue;
-	return CPU::busVal;
+	console.cpu.busVal = returnedValue;
+	return console.cpu.busVal;
 }
 
 void Mapper3::memSet(uint16_t addr, uint8_t val)
 {
-    if(addr >= 0x8000) {
-        CHRbank = val % CHRROM.size();
+    if(addr >= 0x8000 && CHR.size >= 0x2000) {
+        CHRROMbank = val % (CHR.size / 0x2000);
+        mapCHR(0, 8, CHR, CHRROMbank * 0x2000);
     }
 }
 
@@ -43,28 +51,15 @@ uint8_t Mapper3::PPUmemGet(uint16_t addr, bool peek)
 	addr %= 0x4000;
 	if(addr < 0x2000) {
         //Bankable CHR
-		return CHRROM.at(CHRbank).at(addr);
+		return CHRbyte(addr);
 	}
 	else if(addr < 0x3F00) {
-		addr = 0x2000 + addr % 0x1000;
-		if(vertMirroring == 0) { //Horizontal mirroring
-			if(addr < 0x2800)
-				return VRAM.at(addr % 0x0400);
-			else
-				return VRAM.at(0x0400 + addr % 0x0400);
-		}
-		else {	//Vertical mirroring
-			if(addr < 0x2800)
-				return VRAM.at(addr - 0x2000);
-			else
-				return VRAM.at(addr - 0x2800);
-		}
+		return nametableByte(addr);
 	}
-	else if(addr < 0x4000) {
+	else {
 		//Internal to PPU. Never mapped.
-		return PPU::getPalette((uint8_t)(addr % 0x20));
+		return console.ppu.getPalette((uint8_t)(addr % 0x20));
 	}
-    return 0;
 }
 
 void Mapper3::PPUmemSet(uint16_t addr, uint8_t val)
@@ -72,48 +67,34 @@ void Mapper3::PPUmemSet(uint16_t addr, uint8_t val)
     //Mirror addresses higher than 0x3FFF
 	addr %= 0x4000;
 	if(addr < 0x2000) {
-		//CHRROM not writable
-		//std::cerr << "Invalid write attempt to " << int_to_hex(addr) << std::endl;
+		//CHRROM not writable, CHRRAM is
+		if(usingCHRRAM) {
+			CHRRAMbyte(CHRRAM, addr) = val;
+			console.ppu.CHRwritten(addr);
+		}
 	}
 	else if(addr < 0x3F00) {
-		addr = 0x2000 + addr % 0x1000;
-		if(vertMirroring == 0) { //Horizontal mirroring
-			if(addr < 0x2800)
-				VRAM.at(addr % 0x0400) = val;
-			else
-				VRAM.at(0x0400 + addr % 0x0400) = val;
-		}
-		else {	//Vertical mirroring
-			if(addr < 0x2800)
-				VRAM.at(addr - 0x2000) = val;
-			else
-				VRAM.at(addr - 0x2800) = val;
-		}
+		nametableByte(addr) = val;
 	}
-	else if(addr < 0x4000) {
+	else {
 		//Internal to PPU. Never mapped.
-		PPU::setPalette((uint8_t)(addr % 0x20), val);
+		console.ppu.setPalette((uint8_t)(addr % 0x20), val);
 	}
 }
 
-void Mapper3::loadData(std::ifstream &file)
+unsigned int Mapper3::CHRbank(uint16_t addr)
 {
-	for(unsigned int idx=0; idx < PRGROM.size(); ++idx) {
-		if(file.eof())
-			throw std::out_of_range("Reached EOF unexpectantly while loading ROM");
-		file.read((char*)&PRGROM[idx],1);
-	}
-
-	for(unsigned int bank=0; bank < CHRROM.size(); ++bank) {
-		for(unsigned int idx=0; idx < CHRROM[bank].size(); ++idx) {
-			if(file.eof())
-				throw std::out_of_range("Reached EOF unexpectantly while loading ROM");
-			file.read((char*)&CHRROM[bank][idx],1);
-		}
-	}
+	return (CHRpages[(addr >> 10) & 7] - CHR.data) / 0x400;
 }
 
 void Mapper3::powerOn()
 {
-	CHRbank = 0;
-}
\ No newline at end of file
+	CHRROMbank = 0;
+	mapCHR(0, 8, CHR, 0);
+	mapPRG(0, 4, PRGROM, 0);
+}
+
+GAMEPAK::MapperBus Mapper3::bus()
+{
+    return makeBus<Mapper3>();
+}
@@ -6,19 +6,22 @@
 #include "mapper.h"
 
 
-class Mapper3 : public Mapper {
+class Mapper3 final : public Mapper {
     protected:
     bool vertMirroring;
-    std::vector<uint8_t> VRAM, PRGROM;
-    std::vector<std::vector<uint8_t>> CHRROM;
-    uint8_t CHRbank;
+    bool usingCHRRAM = false;
+    ROMBuffer VRAM, CHRRAM;
+    ROMSpan PRGROM, CHR;
+    uint8_t CHRROMbank;
 
     public:
-    Mapper3(GAMEPAK::ROMInfo romInfo, std::ifstream &file);
+    Mapper3(Console &console, GAMEPAK::ROMInfo romInfo, ROMSpan PRG, ROMSpan CHRROM);
+    GAMEPAK::MapperBus bus();
     uint8_t memGet(uint16_t addr, bool peek = false) override;
     void memSet(uint16_t addr, uint8_t val) override;
     uint8_t PPUmemGet(uint16_t addr, bool peek = false) override;
     void PPUmemSet(uint16_t addr, uint8_t val) override;
-    void loadData(std::ifstream &file) override;
     void powerOn() override;
+
+    unsigned int CHRbank(uint16_t addr) override;
 };
\ No newline at end of file
@@ -1,11 +1,11 @@
 #include "mapper4.h"
-#include "ppu.h"
-#include "cpu.h"
+#include "console.h"
 #include <iostream>
 #include <algorithm>
 
 //TODO: Add save ability for battery backed up PRG-RAM
-Mapper4::Mapper4(GAMEPAK::ROMInfo romInfo, std::ifstream &file)
+Mapper4::Mapper4(Console &console, GAMEPAK::ROMInfo romInfo, ROMSpan PRG, ROMSpan CHRROM) :
+    Mapper(console)
 {
     PRGRAM.resize(0x2000);
     if(romInfo.fourScreenMode) {
@@ -13,50 +13,44 @@ Mapper4::Mapper4(GAMEPAK::ROMInfo romInfo, std::ifstream &file)
         fourScreenMode = true;
     }
     else VRAM.resize(0x800);
-    PRGROM.resize(romInfo.PRGROMsize / 0x2000, std::vector<uint8_t>(0x2000, 0));
-    CHRROM.resize(romInfo.CHRROMsize / 0x400, std::vector<uint8_t>(0x400, 0));
+    PRGROM = PRG;
+    if(CHRROM.size == 0) {
+        usingCHRRAM = true;
+        CHRRAM.resize(0x2000, 0);
+        CHR = span(CHRRAM);
+    }
+    else CHR = CHRROM;
 
     std::fill(PRGRAM.begin(), PRGRAM.end(), 0);
 	std::fill(VRAM.begin(), VRAM.end(), 0);
-
-	loadData(file);
 }
 
 uint8_t Mapper4::memGet(uint16_t addr, bool peek)
 {
-    uint8_t returnedValue = CPU::busVal;
+    uint8_t returnedValue = console.cpu.busVal;
     if(addr >= 0x6000 && addr < 0x8000) {
-        returnedValue = PRGRAM.at((addr - 0x6000) % 0x2000);
-    }
-    else if(addr >= 0x8000 && addr < 0xA000) {
-        if(PRGbankmode == 0) returnedValue = PRGROM.at(R6).at((addr - 0x8000) % 0x2000);
-        else returnedValue = PRGROM.end()[-2].at((addr - 0x8000) % 0x2000);
-    }
-    else if(addr >= 0xA000 && addr < 0xC000) {
-        returnedValue = PRGROM.at(R7).at((addr - 0xA000) % 0x2000);
-    }
-    else if(addr >= 0xC000 && addr < 0xE000) {
-        if(PRGbankmode == 0) returnedValue = PRGROM.end()[-2].at((addr - 0xC000) % 0x2000);
-        else returnedValue = PRGROM.at(R6).at((addr - 0xC000) % 0x2000);
+        returnedValue = PRGRAM[addr - 0x6000];
     }
-    else if(addr >= 0xE000) {
-        returnedValue = PRGROM.end()[-1].at((addr - 0xE000) % 0x2000);
+    else if(addr >= 0x8000) {
+        returnedValue = PRGread(addr);
     }
 	if(peek) return returnedValue;
-	CPU::busVal = returnedValue;
-	return CPU::busVal;
+	console.cpu.busVal = returnedValue;
+	return console.cpu.busVal;
 }
 
 void Mapper4::memSet(uint16_t addr, uint8_t val)
 {
     if(addr >= 0x6000 && addr < 0x8000) {
-        PRGRAM.at((addr - 0x6000) % 0x2000) = val;
+        PRGRAM[addr - 0x6000] = val;
     }
     if(addr >= 0x8000 && addr < 0xA000) {
         if(addr % 2 == 0) { //Even
             regWriteSel = val & 7;
             PRGbankmode = ((val & 0x40) > 0) ? 1 : 0;
             CHRbankmode = ((val & 0x80) > 0) ? 1 : 0;
+            updatePRGpages();
+            updateCHRpages();
         }
         else { //Odd
             switch(regWriteSel) {
@@ -69,11 +63,14 @@ void Mapper4::memSet(uint16_t addr, uint8_t val)
                 case 6: R6 = (val & 0x3F); break;
                 case 7: R7 = (val & 0x3F); break;
             }
+            if(regWriteSel >= 6) updatePRGpages();
+            else updateCHRpages();
         }
     }
     else if(addr >= 0xA000 && addr < 0xC000) {
         if(addr % 2 == 0) { //Even
             horzMirroring = (val & 1) > 0;
+            updateMirroring();
         }
         //Ignore odd writes
         //PRG RAM protection doesn't need to be emulated
@@ -90,7 +87,7 @@ void Mapper4::memSet(uint16_t addr, uint8_t val)
         if(addr % 2 == 0) { //Even
             IRQenabled = false;
             IRQrequested = false;
-            CPU::setIRQfromCart(IRQrequested);
+            console.cpu.setIRQfromCart(IRQrequested);
         }
         else { //Odd
             IRQenabled = true;
@@ -101,162 +98,44 @@ void Mapper4::memSet(uint16_t addr, uint8_t val)
 uint8_t Mapper4::PPUmemGet(uint16_t addr, bool peek)
 {
     PPUbusAddrChanged(addr % 0x3FFF);
-	try {
     //Mirror addresses higher than 0x3FFF
 	addr %= 0x4000;
-	if(addr < 0x0400) {
-        if(CHRbankmode) return CHRROM.at(R2).at(addr % 0x400);
-        else return CHRROM.at(R0).at(addr % 0x400);
-    }
-    else if(addr < 0x0800) {
-        if(CHRbankmode) return CHRROM.at(R3).at(addr % 0x400);
-        else return CHRROM.at(R0+1).at(addr % 0x400);
-    }
-    else if(addr < 0x0C00) {
-        if(CHRbankmode) return CHRROM.at(R4).at(addr % 0x400);
-        else return CHRROM.at(R1).at(addr % 0x400);
-    }
-    else if(addr < 0x1000) {
-        if(CHRbankmode) return CHRROM.at(R5).at(addr % 0x400);
-        else return CHRROM.at(R1+1).at(addr % 0x400);
-    }
-    else if(addr < 0x1400) {
-        if(CHRbankmode) return CHRROM.at(R0).at(addr % 0x400);
-        else return CHRROM.at(R2).at(addr % 0x400);
-    }
-    else if(addr < 0x1800) {
-        if(CHRbankmode) return CHRROM.at(R0+1).at(addr % 0x400);
-        else return CHRROM.at(R3).at(addr % 0x400);
-    }
-    else if(addr < 0x1C00) {
-        if(CHRbankmode) return CHRROM.at(R1).at(addr % 0x400);
-        else return CHRROM.at(R4).at(addr % 0x400);
-    }
-    else if(addr < 0x2000) {
-        if(CHRbankmode) return CHRROM.at(R1+1).at(addr % 0x400);
-        else return CHRROM.at(R5).at(addr % 0x400);
+	if(addr < 0x2000) {
+        return CHRbyte(addr);
     }
 	else if(addr < 0x3F00) {
-		if(addr > 0x2FFF) addr -= 0x1000;
-        if(fourScreenMode) return VRAM.at(addr - 0x2000);
-
-		if(horzMirroring == false) {
-			if(addr < 0x2800)
-				return VRAM.at(addr - 0x2000);
-			else
-				return VRAM.at(addr - 0x2800);
-		}
-		else {
-			if(addr < 0x2800)
-				return VRAM.at(addr % 0x0400);
-			else
-				return VRAM.at(0x0400 + addr % 0x0400);
-		}
+		return nametableByte(addr);
 	}
-	else if(addr < 0x4000) {
+	else {
 		//Internal to PPU. Never mapped.
-		return PPU::getPalette((uint8_t)(addr % 0x20));
+		return console.ppu.getPalette((uint8_t)(addr % 0x20));
 	}
-	}
-	catch(const std::out_of_range err)
-	{
-		std::cerr << "Out of range error when trying to get addr: " << addr << std::endl;
-	}
-    return 0;
 }
 
 void Mapper4::PPUmemSet(uint16_t addr, uint8_t val)
 {
     PPUbusAddrChanged(addr % 0x3FFF);
-	try {
     //Mirror addresses higher than 0x3FFF
 	addr %= 0x4000;
-
-    //Can't write to CHRROM
-    
-	/*if(addr < 0x0400) {
-        if(CHRbankmode) CHRROM.at(R2).at(addr % 0x400) = val;
-        else CHRROM.at(R0).at(addr % 0x400) = val;
-    }
-    else if(addr < 0x0800) {
-        if(CHRbankmode) CHRROM.at(R3).at(addr % 0x400) = val;
-        else CHRROM.at(R0+1).at(addr % 0x400) = val;
-    }
-    else if(addr < 0x0C00) {
-        if(CHRbankmode) CHRROM.at(R4).at(addr % 0x400) = val;
-        else CHRROM.at(R1).at(addr % 0x400) = val;
-    }
-    else if(addr < 0x1000) {
-        if(CHRbankmode) CHRROM.at(R5).at(addr % 0x400) = val;
-        else CHRROM.at(R1+1).at(addr % 0x400) = val;
-    }
-    else if(addr < 0x1400) {
-        if(CHRbankmode) CHRROM.at(R0).at(addr % 0x400) = val;
-        else CHRROM.at(R2).at(addr % 0x400) = val;
-    }
-    else if(addr < 0x1800) {
-        if(CHRbankmode) CHRROM.at(R0+1).at(addr % 0x400) = val;
-        else CHRROM.at(R3).at(addr % 0x400) = val;
-    }
-    else if(addr < 0x1C00) {
-        if(CHRbankmode) CHRROM.at(R1).at(addr % 0x400) = val;
-        else CHRROM.at(R4).at(addr % 0x400) = val;
+	if(addr < 0x2000) {
+        //Only boards with CHR RAM can be written
+        if(usingCHRRAM) {
+            CHRRAMbyte(CHRRAM, addr) = val;
+            console.ppu.CHRwritten(addr);
+        }
     }
-    else if(addr < 0x2000) {
-        if(CHRbankmode) CHRROM.at(R1+1).at(addr % 0x400) = val;
-        else CHRROM.at(R5).at(addr % 0x400) = val;
-    }*/
-	if(addr >= 0x2000 && addr < 0x3F00) {
-		if(addr > 0x2FFF) addr -= 0x1000;
-        if(fourScreenMode) VRAM.at(addr - 0x2000) = val;
-
-		if(horzMirroring == false) {
-			if(addr < 0x2800)
-				VRAM.at(addr - 0x2000) = val;
-			else
-				VRAM.at(addr - 0x2800) = val;
-		}
-		else {
-			if(addr < 0x2800)
-				VRAM.at(addr % 0x0400) = val;
-			else
-				VRAM.at(0x0400 + addr % 0x0400) = val;
-		}
+	else if(addr < 0x3F00) {
+		nametableByte(addr) = val;
 	}
-	else if(addr >= 0x3F00 && addr < 0x4000) {
+	else {
 		//Internal to PPU. Never mapped.
-		return PPU::setPalette((uint8_t)(addr % 0x20), val);
-	}
-	}
-	catch(const std::out_of_range err)
-	{
-		std::cerr << "Out of range error when trying to set addr: " << addr << std::endl;
-	}
-}
-
-void Mapper4::loadData(std::ifstream &file)
-{
-	for(unsigned int bank=0; bank < PRGROM.size(); ++bank) {
-		for(unsigned int idx=0; idx < PRGROM[bank].size(); ++idx) {
-			if(file.eof())
-				throw std::out_of_range("Reached EOF unexpectantly while loading ROM");
-			file.read((char*)&PRGROM[bank][idx],1);
-		}
+		console.ppu.setPalette((uint8_t)(addr % 0x20), val);
 	}
-
-    for(unsigned int bank=0; bank < CHRROM.size(); ++bank) {
-        for(unsigned int idx=0; idx < CHRROM[bank].size(); ++idx) {
-            if(file.eof())
-                throw std::out_of_range("Reached EOF unexpectantly while loading ROM");
-            file.read((char*)&CHRROM[bank][idx],1);
-        }
-    }
 }
 
 void Mapper4::powerOn()
 {
 	//Assumed power on states
-	fourScreenMode = false;
     horzMirroring = false;
     IRQreload = false;
     IRQenabled = false;
@@ -266,17 +145,69 @@ void Mapper4::powerOn()
     PRGbankmode = 0;
     CHRbankmode = 0;
     IRQlatch = 0;
+    console.cpu.mapMemory(0x6000, 0x2000, PRGRAM.data(), PRGRAM.size(), true);
+    updatePRGpages();
+    updateCHRpages();
+    updateMirroring();
+}
+
+void Mapper4::updatePRGpages()
+{
+    //8KB banks. The second last and last are fixed, R6 swaps places with the second last
+    //Counted from the end, wrapping like mapPRG does so an 8KB ROM doesn't underflow
+    size_t secondLast = (PRGROM.size * 2 - 0x4000) % PRGROM.size;
+    mapPRG(0, 1, PRGROM, (PRGbankmode == 0) ? R6 * 0x2000 : secondLast);
+    mapPRG(1, 1, PRGROM, R7 * 0x2000);
+    mapPRG(2, 1, PRGROM, (PRGbankmode == 0) ? secondLast : R6 * 0x2000);
+    mapPRG(3, 1, PRGROM, PRGROM.size - 0x2000);
+}
+
+void Mapper4::updateCHRpages()
+{
+    //Two 2KB banks (R0, R1) and four 1KB banks (R2-R5). CHRbankmode swaps the pattern table halves
+    unsigned int twoKB = CHRbankmode ? 4 : 0;
+    unsigned int oneKB = CHRbankmode ? 0 : 4;
+    mapCHR(twoKB, 2, CHR, R0 * 0x400);
+    mapCHR(twoKB + 2, 2, CHR, R1 * 0x400);
+    mapCHR(oneKB, 1, CHR, R2 * 0x400);
+    mapCHR(oneKB + 1, 1, CHR, R3 * 0x400);
+    mapCHR(oneKB + 2, 1, CHR, R4 * 0x400);
+    mapCHR(oneKB + 3, 1, CHR, R5 * 0x400);
+}
+
+void Mapper4::updateMirroring()
+{
+    if(fourScreenMode) mirrorNametables(VRAM.data(), 0, 1, 2, 3);
+    else if(horzMirroring) mirrorNametables(VRAM.data(), 0, 0, 1, 1);
+    else mirrorNametables(VRAM.data(), 0, 1, 0, 1);
+}
+
+bool Mapper4::watchesPPUfetches()
+{
+    //Scanline counter is clocked by A12 rising between background and sprite fetches
+    return true;
+}
+
+unsigned int Mapper4::PRGbank(uint16_t addr)
+{
+    if(addr < 0x8000) return 0;
+    return (PRGpages[(addr >> 13) & 3] - PRGROM.data) / 0x2000;
+}
+
+unsigned int Mapper4::CHRbank(uint16_t addr)
+{
+    return (CHRpages[(addr >> 10) & 7] - CHR.data) / 0x400;
 }
 
 void Mapper4::PPUstep()
 {
-    CPU::setIRQfromCart(IRQrequested);
+    console.cpu.setIRQfromCart(IRQrequested);
 }
 
 void Mapper4::PPUbusAddrChanged(uint16_t newAddr)
 {
     if((lastVRAMaddr & 0x1000) == 0 && (newAddr & 0x1000) > 0) {
-        //std::cout << PPU::scanline << ":" << PPU::dot << " Clocking" << std::endl;
+        //std::cout << console.ppu.scanline << ":" << console.ppu.dot << " Clocking" << std::endl;
         if(IRQcntr == 0 || IRQreload) {
             IRQcntr = IRQlatch;
             IRQreload = false;
@@ -286,8 +217,19 @@ void Mapper4::PPUbusAddrChanged(uint16_t newAddr)
         }
         if(IRQcntr == 0 && IRQenabled) {
             IRQrequested = true;
-            CPU::setIRQfromCart(IRQrequested);
+            console.cpu.setIRQfromCart(IRQrequested);
         }
     }
     lastVRAMaddr = newAddr;
-}
\ No newline at end of file
+}
+
+bool Mapper4::clockedByPPU()
+{
+    //Scanline counter clocks off A12, but only raises IRQs while enabled
+    return IRQenabled || IRQrequested;
+}
+
+GAMEPAK::MapperBus Mapper4::bus()
+{
+    return makeBus<Mapper4>();
+}
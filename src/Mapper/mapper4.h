@@ -6,7 +6,7 @@
 #include "mapper.h"
 
 
-class Mapper4 : public Mapper {
+class Mapper4 final : public Mapper {
     protected:
     bool fourScreenMode = false;
     bool horzMirroring = false;
@@ -14,8 +14,9 @@ class Mapper4 : public Mapper {
     bool IRQenabled = false;
     bool IRQrequested = false;
     bool A12low = true;
-    std::vector<uint8_t> PRGRAM, VRAM;
-    std::vector<std::vector<uint8_t>> PRGROM, CHRROM;
+    bool usingCHRRAM = false;
+    ROMBuffer PRGRAM, VRAM, CHRRAM;
+    ROMSpan PRGROM, CHR;
     uint8_t R0, R1, R2, R3, R4, R5, R6, R7;
     uint8_t regWriteSel = 0;
     uint8_t PRGbankmode = 0;
@@ -25,17 +26,25 @@ class Mapper4 : public Mapper {
     uint8_t M2cntr = 0;
     uint16_t lastVRAMaddr = 0;
 
+    void updatePRGpages();
+    void updateCHRpages();
+    void updateMirroring();
+
     public:
-    Mapper4(GAMEPAK::ROMInfo romInfo, std::ifstream &file);
+    Mapper4(Console &console, GAMEPAK::ROMInfo romInfo, ROMSpan PRG, ROMSpan CHRROM);
+    GAMEPAK::MapperBus bus();
     uint8_t memGet(uint16_t addr, bool peek = false) override;
     void memSet(uint16_t addr, uint8_t val) override;
     uint8_t PPUmemGet(uint16_t addr, bool peek = false) override;
     void PPUmemSet(uint16_t addr, uint8_t val) override;
-    void loadData(std::ifstream &file) override;
 
     void powerOn() override;
 
     void PPUstep() override;
 
     void PPUbusAddrChanged(uint16_t newAddr) override;
+    bool clockedByPPU() override;
+    bool watchesPPUfetches() override;
+    unsigned int PRGbank(uint16_t addr) override;
+    unsigned int CHRbank(uint16_t addr) override;
 };
\ No newline at end of file
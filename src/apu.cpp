@@ -1,226 +1,42 @@
 #include "apu.h"
+#include "console.h"
 #include "nes.h"
-#include "cpu.h"
 #include "utils.h"
+#include "blipbuffer.h"
 #include <array>
 #include <iostream>
+#include <algorithm>
 
-namespace APU {
-
-//Registers
-struct PulseReg0 {
-	union {
-		uint8_t value;
-        BitWorker<0, 4> volPeriod;
-        BitWorker<4, 1> constVol;
-        BitWorker<5, 1> loopDisableLC;
-        BitWorker<6, 2> dutyCycleSel;
-	};
-}  pulse1Reg0, pulse2Reg0;
-
-struct PulseReg1 {
-	union {
-		uint8_t value;
-        BitWorker<0, 3> sweepShiftCount;
-        BitWorker<3, 1> sweepNegative;
-        BitWorker<4, 3> sweepPeriod;
-        BitWorker<7, 1> sweepEnable;
-	};
-}  pulse1Reg1, pulse2Reg1;
-
-uint8_t pulse1TimerLow, pulse2TimerLow;
-
-struct PulseReg3 {
-	union {
-		uint8_t value;
-        BitWorker<0, 3> timerHigh;
-        BitWorker<3, 5> lenCtrLoad;
-	};
-}  pulse1Reg3, pulse2Reg3;
-
-struct TriReg0 {
-	union {
-		uint8_t value;
-        BitWorker<0, 7> linCtrReloadVal;
-        BitWorker<7, 1> lenCtrDisable;
-	};
-}  triReg0;
-
-uint8_t triangleTimerLow;
-
-struct TriReg2 {
-	union {
-		uint8_t value;
-        BitWorker<0, 3> timerHigh;
-        BitWorker<3, 5> lenCtrLoad;
-	};
-}  triReg2;
-
-struct NoiseReg0 {
-	union {
-		uint8_t value;
-        BitWorker<0, 4> volPeriod;
-        BitWorker<4, 1> constVol;
-        BitWorker<5, 1> loopDisableLC;
-	};
-}  noiseReg0;
-
-struct NoiseReg1 {
-	union {
-		uint8_t value;
-        BitWorker<0, 4> noisePeriodSel;
-        BitWorker<7, 1> noiseMode;
-	};
-}  noiseReg1;
-
-struct NoiseReg2 {
-	union {
-		uint8_t value;
-        BitWorker<3, 5> lenCtrLoad;
-	};
-}  noiseReg2;
-
-struct DMCReg0 {
-	union {
-		uint8_t value;
-        BitWorker<0, 4> freqIdx;
-        BitWorker<6, 1> loopSample;
-        BitWorker<7, 1> IRQenable;
-	};
-}  dmcReg0;
-
-struct DMCReg1 {
-	union {
-		uint8_t value;
-        BitWorker<0, 7> directLoad;
-	};
-}  dmcReg1;
-
-uint16_t dmcTargetAddr;
-uint16_t dmcTargetLen;
-
-struct ControlReg {
-	union {
-		uint8_t value;
-        BitWorker<0, 1> enableLCpulse1;
-        BitWorker<1, 1> enableLCpulse2;
-        BitWorker<2, 1> enableLCtriangle;
-        BitWorker<3, 1> enableLCnoise;
-        BitWorker<4, 1> enableDMC;
-	};
-}  controlReg;
-
-struct StatusReg {
-	union {
-		uint8_t value;
-        BitWorker<0, 1> LCpulse1;
-        BitWorker<1, 1> LCpulse2;
-        BitWorker<2, 1> LCtriangle;
-        BitWorker<3, 1> LCnoise;
-        BitWorker<4, 1> DMCactive;
-        BitWorker<5, 1> openBus;
-        BitWorker<6, 1> frameIRQ;
-        BitWorker<7, 1> dmcIRQ;
-	};
-}  statusReg;
-
-struct FrameReg {
-	union {
-		uint8_t value;
-        BitWorker<6, 1> IRQinhibit;
-        BitWorker<7, 1> frameMode;
-	};
-}  frameReg;
-
-//Pulse 1
-uint8_t pulse1Volume = 0;
-uint8_t pulse1EnvDecay = 0;
-bool pulse1StartEnv = false;
-uint8_t pulse1EnvDivider = 0;
-uint8_t pulse1SweepDivider = 0;
-bool pulse1SweepMute = false;
-bool pulse1SweepReload = false;
-uint8_t pulse1_lenCntr;
-uint16_t timerPeriodTargetPulse1;
-uint16_t timerPeriodPulse1;
-uint16_t timerPulse1;
-uint8_t outputPulse1;
-int dutyIdxPulse1;
-std::array<int,8> dutyCyclePulse1;
-std::array<std::array<int,8>,4> pulseDutyCycleTable = {
+const std::array<std::array<int,8>,4> pulseDutyCycleTable = {
     std::array<int,8> {0,1,0,0,0,0,0,0},
     std::array<int,8> {0,1,1,0,0,0,0,0},
     std::array<int,8> {0,1,1,1,1,0,0,0},
     std::array<int,8> {1,0,0,1,1,1,1,1}
 };
-std::array<uint8_t,0x20> lengthCounterArray = {
+
+const std::array<uint8_t,0x20> lengthCounterArray = {
     10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
     12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
 };
 
-//Pulse 2
-uint8_t pulse2Volume = 0;
-uint8_t pulse2EnvDecay = 0;
-bool pulse2StartEnv = false;
-uint8_t pulse2EnvDivider = 0;
-uint8_t pulse2SweepDivider = 0;
-bool pulse2SweepMute = false;
-bool pulse2SweepReload = false;
-uint8_t pulse2_lenCntr;
-uint16_t timerPeriodTargetPulse2;
-uint16_t timerPeriodPulse2;
-uint16_t timerPulse2;
-uint8_t outputPulse2;
-int dutyIdxPulse2;
-std::array<int,8> dutyCyclePulse2;
-
-//Triangle
-uint8_t triangle_lenCntr;
-uint8_t triangle_linearCntr;
-bool triangle_linearCntrReload = false;
-uint8_t outputTriangle;
-uint16_t timerSetTriangle;
-uint16_t timerTriangle;
-std::array<uint8_t, 32> triangleOutputArray {15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+const std::array<uint8_t, 32> triangleOutputArray {15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
                                      0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-uint8_t triangleOutputArrayIdx = 0;
-
-//Noise
-uint8_t noiseVolume = 0;
-uint8_t noiseEnvDecay = 0;
-bool noiseStartEnv = false;
-uint8_t noiseEnvDivider = 0;
-uint8_t noise_lenCntr;
-uint16_t noiseShiftRegister;
-uint16_t timerNoise;
-uint8_t outputNoise;
-std::array<uint16_t, 16> noiseTimerTable {0x04, 0x08, 0x10, 0x20, 0x40, 0x60, 0x80, 0xA0,
+
+const std::array<uint16_t, 16> noiseTimerTable {0x04, 0x08, 0x10, 0x20, 0x40, 0x60, 0x80, 0xA0,
                                           0xCA, 0xFE, 0x17C, 0x1FC, 0x2FA, 0x3F8, 0x7F2, 0xFE4};
 
-//DMC
-uint16_t timerDMC;
-uint16_t dmcCurrAddr;
-uint16_t dmcBytesRemaining = 0;
-uint8_t dmcBuffer = 0;
-uint8_t dmcShiftRegister = 0;
-uint8_t dmcBitsRemaining = 0;
-bool dmcSilence = true;
-bool DMCinterruptRequest = false;
-uint8_t outputDMC = 0;
-std::array<uint16_t, 16> dmcRateTable {428, 380, 340, 320, 286, 254, 226, 214,
+const std::array<uint16_t, 16> dmcRateTable {428, 380, 340, 320, 286, 254, 226, 214,
                                        190, 160, 142, 128, 106, 84, 72, 54};
 
-//Frame Counter
-bool frameInterruptRequest = false;
-unsigned int frameHalfCycle;
-unsigned long long cycle = 0;
-bool frameReset = false;
+const float OUTPUT_VOLUME = 2 * 0xFFF;	//Sample swing for a mixer swing of 0-1
 
-//Audio Mixer
-std::array<float, 31> pulseMixerTable;
-std::array<float, 203> tndMixerTable;
+APU::APU(Console &console) :
+    console(console),
+    blip(NES::APU_CLOCK_RATE, 48000, 48000 / 10)
+{
+}
 
-void powerOn()
+void APU::powerOn()
 {
     generateMixerTables();
     regSet(0x4015, 0); //Disables all channels
@@ -229,14 +45,17 @@ void powerOn()
         regSet(addr, 0);
     frameHalfCycle = 0;
     noiseShiftRegister = 1;
+    mixedOutput = 0;
+    blip.clear();
+    blipFrameStart = cycle;
 }
 
-void reset()
+void APU::reset()
 {
     regSet(0x4015, 0);
 }
 
-void step()
+void APU::step()
 {
     if(frameReset && (cycle % 2) == 0) {
         frameHalfCycle = 0;
@@ -304,13 +123,43 @@ void step()
 
     mixOutput();
 
-    CPU::setIRQfromAPU(frameInterruptRequest || DMCinterruptRequest);
+    IRQline = frameInterruptRequest || DMCinterruptRequest;
+    console.cpu.setIRQfromAPU(IRQline);
     
     cycle++;
 }
 
+unsigned long long APU::stepsToNextEvent()
+{
+    //Steps until the APU next does something the CPU can see without a register read:
+    //raising the frame IRQ, or a DMC sample fetch (which drives the CPU bus and can raise the DMC IRQ)
+    unsigned long long steps = 1ULL << 32;
+
+    if(frameReset || IRQline != (frameInterruptRequest || DMCinterruptRequest)) {
+        //Register access changed the IRQ or frame counter, which the next step passes on
+        steps = 1;
+    }
+    else if(frameReg.frameMode == 0 && frameReg.IRQinhibit == 0) {
+        if(frameHalfCycle <= 29830)
+            steps = 29830 - frameHalfCycle + 1;
+        else if(frameHalfCycle <= 29832)
+            steps = 1;
+        else //Left over from 5-step mode, counter wraps at 37289
+            steps = 37289 - frameHalfCycle + 1;
+    }
+
+    if(dmcBuffer != 0) {
+        //DMC is stepped every other cycle. Find which of those steps empties the shift register
+        unsigned long long dmcSteps = 1;
+        if(dmcBitsRemaining > 0)
+            dmcSteps = (timerDMC + 1) + (unsigned long long)(dmcBitsRemaining - 1) * (dmcRateTable[dmcReg0.freqIdx] + 1);
+        unsigned long long firstEvenStep = (cycle % 2 == 0) ? 1 : 2;
+        steps = std::min(steps, firstEvenStep + 2 * (dmcSteps - 1));
+    }
+    return steps;
+}
 
-void clockLengthCounters()
+void APU::clockLengthCounters()
 {
     if(pulse1_lenCntr) {
         if(controlReg.enableLCpulse1 == 0)
@@ -338,7 +187,7 @@ void clockLengthCounters()
     }
 }
 
-void clockEnvelopes() {
+void APU::clockEnvelopes() {
     //Pulse 1
     if(pulse1StartEnv) {
         //Start flag set (due to $4003 write)
@@ -423,7 +272,7 @@ void clockEnvelopes() {
     else noiseVolume = noiseEnvDecay;
 }
 
-void clockSweep() {
+void APU::clockSweep() {
     int16_t periodDelta;
 
     //Pulse 1
@@ -467,7 +316,7 @@ void clockSweep() {
         pulse2SweepMute = false;
 }
 
-void clockLinearCounter() {
+void APU::clockLinearCounter() {
     if(triangle_linearCntrReload)
         triangle_linearCntr = triReg0.linCtrReloadVal;
     else if(triangle_linearCntr > 0)
@@ -476,7 +325,7 @@ void clockLinearCounter() {
         triangle_linearCntrReload = false;
 }
 
-uint8_t regGet(uint16_t addr, bool peek)
+uint8_t APU::regGet(uint16_t addr, bool peek)
 {   
     if(addr == 0x4015) {
         statusReg.LCpulse1 = ((pulse1_lenCntr>0) ? 1 : 0);
@@ -486,14 +335,14 @@ uint8_t regGet(uint16_t addr, bool peek)
         statusReg.DMCactive = ((dmcBytesRemaining > 0) ? 1 : 0);
         statusReg.frameIRQ = ((frameInterruptRequest) ? 1 : 0);
         statusReg.dmcIRQ = ((DMCinterruptRequest) ? 1 : 0);
-        statusReg.openBus = CPU::busVal >> 5;
+        statusReg.openBus = console.cpu.busVal >> 5;
         if(peek == false) frameInterruptRequest = false;
         return statusReg.value;
     }
-    return CPU::busVal; //Open bus behavior
+    return console.cpu.busVal; //Open bus behavior
 }
 
-void regSet(uint16_t addr, uint8_t val)
+void APU::regSet(uint16_t addr, uint8_t val)
 {
     switch(addr) {
         case 0x4000:
@@ -606,7 +455,7 @@ void regSet(uint16_t addr, uint8_t val)
     }
 }
 
-void stepPulse1() {
+void APU::stepPulse1() {
     if(timerPulse1 > 0) {
         --timerPulse1;
     }
@@ -623,7 +472,7 @@ void stepPulse1() {
     }
 }
 
-void stepPulse2() {
+void APU::stepPulse2() {
     if(timerPulse2 > 0) {
         --timerPulse2;
     }
@@ -640,7 +489,7 @@ void stepPulse2() {
     }
 }
 
-void stepTriangle() {
+void APU::stepTriangle() {
     if(timerTriangle > 0) {
         --timerTriangle;
     }
@@ -654,7 +503,7 @@ void stepTriangle() {
     outputTriangle = triangleOutputArray[triangleOutputArrayIdx];
 }
 
-void stepNoise() {
+void APU::stepNoise() {
     uint16_t feedback;
     if(timerNoise > 0) {
         --timerNoise;
@@ -676,7 +525,7 @@ void stepNoise() {
         outputNoise = 0;
 }
 
-void stepDMC() {
+void APU::stepDMC() {
     if(timerDMC > 0) {
         --timerDMC;
     }
@@ -708,10 +557,10 @@ void stepDMC() {
     }
 }
 
-void loadDMC() {
+void APU::loadDMC() {
     if(dmcBuffer != 0) return;
     //TODO: stall CPU
-    dmcBuffer = CPU::memGet(dmcCurrAddr);
+    dmcBuffer = console.cpu.memGet(dmcCurrAddr);
     if(dmcCurrAddr == 0xFFFF) dmcCurrAddr = 0x8000;
     else ++dmcCurrAddr;
     --dmcBytesRemaining;
@@ -728,16 +577,38 @@ void loadDMC() {
 }
 
 
-void mixOutput() {
-    //Output is 0-1
+void APU::mixOutput() {
+    //Output is 0-1. Only changes go to the buffer, most cycles nothing moves
     float output;
     output = pulseMixerTable[outputPulse1 + outputPulse2];
     output += tndMixerTable[3 * outputTriangle + 2 * outputNoise + outputDMC];
-    NES::rawAudio.buffer[NES::rawAudio.writeIdx] = output;
-    NES::rawAudio.writeIdx = (NES::rawAudio.writeIdx+1) % NES::rawAudio.buffer.size();
+    if(output != mixedOutput) {
+        blip.addDelta(cycle - blipFrameStart, (output - mixedOutput) * OUTPUT_VOLUME);
+        mixedOutput = output;
+    }
+}
+
+void APU::setSampleRate(int rate)
+{
+    blip = BlipBuffer(NES::APU_CLOCK_RATE, rate, rate / 10);
+    blipFrameStart = cycle;
 }
 
-void generateMixerTables() {
+void APU::endAudioFrame()
+{
+    blip.endFrame(cycle - blipFrameStart);
+    blipFrameStart = cycle;
+    //Nobody is reading (paused audio, max speed). Keep room for the next frame by dropping the oldest
+    int excess = blip.samplesAvailable() - blip.maxSamples() / 2;
+    if(excess > 0) blip.readSamples(nullptr, excess);
+}
+
+int APU::readSamples(int16_t *out, int count)
+{
+    return blip.readSamples(out, count);
+}
+
+void APU::generateMixerTables() {
     //Using info from http://wiki.nesdev.com/w/index.php/APU_Mixer
     //Generates lookup tables to speed up processing time
     pulseMixerTable[0] = 0;
@@ -749,6 +620,3 @@ void generateMixerTables() {
         tndMixerTable[i] = (163.67f / (24329.0f / i + 100.0f));
     }
 }
-
-
-}
\ No newline at end of file
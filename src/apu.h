@@ -2,30 +2,242 @@
 
 #include <stdint.h>
 #include <array>
+#include "utils.h"
+#include "blipbuffer.h"
 
-namespace APU {
-
-void powerOn();
-void reset();
-void step();
-
-uint8_t regGet(uint16_t addr, bool peek = false);
-void regSet(uint16_t addr, uint8_t val);
-
-void clockLengthCounters();
-void clockEnvelopes();
-void clockLinearCounter();
-void clockSweep();
-void stepPulse1();
-void stepPulse2();
-void stepTriangle();
-void stepNoise();
-void stepDMC();
-void loadDMC();
-void mixOutput();
-void generateMixerTables();
-float *getRawAudioBuffer();
-int getRawAudioBufferSize();
-void resetRawAudioBuffer();
-
-}
\ No newline at end of file
+class Console;
+
+class APU {
+	public:
+	explicit APU(Console &console);
+
+	void powerOn();
+	void reset();
+	void step();
+	unsigned long long stepsToNextEvent();
+
+	uint8_t regGet(uint16_t addr, bool peek = false);
+	void regSet(uint16_t addr, uint8_t val);
+
+	//Output samples, band limited and at the rate set here
+	void setSampleRate(int rate);
+	void endAudioFrame();	//Makes everything up to the current cycle readable
+	int readSamples(int16_t *out, int count);
+
+	private:
+	Console &console;
+
+	//Registers
+	struct PulseReg0 {
+		union {
+			uint8_t value;
+			BitWorker<0, 4> volPeriod;
+			BitWorker<4, 1> constVol;
+			BitWorker<5, 1> loopDisableLC;
+			BitWorker<6, 2> dutyCycleSel;
+		};
+	}  pulse1Reg0, pulse2Reg0;
+
+	struct PulseReg1 {
+		union {
+			uint8_t value;
+			BitWorker<0, 3> sweepShiftCount;
+			BitWorker<3, 1> sweepNegative;
+			BitWorker<4, 3> sweepPeriod;
+			BitWorker<7, 1> sweepEnable;
+		};
+	}  pulse1Reg1, pulse2Reg1;
+
+	uint8_t pulse1TimerLow, pulse2TimerLow;
+
+	struct PulseReg3 {
+		union {
+			uint8_t value;
+			BitWorker<0, 3> timerHigh;
+			BitWorker<3, 5> lenCtrLoad;
+		};
+	}  pulse1Reg3, pulse2Reg3;
+
+	struct TriReg0 {
+		union {
+			uint8_t value;
+			BitWorker<0, 7> linCtrReloadVal;
+			BitWorker<7, 1> lenCtrDisable;
+		};
+	}  triReg0;
+
+	uint8_t triangleTimerLow;
+
+	struct TriReg2 {
+		union {
+			uint8_t value;
+			BitWorker<0, 3> timerHigh;
+			BitWorker<3, 5> lenCtrLoad;
+		};
+	}  triReg2;
+
+	struct NoiseReg0 {
+		union {
+			uint8_t value;
+			BitWorker<0, 4> volPeriod;
+			BitWorker<4, 1> constVol;
+			BitWorker<5, 1> loopDisableLC;
+		};
+	}  noiseReg0;
+
+	struct NoiseReg1 {
+		union {
+			uint8_t value;
+			BitWorker<0, 4> noisePeriodSel;
+			BitWorker<7, 1> noiseMode;
+		};
+	}  noiseReg1;
+
+	struct NoiseReg2 {
+		union {
+			uint8_t value;
+			BitWorker<3, 5> lenCtrLoad;
+		};
+	}  noiseReg2;
+
+	struct DMCReg0 {
+		union {
+			uint8_t value;
+			BitWorker<0, 4> freqIdx;
+			BitWorker<6, 1> loopSample;
+			BitWorker<7, 1> IRQenable;
+		};
+	}  dmcReg0;
+
+	struct DMCReg1 {
+		union {
+			uint8_t value;
+			BitWorker<0, 7> directLoad;
+		};
+	}  dmcReg1;
+
+	uint16_t dmcTargetAddr;
+	uint16_t dmcTargetLen;
+
+	struct ControlReg {
+		union {
+			uint8_t value;
+			BitWorker<0, 1> enableLCpulse1;
+			BitWorker<1, 1> enableLCpulse2;
+			BitWorker<2, 1> enableLCtriangle;
+			BitWorker<3, 1> enableLCnoise;
+			BitWorker<4, 1> enableDMC;
+		};
+	}  controlReg;
+
+	struct StatusReg {
+		union {
+			uint8_t value;
+			BitWorker<0, 1> LCpulse1;
+			BitWorker<1, 1> LCpulse2;
+			BitWorker<2, 1> LCtriangle;
+			BitWorker<3, 1> LCnoise;
+			BitWorker<4, 1> DMCactive;
+			BitWorker<5, 1> openBus;
+			BitWorker<6, 1> frameIRQ;
+			BitWorker<7, 1> dmcIRQ;
+		};
+	}  statusReg;
+
+	struct FrameReg {
+		union {
+			uint8_t value;
+			BitWorker<6, 1> IRQinhibit;
+			BitWorker<7, 1> frameMode;
+		};
+	}  frameReg;
+
+	//Pulse 1
+	uint8_t pulse1Volume = 0;
+	uint8_t pulse1EnvDecay = 0;
+	bool pulse1StartEnv = false;
+	uint8_t pulse1EnvDivider = 0;
+	uint8_t pulse1SweepDivider = 0;
+	bool pulse1SweepMute = false;
+	bool pulse1SweepReload = false;
+	uint8_t pulse1_lenCntr;
+	uint16_t timerPeriodTargetPulse1;
+	uint16_t timerPeriodPulse1;
+	uint16_t timerPulse1;
+	uint8_t outputPulse1;
+	int dutyIdxPulse1;
+	std::array<int,8> dutyCyclePulse1;
+
+	//Pulse 2
+	uint8_t pulse2Volume = 0;
+	uint8_t pulse2EnvDecay = 0;
+	bool pulse2StartEnv = false;
+	uint8_t pulse2EnvDivider = 0;
+	uint8_t pulse2SweepDivider = 0;
+	bool pulse2SweepMute = false;
+	bool pulse2SweepReload = false;
+	uint8_t pulse2_lenCntr;
+	uint16_t timerPeriodTargetPulse2;
+	uint16_t timerPeriodPulse2;
+	uint16_t timerPulse2;
+	uint8_t outputPulse2;
+	int dutyIdxPulse2;
+	std::array<int,8> dutyCyclePulse2;
+
+	//Triangle
+	uint8_t triangle_lenCntr;
+	uint8_t triangle_linearCntr;
+	bool triangle_linearCntrReload = false;
+	uint8_t outputTriangle;
+	uint16_t timerSetTriangle;
+	uint16_t timerTriangle;
+	uint8_t triangleOutputArrayIdx = 0;
+
+	//Noise
+	uint8_t noiseVolume = 0;
+	uint8_t noiseEnvDecay = 0;
+	bool noiseStartEnv = false;
+	uint8_t noiseEnvDivider = 0;
+	uint8_t noise_lenCntr;
+	uint16_t noiseShiftRegister;
+	uint16_t timerNoise;
+	uint8_t outputNoise;
+
+	//DMC
+	uint16_t timerDMC;
+	uint16_t dmcCurrAddr;
+	uint16_t dmcBytesRemaining = 0;
+	uint8_t dmcBuffer = 0;
+	uint8_t dmcShiftRegister = 0;
+	uint8_t dmcBitsRemaining = 0;
+	bool dmcSilence = true;
+	bool DMCinterruptRequest = false;
+	uint8_t outputDMC = 0;
+
+	//Frame Counter
+	bool frameInterruptRequest = false;
+	unsigned int frameHalfCycle;
+	unsigned long long cycle = 0;
+	bool frameReset = false;
+	bool IRQline = false; //Last IRQ state sent to the CPU
+
+	//Audio Mixer
+	std::array<float, 31> pulseMixerTable;
+	std::array<float, 203> tndMixerTable;
+	float mixedOutput = 0;
+	BlipBuffer blip;
+	unsigned long long blipFrameStart = 0;	//Cycle the buffer's current frame began on
+
+	void clockLengthCounters();
+	void clockEnvelopes();
+	void clockLinearCounter();
+	void clockSweep();
+	void stepPulse1();
+	void stepPulse2();
+	void stepTriangle();
+	void stepNoise();
+	void stepDMC();
+	void loadDMC();
+	void mixOutput();
+	void generateMixerTables();
+};
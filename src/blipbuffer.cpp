@@ -0,0 +1,93 @@
+#include "blipbuffer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+const double CUTOFF = 0.90;			//Of the output Nyquist frequency
+const float HIGHPASS = 1.0f / 512;	//Integrator leak, a few Hz. Removes the mixer's DC offset
+
+}
+
+BlipBuffer::BlipBuffer(double clockRate, double sampleRate, int maxSamples) :
+    factor((uint64_t)(sampleRate / clockRate * FRAC_UNIT + 0.5)),
+    buffer(maxSamples + WIDTH, 0.0f)
+{
+}
+
+const std::array<std::array<float, BlipBuffer::WIDTH>, BlipBuffer::PHASES + 1> &BlipBuffer::kernels()
+{
+    //Row p is the step for a change p/PHASES of a sample after the first tap's centre, so the last
+    //row is the first shifted by one tap and interpolation can always use row p+1.
+    //Each row sums to 1 so a step always settles at exactly its delta
+    static const auto table = [] {
+        std::array<std::array<float, WIDTH>, PHASES + 1> rows;
+        const int half = WIDTH / 2;
+        for(int p = 0; p <= PHASES; ++p) {
+            double sum = 0;
+            std::array<double, WIDTH> row;
+            for(int i = 0; i < WIDTH; ++i) {
+                double x = (i - (half - 1)) - (double)p / PHASES;
+                double sinc = (x == 0) ? 1 : std::sin(PI * CUTOFF * x) / (PI * CUTOFF * x);
+                double window = 0.42 + 0.5 * std::cos(PI * x / half) + 0.08 * std::cos(2 * PI * x / half); //Blackman
+                row[i] = (std::abs(x) < half) ? sinc * window : 0;
+                sum += row[i];
+            }
+            for(int i = 0; i < WIDTH; ++i)
+                rows[p][i] = (float)(row[i] / sum);
+        }
+        return rows;
+    }();
+    return table;
+}
+
+void BlipBuffer::clear()
+{
+    offset = 0;
+    available = 0;
+    integrator = 0;
+    std::fill(buffer.begin(), buffer.end(), 0.0f);
+}
+
+void BlipBuffer::addDelta(unsigned int clockTime, float delta)
+{
+    uint64_t pos = offset + clockTime * factor;
+    size_t sample = pos >> 32;
+    if(sample + WIDTH > buffer.size()) return; //Frame ran past the buffer, nothing read it in time
+
+    //Phase of the change within its sample, and how far it is towards the next phase
+    uint32_t frac = (uint32_t)pos;
+    int phase = frac >> (32 - PHASE_BITS);
+    float interp = (float)(frac & ((1u << (32 - PHASE_BITS)) - 1)) / (1u << (32 - PHASE_BITS));
+
+    const auto &lo = kernels()[phase];
+    const auto &hi = kernels()[phase + 1];
+    float *out = &buffer[sample];
+    for(int i = 0; i < WIDTH; ++i)
+        out[i] += delta * (lo[i] + (hi[i] - lo[i]) * interp);
+}
+
+void BlipBuffer::endFrame(unsigned int clockDuration)
+{
+    offset += clockDuration * factor;
+    available = std::min((int)(offset >> 32), maxSamples());
+}
+
+int BlipBuffer::readSamples(int16_t *out, int count)
+{
+    count = std::min(count, available);
+    for(int i = 0; i < count; ++i) {
+        integrator += buffer[i];
+        if(out) out[i] = (int16_t)std::max(-32768.0f, std::min(32767.0f, integrator));
+        integrator -= integrator * HIGHPASS;
+    }
+
+    //Slide what's left down. That includes the tails of steps placed near the end of the last frame
+    auto used = buffer.begin() + std::min(buffer.size(), (size_t)(offset >> 32) + WIDTH);
+    std::copy(buffer.begin() + count, used, buffer.begin());
+    std::fill(used - count, used, 0.0f);
+    offset -= (uint64_t)count << 32;
+    available -= count;
+    return count;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <vector>
+
+//Band-limited step synthesis, after blip_buf
+//Sources only report a change in their level, timed in input clocks. Each change is spread over a
+//few output samples with a windowed sinc step, so the output is at the final sample rate and free
+//of the aliasing that picking every Nth input sample gives. Output time is kept in 32.32 fixed point
+class BlipBuffer {
+    public:
+    BlipBuffer(double clockRate, double sampleRate, int maxSamples);
+
+    void clear();
+    //Level changes by delta, clockTime clocks after the start of the current frame
+    void addDelta(unsigned int clockTime, float delta);
+    //Ends the current frame, clockDuration clocks long. Its samples can now be read
+    void endFrame(unsigned int clockDuration);
+
+    int samplesAvailable() const { return available; }
+    int maxSamples() const { return (int)buffer.size() - WIDTH; }
+    //Reads up to count samples and returns how many there were. Out can be null to drop them
+    int readSamples(int16_t *out, int count);
+
+    private:
+    static const int WIDTH = 16;		//Output samples each step is spread over
+    static const int PHASE_BITS = 5;	//Kernels per output sample, interpolated between
+    static const int PHASES = 1 << PHASE_BITS;
+    static const uint64_t FRAC_UNIT = 1ULL << 32;
+
+    static const std::array<std::array<float, WIDTH>, PHASES + 1> &kernels();
+
+    uint64_t factor;		//Output samples per clock
+    uint64_t offset = 0;	//Output position of the current frame's start
+    int available = 0;
+    float integrator = 0;
+    std::vector<float> buffer;	//Level changes per output sample, summed on read
+};
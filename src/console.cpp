@@ -0,0 +1,117 @@
+#include "console.h"
+#include "romloader.h"
+
+Console::Console() :
+    cpu(*this),
+    ppu(*this),
+    apu(*this),
+    io(*this),
+    gamepak(*this)
+{
+}
+
+int Console::loadROM(std::shared_ptr<const ROMImage> image)
+{
+    romLoaded = false;
+    if(image == nullptr) return 1;
+    if(gamepak.loadROM(std::move(image)) > 0) {
+		return 1;
+	}
+    romLoaded = true;
+    return 0;
+}
+
+int Console::loadROM(std::string filename, std::string entry)
+{
+    return loadROM(ROMLOADER::load(filename, entry));
+}
+
+int Console::loadROM(const uint8_t *data, size_t size)
+{
+    return loadROM(ROMLOADER::load(data, size));
+}
+
+void Console::powerOn()
+{
+    gamepak.powerOn();
+    cpu.powerOn();
+	ppu.powerOn();
+	apu.powerOn();
+
+	if(PC_debug_start_flag) {
+		cpu.setPC(PC_debug_start);
+	}
+
+    running = true;
+}
+
+void Console::reset()
+{
+    gamepak.reset();
+    cpu.reset();
+    ppu.reset();
+    apu.reset();
+}
+
+void Console::pause(bool enable)
+{
+    running = !enable;
+}
+
+void Console::frameStep(bool force)
+{
+    if(running || force) {
+        while(ppu.isframeReady() == 0) {
+            cpu.step();
+        }
+        //Bring the PPU and APU level with the CPU before the frame and audio are used
+        cpu.syncComponents();
+        apu.endAudioFrame();
+        ppu.setframeReady(false);
+    }
+}
+
+void Console::setDebugPC(bool enable, uint16_t debugPC)
+{
+    if(enable) {
+        PC_debug_start_flag = true;
+        PC_debug_start = debugPC;
+    }
+    else
+        PC_debug_start_flag = false;
+}
+
+unsigned long Console::getFrameNum()
+{
+    return ppu.frame;
+}
+
+void Console::setAudioSampleRate(int rate)
+{
+    apu.setSampleRate(rate);
+}
+
+int Console::readAudio(int16_t *out, int count)
+{
+    return apu.readSamples(out, count);
+}
+
+uint8_t Console::getPalette(uint16_t addr) {
+    return ppu.getPalette(addr);
+}
+
+uint8_t* Console::getPixelMap() {
+    return ppu.pixelMap.data();
+}
+
+uint8_t Console::getEmphasis() {
+    return ppu.getEmphasis();
+}
+
+void Console::setOutputBuffer(uint32_t *buffer, const std::array<uint32_t, 512> &palette) {
+    ppu.setOutputBuffer(buffer, palette);
+}
+
+std::array<std::array<uint8_t, 16*16*64>, 2> Console::getPatternTableBuffers() {
+    return ppu.getPatternTableBuffers();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <array>
+#include <memory>
+#include "cpu.h"
+#include "ppu.h"
+#include "apu.h"
+#include "io.h"
+#include "gamepak.h"
+
+//One emulated NES: the CPU, PPU, APU, controller ports and cartridge, wired to each other
+//Consoles share nothing but the ROM cache, so separate ones can run on separate threads
+//Tracing and profiling are process-wide and should only be turned on for one of them
+class Console {
+	public:
+	Console();
+	Console(const Console&) = delete;
+	Console &operator=(const Console&) = delete;
+
+	CPU cpu;
+	PPU ppu;
+	APU apu;
+	IO io;
+	GAMEPAK gamepak;
+
+	std::array<uint8_t, 2> controller_state = {0, 0};
+
+	bool running = false;
+	bool romLoaded = false;
+
+	//Path can be a .nes, .gz or .zip file or a directory, see ROMLOADER::load
+	int loadROM(std::string filename, std::string entry = "");
+	int loadROM(const uint8_t *data, size_t size);
+	int loadROM(std::shared_ptr<const ROMImage> image);
+	void powerOn();
+	void reset();
+	void pause(bool enable);
+	void frameStep(bool force = false);
+
+	void setDebugPC(bool enable, uint16_t debugPC = 0);
+
+	unsigned long getFrameNum();
+	uint8_t getPalette(uint16_t addr);
+	uint8_t* getPixelMap();
+	uint8_t getEmphasis();
+	void setAudioSampleRate(int rate);
+	int readAudio(int16_t *out, int count);
+	void setOutputBuffer(uint32_t *buffer, const std::array<uint32_t, 512> &palette);
+	std::array<std::array<uint8_t, 16*16*64>, 2> getPatternTableBuffers();
+
+	private:
+	bool PC_debug_start_flag = false;
+	uint16_t PC_debug_start = 0;
+};
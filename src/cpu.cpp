@@ -1,164 +1,216 @@
 #include "cpu.h"
-#include "nes.h"
-#include "ppu.h"
-#include "apu.h"
-#include "io.h"
-#include "gamepak.h"
+#include "console.h"
 #include "utils.h"
-#include <iostream>
-#include <fstream>
-#include <iomanip>
+#include "trace.h"
+#include "profiler.h"
 #include <array>
-
-namespace CPU {
-
-unsigned long long cpuCycle;
-
-//Interupts (NMI and IRQ) go through 3 steps when triggering the CPU
-//Step 1: A device pulls the NMI or IRQ line low (simulated with setNMI() and setIRQfromX() setting NMIsignal or IRQ signal)
-//		  IRQfromAPU and IRQfromCart used to ensure proper behavior with multiple devices possibly pulling the line low
-//Step 2: During phi2 of each CPU cycle, the status of these lines is detected (simulated with interruptDetect())
-//		  If interrupt detected on lines, the internal NMI or IRQ detected signal is triggered during the following phi1
-//		  This sets IRQ/NMIdetected in the emulator
-//Step 3: The NMI/IRQ detected signals are polled at certain points. Documentation is unclear, but is assumed to also be
-//		  during phi2 of each CPU cycle. This behavior is also simulated with interruptDetect(), which sets the IRQ/NMIflag
-
-bool IRQfromAPU, IRQfromCart;
-bool NMIsignal, IRQsignal;
-bool IRQdetected, IRQflag, NMIdetected, NMIflag;
-
-
-struct StatusReg {
-	union {
-		uint8_t value;
-		BitWorker<0, 1> C; //Carry
-		BitWorker<1, 1> Z; //Zero
-		BitWorker<2, 1> I; //Interrupt Disable
-		BitWorker<3, 1> D; //Decimal (not used on NES)
-		BitWorker<4, 2> B; //"Break" flags
-		BitWorker<6, 1> V; //Overflow
-		BitWorker<7, 1> N; //Negative
-	};
+#include <algorithm>
+#include <cassert>
+
+const char* const mnemonicNames[] = {
+	"ADC", "AHX", "ALR", "ANC", "AND", "ARR", "ASL", "AXS", "BCC", "BCS",
+	"BEQ", "BIT", "BMI", "BNE", "BPL", "BRK", "BVC", "BVS", "CLC", "CLD",
+	"CLI", "CLV", "CMP", "CPX", "CPY", "DCP", "DEC", "DEX", "DEY", "EOR",
+	"INC", "INX", "INY", "ISC", "JMP", "JSR", "KIL", "LAS", "LAX", "LDA",
+	"LDX", "LDY", "LSR", "NOP", "ORA", "PHA", "PHP", "PLA", "PLP", "RLA",
+	"ROL", "ROR", "RRA", "RTI", "RTS", "SAX", "SBC", "SEC", "SED", "SEI",
+	"SHX", "SHY", "SLO", "SRE", "STA", "STX", "STY", "TAS", "TAX", "TAY",
+	"TSX", "TXA", "TXS", "TYA", "XAA",
 };
 
-struct CPURegisters {
-	uint16_t PC;
-	uint8_t SP;
-	uint8_t A;
-	uint8_t X;
-	uint8_t Y;
-	StatusReg P;
-} reg;
-
-enum AddressingMode {
-	ABSOLUTE,
-	ABSOLUTEX,
-	ABSOLUTEY,
-	ZEROPAGE,
-	ZEROPAGEX,
-	ZEROPAGEY,
-	IMMEDIATE,
-	RELATIVE,
-	IMPLICIT,
-	INDIRECT,
-	IDX_INDIRECT,
-	INDIRECT_IDX,
-};
+uint8_t CPU::PPUregGet(uint16_t addr, bool peek) {
+	syncComponents();
+	uint8_t returnedValue = console.ppu.regGet(0x2000 + (addr % 8), peek);	//PPU registers or mirrored
+	scheduleNextEvent();
+	return returnedValue;
+}
 
-struct OpInfo {
-	CPURegisters lastRegs;
-	uint8_t opCode;
-	std::string opName;
-	AddressingMode addrMode;
-	uint8_t addrL;
-	uint8_t addrH;
-	uint16_t actAddr;
-	uint8_t val;
-	unsigned long long CPUcycle;
-	int PPU_dot;
-	int PPU_SL;
-	std::string interrupts;
-} opInfo;
-
-std::array<uint8_t, 2048> RAM;
-uint8_t OAMDMA;
-uint8_t busVal;
-
-
-uint8_t memGet(uint16_t addr, bool peek) {
-	//Logic for grabbing 8bit value at address
-	//Handles mirroring, or which component to get data from
-	//CPU memory is from 0000-1FFF, but 0800-1FFF is mirrored
-	//Value is put onto bus first before returning, to allow for open bus behavior
+void CPU::PPUregSet(uint16_t addr, uint8_t val) {
+	syncComponents();
+	console.ppu.regSet(0x2000 + (addr % 8), val);	//PPU registers or mirrored
+	scheduleNextEvent();
+}
 
+uint8_t CPU::IOregGet(uint16_t addr, bool peek) {
+	//Page 0x40 holds the APU and IO registers, with gamepak memory from 0x4020
 	uint8_t returnedValue = busVal;
-	
-	if(addr < 0x2000) {			//CPU 2k internal memory space or mirrored
-		returnedValue = RAM[addr % 0x800];
-	}
-	else if(addr < 0x4000) {	//PPU registers or mirrored
-		returnedValue = PPU::regGet(0x2000 + (addr % 8), peek);
-	}
-	else if(addr < 0x4014) {	//APU registers
-		returnedValue = APU::regGet(addr, peek);
+	syncComponents();
+
+	if(addr < 0x4014) {			//APU registers
+		returnedValue = console.apu.regGet(addr, peek);
 	}
 	else if(addr == 0x4014) {	//OAMDMA register is write only
 		//Do nothing. busVal remains the same
 	}
 	else if(addr < 0x4016) {	//APU registers
-		returnedValue = APU::regGet(addr, peek);
+		returnedValue = console.apu.regGet(addr, peek);
 	}
 	else if(addr < 0x4018) {	//IO registers
-		returnedValue = IO::regGet(addr, peek);
+		returnedValue = console.io.regGet(addr, peek);
 	}
 	else if(addr < 0x4020) {
-		returnedValue = IO::regGet(addr, peek);	//APU registers
+		returnedValue = console.io.regGet(addr, peek);	//APU registers
 	}
 	else {
-		returnedValue = GAMEPAK::CPUmemGet(addr, peek);	//Gamepak memory
+		returnedValue = console.gamepak.CPUmemGet(addr, peek);	//Gamepak memory
 	}
-
-	if(peek == false) busVal = returnedValue;
+	scheduleNextEvent();
 	return returnedValue;
 }
 
-void memSet(uint16_t addr, uint8_t val) {
-	//Logic for setting 8bit value at address
-	//Handles mirroring, or which component to send data to
-	if(addr < 0x2000) {			//CPU memory space or mirrored
-		RAM[addr % 0x800] = val;
-	}
-	else if(addr < 0x4000) {	//PPU memory or mirrored
-		PPU::regSet(0x2000 + (addr % 8), val);
-	}
-	else if(addr < 0x4014) {	//APU registers
-		APU::regSet(addr, val);
+void CPU::IOregSet(uint16_t addr, uint8_t val) {
+	syncComponents();
+	if(addr < 0x4014) {			//APU registers
+		console.apu.regSet(addr, val);
 	}
 	else if(addr == 0x4014) {	//OAMDMA register
 		OAMDMA = val;
 		OAMDMA_write();
 	}
 	else if(addr < 0x4016) {	//APU registers
-		APU::regSet(addr, val);
+		console.apu.regSet(addr, val);
 	}
 	else if(addr == 0x4017) {
-		APU::regSet(addr, val);
+		console.apu.regSet(addr, val);
 	}
 	else if(addr < 0x4018) {	//IO registers
-		IO::regSet(addr, val);
+		console.io.regSet(addr, val);
 	}
 	else if(addr < 0x4020) {
-		APU::regSet(addr, val);	//APU registers
+		console.apu.regSet(addr, val);	//APU registers
 	}
 	else {
-		GAMEPAK::CPUmemSet(addr, val);	//Gamepak memory
+		console.gamepak.CPUmemSet(addr, val);	//Gamepak memory
+	}
+	scheduleNextEvent();
+}
+
+uint8_t CPU::cartGet(uint16_t addr, bool peek) {
+	return console.gamepak.CPUmemGet(addr, peek);
+}
+
+void CPU::cartSet(uint16_t addr, uint8_t val) {
+	//Mapper register writes can switch the banks and mirroring the PPU is using
+	syncComponents();
+	console.gamepak.CPUmemSet(addr, val);
+	scheduleNextEvent();
+}
+
+void CPU::setPageHandlers(unsigned int page, uint8_t (CPU::*readHandler)(uint16_t, bool), void (CPU::*writeHandler)(uint16_t, uint8_t)) {
+	pageTable[page] = {nullptr, nullptr, readHandler, writeHandler};
+}
+
+void CPU::initPageTable() {
+	//Gamepak pages (0x4100 and up) are left to the mapper
+	//CPU 2k internal memory space, mirrored up to 0x1FFF
+	for(unsigned int mirror = 0; mirror < 0x2000; mirror += 0x800)
+		mapMemory(mirror, 0x800, RAM.data(), 0x800, true);
+	for(unsigned int page = 0x20; page < 0x40; ++page)
+		setPageHandlers(page, &CPU::PPUregGet, &CPU::PPUregSet);
+	setPageHandlers(0x40, &CPU::IOregGet, &CPU::IOregSet);
+}
+
+void CPU::mapMemory(uint16_t addr, uint32_t size, uint8_t *mem, uint32_t memSize, bool writable) {
+	mapMemory(addr, size, (const uint8_t*)mem, memSize);
+	if(memSize == 0 || writable == false) return;
+	for(uint32_t offset = 0; offset < size; offset += 0x100)
+		pageTable[(addr + offset) >> 8].write = mem + (offset % memSize);
+}
+
+void CPU::mapMemory(uint16_t addr, uint32_t size, const uint8_t *mem, uint32_t memSize) {
+	if(memSize == 0) {
+		unmapMemory(addr, size);
+		return;
+	}
+	invalidateDecoded(addr, size);
+	for(uint32_t offset = 0; offset < size; offset += 0x100) {
+		MemPage &page = pageTable[(addr + offset) >> 8];
+		page.read = mem + (offset % memSize);
+		page.write = nullptr;
+		page.readHandler = &CPU::cartGet;
+		page.writeHandler = &CPU::cartSet;
+	}
+}
+
+void CPU::unmapMemory(uint16_t addr, uint32_t size) {
+	//Gamepak pages fall back to the mapper's memGet/memSet
+	invalidateDecoded(addr, size);
+	for(uint32_t offset = 0; offset < size; offset += 0x100)
+		setPageHandlers((addr + offset) >> 8, &CPU::cartGet, &CPU::cartSet);
+}
+
+void CPU::invalidateDecoded(uint16_t addr, uint32_t size) {
+	for(uint32_t offset = 0; offset < size; offset += 0x100) {
+		unsigned int page = (addr + offset) >> 8;
+		if(page >= 0x80) decodedPages[page - 0x80] = nullptr;
+	}
+}
+
+const CPU::DecodedOp *CPU::decodedOp(uint16_t addr) {
+	const MemPage &page = pageTable[addr >> 8];
+	if(addr < 0x8000 || page.read == nullptr || page.write)
+		return nullptr;
+	DecodedPage *&decoded = decodedPages[(addr >> 8) - 0x80];
+	if(decoded == nullptr) {
+		std::unique_ptr<DecodedPage> &cached = decodeCache[page.read];
+		if(cached == nullptr) cached.reset(new DecodedPage());
+		decoded = cached.get();
+	}
+	uint8_t offset = addr & 0xFF;
+	DecodedOp &op = (*decoded)[offset];
+	if(op.run == nullptr) {
+		op.opcode = page.read[offset];
+		const Instruction &instruction = opTable<false>[op.opcode];
+		unsigned int length = instructionLength(instruction.addrMode);
+		op.operandsCached = offset + length <= 0x100;
+		for(unsigned int i = 1; i < length && op.operandsCached; ++i)
+			op.operand[i - 1] = page.read[offset + i];
+		op.run = instruction.run;
+	}
+	return &op;
+}
+
+unsigned int CPU::instructionLength(AddressingMode mode) {
+	switch(mode) {
+		case IMPLICIT:
+			return 1;
+		case ABSOLUTE:
+		case ABSOLUTEX:
+		case ABSOLUTEY:
+		case INDIRECT:
+			return 3;
+		default:
+			return 2;
 	}
 }
 
+uint8_t CPU::memGet(uint16_t addr, bool peek) {
+	//Logic for grabbing 8bit value at address
+	//Value is put onto bus first before returning, to allow for open bus behavior
+	const MemPage &page = pageTable[addr >> 8];
+	uint8_t returnedValue;
+	if(page.read)
+		returnedValue = page.read[addr & 0xFF];
+	else
+		returnedValue = (this->*page.readHandler)(addr, peek);
+
+	if(peek == false) busVal = returnedValue;
+	return returnedValue;
+}
+
+void CPU::memSet(uint16_t addr, uint8_t val) {
+	const MemPage &page = pageTable[addr >> 8];
+	if(page.write)
+		page.write[addr & 0xFF] = val;
+	else
+		(this->*page.writeHandler)(addr, val);
+}
+
 
-void powerOn() {
+void CPU::powerOn() {
+	initPageTable();
 	reg.SP = 0xFD;
-	reg.P.value = 0;
+	reg.P.load(0);
 	reg.P.I = 1;
 	reg.PC = memGet(0xFFFC) | memGet(0xFFFD) << 8;
 	//NMI_line_went_low = NMI_triggered = false;
@@ -166,995 +218,533 @@ void powerOn() {
 	IRQsignal = IRQfromAPU = IRQfromCart = IRQdetected = IRQflag = false;
 	NMIsignal = NMIdetected = NMIflag = false;
 	cpuCycle = 0;
+	syncedCycle = nextEventCycle = 0;
+	idleLoop.valid = false;
+	//Addresses in the last ROM's image may be reused by this one
+	decodedPages.fill(nullptr);
+	decodeCache.clear();
+	if constexpr(PROFILER::enabled) PROFILER::reset(console.gamepak);
 	RAM.fill(0);
 }
 
-void reset() {
+void CPU::reset() {
 	//Per https://wiki.nesdev.com/w/index.php/CPU_power_up_state
 	reg.SP -= 3;
 	reg.P.I = true;
 	reg.PC = memGet(0xFFFC) | memGet(0xFFFD) << 8;
+	nextEventCycle = 0; //Components are reset after the CPU, so reschedule on the next cycle
+	idleLoop.valid = false;
 }
 
-void incCycle(bool ignoreIRQ) {
+void CPU::incCycle(bool ignoreIRQ) {
+	if(cpuCycle + 1 < nextEventCycle) {
+		//Nothing the CPU can see happens this cycle. Components are caught up later
+		++cpuCycle;
+		if(!ignoreIRQ) interruptDetect();
+		return;
+	}
+
+	syncComponents();
 	++cpuCycle;
-	PPU::step();
-	GAMEPAK::PPUstep();
+	syncedCycle = cpuCycle;
+	console.ppu.step();
+	console.gamepak.PPUstep();
 	// CPU/PPU/APU function actually happens concurrently. Placement of IRQ detect here has had the best results
 	if(!ignoreIRQ) interruptDetect(); 
-	PPU::step();
-	GAMEPAK::PPUstep();
-	PPU::step();
-	GAMEPAK::PPUstep();
-	APU::step();
-	GAMEPAK::CPUstep();
+	console.ppu.step();
+	console.gamepak.PPUstep();
+	console.ppu.step();
+	console.gamepak.PPUstep();
+	console.apu.step();
+	console.gamepak.CPUstep();
+	scheduleNextEvent();
+}
+
+void CPU::syncComponents() {
+	//Run the components for the cycles they are behind
+	//Lagging cycles have no CPU visible effects, so interrupt detection and mapper PPU clocking are skipped
+	//PPU and APU don't interact, so each is run for the whole gap at once
+	unsigned long long behind = cpuCycle - syncedCycle;
+	syncedCycle = cpuCycle;
+	if(behind == 0) return;
+	console.ppu.run(behind * 3);
+	for(unsigned long long i = 0; i < behind; ++i) {
+		console.apu.step();
+		console.gamepak.CPUstep();
+	}
+}
+
+void CPU::scheduleNextEvent() {
+	if(tracing || console.gamepak.clockedByPPU()) {
+		nextEventCycle = 0;
+		return;
+	}
+	//Three PPU dots and one APU step per CPU cycle
+	unsigned long long cyclesToPPUevent = (console.ppu.dotsToNextEvent() + 2) / 3;
+	unsigned long long cyclesToAPUevent = console.apu.stepsToNextEvent();
+	nextEventCycle = syncedCycle + std::min(cyclesToPPUevent, cyclesToAPUevent);
 }
 
-uint8_t cpuRead(uint16_t addr, bool ignoreIRQ)
+uint8_t CPU::cpuRead(uint16_t addr, bool ignoreIRQ)
 {
 	uint8_t value = memGet(addr);
 	incCycle(ignoreIRQ);
 	return value;
 }
 
-void cpuWrite(uint16_t addr, uint8_t val, bool ignoreIRQ)
+void CPU::cpuWrite(uint16_t addr, uint8_t val, bool ignoreIRQ)
 {
 	memSet(addr, val);
 	incCycle(ignoreIRQ);
 }
 
-void step() {
+//Glue for the decode table
+template<void (CPU::*op)()>
+void CPU::execute(CPU &cpu) {
+	(cpu.*op)();
+}
+
+template<void (CPU::*op)(uint16_t), uint16_t (CPU::*mode)()>
+void CPU::execute(CPU &cpu) {
+	(cpu.*op)((cpu.*mode)());
+}
+
+template<bool traced>
+const std::array<CPU::Instruction, 256> CPU::opTable = {{
+	{execute<&CPU::opBRK<traced>>,                              IMPLICIT,     BRK, 7},	//00
+	{execute<&CPU::opORA, &CPU::IndirectX<traced>>,             IDX_INDIRECT, ORA, 6},	//01
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//02
+	{execute<&CPU::opSLO, &CPU::IndirectX<traced>>,             IDX_INDIRECT, SLO, 8},	//03
+	{execute<&CPU::opNOP, &CPU::ZeroPage<traced>>,              ZEROPAGE,     NOP, 3},	//04
+	{execute<&CPU::opORA, &CPU::ZeroPage<traced>>,              ZEROPAGE,     ORA, 3},	//05
+	{execute<&CPU::opASL, &CPU::ZeroPage<traced>>,              ZEROPAGE,     ASL, 5},	//06
+	{execute<&CPU::opSLO, &CPU::ZeroPage<traced>>,              ZEROPAGE,     SLO, 5},	//07
+	{execute<&CPU::opPHP>,                                      IMPLICIT,     PHP, 3},	//08
+	{execute<&CPU::opORA, &CPU::Immediate<traced>>,             IMMEDIATE,    ORA, 2},	//09
+	{execute<&CPU::opASL>,                                      IMPLICIT,     ASL, 2},	//0A
+	{execute<&CPU::opANC, &CPU::Immediate<traced>>,             IMMEDIATE,    ANC, 2},	//0B
+	{execute<&CPU::opNOP, &CPU::Absolute<traced>>,              ABSOLUTE,     NOP, 4},	//0C
+	{execute<&CPU::opORA, &CPU::Absolute<traced>>,              ABSOLUTE,     ORA, 4},	//0D
+	{execute<&CPU::opASL, &CPU::Absolute<traced>>,              ABSOLUTE,     ASL, 6},	//0E
+	{execute<&CPU::opSLO, &CPU::Absolute<traced>>,              ABSOLUTE,     SLO, 6},	//0F
+	{execute<&CPU::opBPL<traced>>,                              RELATIVE,     BPL, 2},	//10
+	{execute<&CPU::opORA, &CPU::IndirectY<traced, READ>>,       INDIRECT_IDX, ORA, 5},	//11
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//12
+	{execute<&CPU::opSLO, &CPU::IndirectY<traced, READWRITE>>,  INDIRECT_IDX, SLO, 8},	//13
+	{execute<&CPU::opNOP, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    NOP, 4},	//14
+	{execute<&CPU::opORA, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    ORA, 4},	//15
+	{execute<&CPU::opASL, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    ASL, 6},	//16
+	{execute<&CPU::opSLO, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    SLO, 6},	//17
+	{execute<&CPU::opCLC>,                                      IMPLICIT,     CLC, 2},	//18
+	{execute<&CPU::opORA, &CPU::AbsoluteY<traced, READ>>,       ABSOLUTEY,    ORA, 4},	//19
+	{execute<&CPU::opNOP, &CPU::Implied>,                       IMPLICIT,     NOP, 2},	//1A
+	{execute<&CPU::opSLO, &CPU::AbsoluteY<traced, READWRITE>>,  ABSOLUTEY,    SLO, 7},	//1B
+	{execute<&CPU::opNOP, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    NOP, 4},	//1C
+	{execute<&CPU::opORA, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    ORA, 4},	//1D
+	{execute<&CPU::opASL, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    ASL, 7},	//1E
+	{execute<&CPU::opSLO, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    SLO, 7},	//1F
+	{execute<&CPU::opJSR, &CPU::Absolute<traced>>,              ABSOLUTE,     JSR, 6},	//20
+	{execute<&CPU::opAND, &CPU::IndirectX<traced>>,             IDX_INDIRECT, AND, 6},	//21
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//22
+	{execute<&CPU::opRLA, &CPU::IndirectX<traced>>,             IDX_INDIRECT, RLA, 8},	//23
+	{execute<&CPU::opBIT, &CPU::ZeroPage<traced>>,              ZEROPAGE,     BIT, 3},	//24
+	{execute<&CPU::opAND, &CPU::ZeroPage<traced>>,              ZEROPAGE,     AND, 3},	//25
+	{execute<&CPU::opROL, &CPU::ZeroPage<traced>>,              ZEROPAGE,     ROL, 5},	//26
+	{execute<&CPU::opRLA, &CPU::ZeroPage<traced>>,              ZEROPAGE,     RLA, 5},	//27
+	{execute<&CPU::opPLP>,                                      IMPLICIT,     PLP, 4},	//28
+	{execute<&CPU::opAND, &CPU::Immediate<traced>>,             IMMEDIATE,    AND, 2},	//29
+	{execute<&CPU::opROL>,                                      IMPLICIT,     ROL, 2},	//2A
+	{execute<&CPU::opANC, &CPU::Immediate<traced>>,             IMMEDIATE,    ANC, 2},	//2B
+	{execute<&CPU::opBIT, &CPU::Absolute<traced>>,              ABSOLUTE,     BIT, 4},	//2C
+	{execute<&CPU::opAND, &CPU::Absolute<traced>>,              ABSOLUTE,     AND, 4},	//2D
+	{execute<&CPU::opROL, &CPU::Absolute<traced>>,              ABSOLUTE,     ROL, 6},	//2E
+	{execute<&CPU::opRLA, &CPU::Absolute<traced>>,              ABSOLUTE,     RLA, 6},	//2F
+	{execute<&CPU::opBMI<traced>>,                              RELATIVE,     BMI, 2},	//30
+	{execute<&CPU::opAND, &CPU::IndirectY<traced, READ>>,       INDIRECT_IDX, AND, 5},	//31
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//32
+	{execute<&CPU::opRLA, &CPU::IndirectY<traced, READWRITE>>,  INDIRECT_IDX, RLA, 8},	//33
+	{execute<&CPU::opNOP, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    NOP, 4},	//34
+	{execute<&CPU::opAND, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    AND, 4},	//35
+	{execute<&CPU::opROL, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    ROL, 6},	//36
+	{execute<&CPU::opRLA, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    RLA, 6},	//37
+	{execute<&CPU::opSEC>,                                      IMPLICIT,     SEC, 2},	//38
+	{execute<&CPU::opAND, &CPU::AbsoluteY<traced, READ>>,       ABSOLUTEY,    AND, 4},	//39
+	{execute<&CPU::opNOP, &CPU::Implied>,                       IMPLICIT,     NOP, 2},	//3A
+	{execute<&CPU::opRLA, &CPU::AbsoluteY<traced, READWRITE>>,  ABSOLUTEY,    RLA, 7},	//3B
+	{execute<&CPU::opNOP, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    NOP, 4},	//3C
+	{execute<&CPU::opAND, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    AND, 4},	//3D
+	{execute<&CPU::opROL, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    ROL, 7},	//3E
+	{execute<&CPU::opRLA, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    RLA, 7},	//3F
+	{execute<&CPU::opRTI>,                                      IMPLICIT,     RTI, 6},	//40
+	{execute<&CPU::opEOR, &CPU::IndirectX<traced>>,             IDX_INDIRECT, EOR, 6},	//41
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//42
+	{execute<&CPU::opSRE, &CPU::IndirectX<traced>>,             IDX_INDIRECT, SRE, 8},	//43
+	{execute<&CPU::opNOP, &CPU::ZeroPage<traced>>,              ZEROPAGE,     NOP, 3},	//44
+	{execute<&CPU::opEOR, &CPU::ZeroPage<traced>>,              ZEROPAGE,     EOR, 3},	//45
+	{execute<&CPU::opLSR, &CPU::ZeroPage<traced>>,              ZEROPAGE,     LSR, 5},	//46
+	{execute<&CPU::opSRE, &CPU::ZeroPage<traced>>,              ZEROPAGE,     SRE, 5},	//47
+	{execute<&CPU::opPHA>,                                      IMPLICIT,     PHA, 3},	//48
+	{execute<&CPU::opEOR, &CPU::Immediate<traced>>,             IMMEDIATE,    EOR, 2},	//49
+	{execute<&CPU::opLSR>,                                      IMPLICIT,     LSR, 2},	//4A
+	{execute<&CPU::opALR, &CPU::Immediate<traced>>,             IMMEDIATE,    ALR, 2},	//4B
+	{execute<&CPU::opJMP, &CPU::Absolute<traced>>,              ABSOLUTE,     JMP, 3},	//4C
+	{execute<&CPU::opEOR, &CPU::Absolute<traced>>,              ABSOLUTE,     EOR, 4},	//4D
+	{execute<&CPU::opLSR, &CPU::Absolute<traced>>,              ABSOLUTE,     LSR, 6},	//4E
+	{execute<&CPU::opSRE, &CPU::Absolute<traced>>,              ABSOLUTE,     SRE, 6},	//4F
+	{execute<&CPU::opBVC<traced>>,                              RELATIVE,     BVC, 2},	//50
+	{execute<&CPU::opEOR, &CPU::IndirectY<traced, READ>>,       INDIRECT_IDX, EOR, 5},	//51
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//52
+	{execute<&CPU::opSRE, &CPU::IndirectY<traced, READWRITE>>,  INDIRECT_IDX, SRE, 8},	//53
+	{execute<&CPU::opNOP, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    NOP, 4},	//54
+	{execute<&CPU::opEOR, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    EOR, 4},	//55
+	{execute<&CPU::opLSR, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    LSR, 6},	//56
+	{execute<&CPU::opSRE, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    SRE, 6},	//57
+	{execute<&CPU::opCLI>,                                      IMPLICIT,     CLI, 2},	//58
+	{execute<&CPU::opEOR, &CPU::AbsoluteY<traced, READ>>,       ABSOLUTEY,    EOR, 4},	//59
+	{execute<&CPU::opNOP, &CPU::Implied>,                       IMPLICIT,     NOP, 2},	//5A
+	{execute<&CPU::opSRE, &CPU::AbsoluteY<traced, READWRITE>>,  ABSOLUTEY,    SRE, 7},	//5B
+	{execute<&CPU::opNOP, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    NOP, 4},	//5C
+	{execute<&CPU::opEOR, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    EOR, 4},	//5D
+	{execute<&CPU::opLSR, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    LSR, 7},	//5E
+	{execute<&CPU::opSRE, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    SRE, 7},	//5F
+	{execute<&CPU::opRTS>,                                      IMPLICIT,     RTS, 6},	//60
+	{execute<&CPU::opADC, &CPU::IndirectX<traced>>,             IDX_INDIRECT, ADC, 6},	//61
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//62
+	{execute<&CPU::opRRA, &CPU::IndirectX<traced>>,             IDX_INDIRECT, RRA, 8},	//63
+	{execute<&CPU::opNOP, &CPU::ZeroPage<traced>>,              ZEROPAGE,     NOP, 3},	//64
+	{execute<&CPU::opADC, &CPU::ZeroPage<traced>>,              ZEROPAGE,     ADC, 3},	//65
+	{execute<&CPU::opROR, &CPU::ZeroPage<traced>>,              ZEROPAGE,     ROR, 5},	//66
+	{execute<&CPU::opRRA, &CPU::ZeroPage<traced>>,              ZEROPAGE,     RRA, 5},	//67
+	{execute<&CPU::opPLA>,                                      IMPLICIT,     PLA, 4},	//68
+	{execute<&CPU::opADC, &CPU::Immediate<traced>>,             IMMEDIATE,    ADC, 2},	//69
+	{execute<&CPU::opROR>,                                      IMPLICIT,     ROR, 2},	//6A
+	{execute<&CPU::opARR, &CPU::Immediate<traced>>,             IMMEDIATE,    ARR, 2},	//6B
+	{execute<&CPU::opJMP, &CPU::Indirect<traced>>,              INDIRECT,     JMP, 5},	//6C
+	{execute<&CPU::opADC, &CPU::Absolute<traced>>,              ABSOLUTE,     ADC, 4},	//6D
+	{execute<&CPU::opROR, &CPU::Absolute<traced>>,              ABSOLUTE,     ROR, 6},	//6E
+	{execute<&CPU::opRRA, &CPU::Absolute<traced>>,              ABSOLUTE,     RRA, 6},	//6F
+	{execute<&CPU::opBVS<traced>>,                              RELATIVE,     BVS, 2},	//70
+	{execute<&CPU::opADC, &CPU::IndirectY<traced, READ>>,       INDIRECT_IDX, ADC, 5},	//71
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//72
+	{execute<&CPU::opRRA, &CPU::IndirectY<traced, READWRITE>>,  INDIRECT_IDX, RRA, 8},	//73
+	{execute<&CPU::opNOP, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    NOP, 4},	//74
+	{execute<&CPU::opADC, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    ADC, 4},	//75
+	{execute<&CPU::opROR, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    ROR, 6},	//76
+	{execute<&CPU::opRRA, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    RRA, 6},	//77
+	{execute<&CPU::opSEI>,                                      IMPLICIT,     SEI, 2},	//78
+	{execute<&CPU::opADC, &CPU::AbsoluteY<traced, READ>>,       ABSOLUTEY,    ADC, 4},	//79
+	{execute<&CPU::opNOP, &CPU::Implied>,                       IMPLICIT,     NOP, 2},	//7A
+	{execute<&CPU::opRRA, &CPU::AbsoluteY<traced, READWRITE>>,  ABSOLUTEY,    RRA, 7},	//7B
+	{execute<&CPU::opNOP, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    NOP, 4},	//7C
+	{execute<&CPU::opADC, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    ADC, 4},	//7D
+	{execute<&CPU::opROR, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    ROR, 7},	//7E
+	{execute<&CPU::opRRA, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    RRA, 7},	//7F
+	{execute<&CPU::opNOP, &CPU::Immediate<traced>>,             IMMEDIATE,    NOP, 2},	//80
+	{execute<&CPU::opSTA, &CPU::IndirectX<traced>>,             IDX_INDIRECT, STA, 6},	//81
+	{execute<&CPU::opNOP, &CPU::Immediate<traced>>,             IMMEDIATE,    NOP, 2},	//82
+	{execute<&CPU::opSAX, &CPU::IndirectX<traced>>,             IDX_INDIRECT, SAX, 6},	//83
+	{execute<&CPU::opSTY, &CPU::ZeroPage<traced>>,              ZEROPAGE,     STY, 3},	//84
+	{execute<&CPU::opSTA, &CPU::ZeroPage<traced>>,              ZEROPAGE,     STA, 3},	//85
+	{execute<&CPU::opSTX, &CPU::ZeroPage<traced>>,              ZEROPAGE,     STX, 3},	//86
+	{execute<&CPU::opSAX, &CPU::ZeroPage<traced>>,              ZEROPAGE,     SAX, 3},	//87
+	{execute<&CPU::opDEY>,                                      IMPLICIT,     DEY, 2},	//88
+	{execute<&CPU::opNOP, &CPU::Immediate<traced>>,             IMMEDIATE,    NOP, 2},	//89
+	{execute<&CPU::opTXA>,                                      IMPLICIT,     TXA, 2},	//8A
+	{execute<&CPU::opXAA, &CPU::Immediate<traced>>,             IMMEDIATE,    XAA, 2},	//8B
+	{execute<&CPU::opSTY, &CPU::Absolute<traced>>,              ABSOLUTE,     STY, 4},	//8C
+	{execute<&CPU::opSTA, &CPU::Absolute<traced>>,              ABSOLUTE,     STA, 4},	//8D
+	{execute<&CPU::opSTX, &CPU::Absolute<traced>>,              ABSOLUTE,     STX, 4},	//8E
+	{execute<&CPU::opSAX, &CPU::Absolute<traced>>,              ABSOLUTE,     SAX, 4},	//8F
+	{execute<&CPU::opBCC<traced>>,                              RELATIVE,     BCC, 2},	//90
+	{execute<&CPU::opSTA, &CPU::IndirectY<traced, WRITE>>,      INDIRECT_IDX, STA, 6},	//91
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//92
+	{execute<&CPU::opAHX, &CPU::IndirectY<traced, WRITE>>,      INDIRECT_IDX, AHX, 6},	//93
+	{execute<&CPU::opSTY, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    STY, 4},	//94
+	{execute<&CPU::opSTA, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    STA, 4},	//95
+	{execute<&CPU::opSTX, &CPU::ZeroPageY<traced>>,             ZEROPAGEY,    STX, 4},	//96
+	{execute<&CPU::opSAX, &CPU::ZeroPageY<traced>>,             ZEROPAGEY,    SAX, 4},	//97
+	{execute<&CPU::opTYA>,                                      IMPLICIT,     TYA, 2},	//98
+	{execute<&CPU::opSTA, &CPU::AbsoluteY<traced, WRITE>>,      ABSOLUTEY,    STA, 5},	//99
+	{execute<&CPU::opTXS>,                                      IMPLICIT,     TXS, 2},	//9A
+	{execute<&CPU::opTAS, &CPU::AbsoluteY<traced, WRITE>>,      ABSOLUTEY,    TAS, 5},	//9B
+	{execute<&CPU::opSHY, &CPU::AbsoluteX<traced, WRITE>>,      ABSOLUTEX,    SHY, 5},	//9C
+	{execute<&CPU::opSTA, &CPU::AbsoluteX<traced, WRITE>>,      ABSOLUTEX,    STA, 5},	//9D
+	{execute<&CPU::opSHX, &CPU::AbsoluteY<traced, WRITE>>,      ABSOLUTEY,    SHX, 5},	//9E
+	{execute<&CPU::opAHX, &CPU::AbsoluteY<traced, WRITE>>,      ABSOLUTEY,    AHX, 5},	//9F
+	{execute<&CPU::opLDY, &CPU::Immediate<traced>>,             IMMEDIATE,    LDY, 2},	//A0
+	{execute<&CPU::opLDA, &CPU::IndirectX<traced>>,             IDX_INDIRECT, LDA, 6},	//A1
+	{execute<&CPU::opLDX, &CPU::Immediate<traced>>,             IMMEDIATE,    LDX, 2},	//A2
+	{execute<&CPU::opLAX, &CPU::IndirectX<traced>>,             IDX_INDIRECT, LAX, 6},	//A3
+	{execute<&CPU::opLDY, &CPU::ZeroPage<traced>>,              ZEROPAGE,     LDY, 3},	//A4
+	{execute<&CPU::opLDA, &CPU::ZeroPage<traced>>,              ZEROPAGE,     LDA, 3},	//A5
+	{execute<&CPU::opLDX, &CPU::ZeroPage<traced>>,              ZEROPAGE,     LDX, 3},	//A6
+	{execute<&CPU::opLAX, &CPU::ZeroPage<traced>>,              ZEROPAGE,     LAX, 3},	//A7
+	{execute<&CPU::opTAY>,                                      IMPLICIT,     TAY, 2},	//A8
+	{execute<&CPU::opLDA, &CPU::Immediate<traced>>,             IMMEDIATE,    LDA, 2},	//A9
+	{execute<&CPU::opTAX>,                                      IMPLICIT,     TAX, 2},	//AA
+	{execute<&CPU::opLAX, &CPU::Immediate<traced>>,             IMMEDIATE,    LAX, 2},	//AB
+	{execute<&CPU::opLDY, &CPU::Absolute<traced>>,              ABSOLUTE,     LDY, 4},	//AC
+	{execute<&CPU::opLDA, &CPU::Absolute<traced>>,              ABSOLUTE,     LDA, 4},	//AD
+	{execute<&CPU::opLDX, &CPU::Absolute<traced>>,              ABSOLUTE,     LDX, 4},	//AE
+	{execute<&CPU::opLAX, &CPU::Absolute<traced>>,              ABSOLUTE,     LAX, 4},	//AF
+	{execute<&CPU::opBCS<traced>>,                              RELATIVE,     BCS, 2},	//B0
+	{execute<&CPU::opLDA, &CPU::IndirectY<traced, READ>>,       INDIRECT_IDX, LDA, 5},	//B1
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//B2
+	{execute<&CPU::opLAX, &CPU::IndirectY<traced, READ>>,       INDIRECT_IDX, LAX, 5},	//B3
+	{execute<&CPU::opLDY, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    LDY, 4},	//B4
+	{execute<&CPU::opLDA, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    LDA, 4},	//B5
+	{execute<&CPU::opLDX, &CPU::ZeroPageY<traced>>,             ZEROPAGEY,    LDX, 4},	//B6
+	{execute<&CPU::opLAX, &CPU::ZeroPageY<traced>>,             ZEROPAGEY,    LAX, 4},	//B7
+	{execute<&CPU::opCLV>,                                      IMPLICIT,     CLV, 2},	//B8
+	{execute<&CPU::opLDA, &CPU::AbsoluteY<traced, READ>>,       ABSOLUTEY,    LDA, 4},	//B9
+	{execute<&CPU::opTSX>,                                      IMPLICIT,     TSX, 2},	//BA
+	{execute<&CPU::opLAS, &CPU::AbsoluteY<traced, READ>>,       ABSOLUTEY,    LAS, 4},	//BB
+	{execute<&CPU::opLDY, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    LDY, 4},	//BC
+	{execute<&CPU::opLDA, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    LDA, 4},	//BD
+	{execute<&CPU::opLDX, &CPU::AbsoluteY<traced, READ>>,       ABSOLUTEY,    LDX, 4},	//BE
+	{execute<&CPU::opLAX, &CPU::AbsoluteY<traced, READ>>,       ABSOLUTEY,    LAX, 4},	//BF
+	{execute<&CPU::opCPY, &CPU::Immediate<traced>>,             IMMEDIATE,    CPY, 2},	//C0
+	{execute<&CPU::opCMP, &CPU::IndirectX<traced>>,             IDX_INDIRECT, CMP, 6},	//C1
+	{execute<&CPU::opNOP, &CPU::Immediate<traced>>,             IMMEDIATE,    NOP, 2},	//C2
+	{execute<&CPU::opDCP, &CPU::IndirectX<traced>>,             IDX_INDIRECT, DCP, 8},	//C3
+	{execute<&CPU::opCPY, &CPU::ZeroPage<traced>>,              ZEROPAGE,     CPY, 3},	//C4
+	{execute<&CPU::opCMP, &CPU::ZeroPage<traced>>,              ZEROPAGE,     CMP, 3},	//C5
+	{execute<&CPU::opDEC, &CPU::ZeroPage<traced>>,              ZEROPAGE,     DEC, 5},	//C6
+	{execute<&CPU::opDCP, &CPU::ZeroPage<traced>>,              ZEROPAGE,     DCP, 5},	//C7
+	{execute<&CPU::opINY>,                                      IMPLICIT,     INY, 2},	//C8
+	{execute<&CPU::opCMP, &CPU::Immediate<traced>>,             IMMEDIATE,    CMP, 2},	//C9
+	{execute<&CPU::opDEX>,                                      IMPLICIT,     DEX, 2},	//CA
+	{execute<&CPU::opAXS, &CPU::Immediate<traced>>,             IMMEDIATE,    AXS, 2},	//CB
+	{execute<&CPU::opCPY, &CPU::Absolute<traced>>,              ABSOLUTE,     CPY, 4},	//CC
+	{execute<&CPU::opCMP, &CPU::Absolute<traced>>,              ABSOLUTE,     CMP, 4},	//CD
+	{execute<&CPU::opDEC, &CPU::Absolute<traced>>,              ABSOLUTE,     DEC, 6},	//CE
+	{execute<&CPU::opDCP, &CPU::Absolute<traced>>,              ABSOLUTE,     DCP, 6},	//CF
+	{execute<&CPU::opBNE<traced>>,                              RELATIVE,     BNE, 2},	//D0
+	{execute<&CPU::opCMP, &CPU::IndirectY<traced, READ>>,       INDIRECT_IDX, CMP, 5},	//D1
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//D2
+	{execute<&CPU::opDCP, &CPU::IndirectY<traced, READWRITE>>,  INDIRECT_IDX, DCP, 8},	//D3
+	{execute<&CPU::opNOP, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    NOP, 4},	//D4
+	{execute<&CPU::opCMP, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    CMP, 4},	//D5
+	{execute<&CPU::opDEC, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    DEC, 6},	//D6
+	{execute<&CPU::opDCP, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    DCP, 6},	//D7
+	{execute<&CPU::opCLD>,                                      IMPLICIT,     CLD, 2},	//D8
+	{execute<&CPU::opCMP, &CPU::AbsoluteY<traced, READ>>,       ABSOLUTEY,    CMP, 4},	//D9
+	{execute<&CPU::opNOP, &CPU::Implied>,                       IMPLICIT,     NOP, 2},	//DA
+	{execute<&CPU::opDCP, &CPU::AbsoluteY<traced, READWRITE>>,  ABSOLUTEY,    DCP, 7},	//DB
+	{execute<&CPU::opNOP, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    NOP, 4},	//DC
+	{execute<&CPU::opCMP, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    CMP, 4},	//DD
+	{execute<&CPU::opDEC, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    DEC, 7},	//DE
+	{execute<&CPU::opDCP, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    DCP, 7},	//DF
+	{execute<&CPU::opCPX, &CPU::Immediate<traced>>,             IMMEDIATE,    CPX, 2},	//E0
+	{execute<&CPU::opSBC, &CPU::IndirectX<traced>>,             IDX_INDIRECT, SBC, 6},	//E1
+	{execute<&CPU::opNOP, &CPU::Immediate<traced>>,             IMMEDIATE,    NOP, 2},	//E2
+	{execute<&CPU::opISC, &CPU::IndirectX<traced>>,             IDX_INDIRECT, ISC, 8},	//E3
+	{execute<&CPU::opCPX, &CPU::ZeroPage<traced>>,              ZEROPAGE,     CPX, 3},	//E4
+	{execute<&CPU::opSBC, &CPU::ZeroPage<traced>>,              ZEROPAGE,     SBC, 3},	//E5
+	{execute<&CPU::opINC, &CPU::ZeroPage<traced>>,              ZEROPAGE,     INC, 5},	//E6
+	{execute<&CPU::opISC, &CPU::ZeroPage<traced>>,              ZEROPAGE,     ISC, 5},	//E7
+	{execute<&CPU::opINX>,                                      IMPLICIT,     INX, 2},	//E8
+	{execute<&CPU::opSBC, &CPU::Immediate<traced>>,             IMMEDIATE,    SBC, 2},	//E9
+	{execute<&CPU::opNOP, &CPU::Implied>,                       IMPLICIT,     NOP, 2},	//EA
+	{execute<&CPU::opSBC, &CPU::Immediate<traced>>,             IMMEDIATE,    SBC, 2},	//EB
+	{execute<&CPU::opCPX, &CPU::Absolute<traced>>,              ABSOLUTE,     CPX, 4},	//EC
+	{execute<&CPU::opSBC, &CPU::Absolute<traced>>,              ABSOLUTE,     SBC, 4},	//ED
+	{execute<&CPU::opINC, &CPU::Absolute<traced>>,              ABSOLUTE,     INC, 6},	//EE
+	{execute<&CPU::opISC, &CPU::Absolute<traced>>,              ABSOLUTE,     ISC, 6},	//EF
+	{execute<&CPU::opBEQ<traced>>,                              RELATIVE,     BEQ, 2},	//F0
+	{execute<&CPU::opSBC, &CPU::IndirectY<traced, READ>>,       INDIRECT_IDX, SBC, 5},	//F1
+	{execute<&CPU::opKIL>,                                      IMPLICIT,     KIL, 0},	//F2
+	{execute<&CPU::opISC, &CPU::IndirectY<traced, READWRITE>>,  INDIRECT_IDX, ISC, 8},	//F3
+	{execute<&CPU::opNOP, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    NOP, 4},	//F4
+	{execute<&CPU::opSBC, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    SBC, 4},	//F5
+	{execute<&CPU::opINC, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    INC, 6},	//F6
+	{execute<&CPU::opISC, &CPU::ZeroPageX<traced>>,             ZEROPAGEX,    ISC, 6},	//F7
+	{execute<&CPU::opSED>,                                      IMPLICIT,     SED, 2},	//F8
+	{execute<&CPU::opSBC, &CPU::AbsoluteY<traced, READ>>,       ABSOLUTEY,    SBC, 4},	//F9
+	{execute<&CPU::opNOP, &CPU::Implied>,                       IMPLICIT,     NOP, 2},	//FA
+	{execute<&CPU::opISC, &CPU::AbsoluteY<traced, READWRITE>>,  ABSOLUTEY,    ISC, 7},	//FB
+	{execute<&CPU::opNOP, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    NOP, 4},	//FC
+	{execute<&CPU::opSBC, &CPU::AbsoluteX<traced, READ>>,       ABSOLUTEX,    SBC, 4},	//FD
+	{execute<&CPU::opINC, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    INC, 7},	//FE
+	{execute<&CPU::opISC, &CPU::AbsoluteX<traced, READWRITE>>,  ABSOLUTEX,    ISC, 7},	//FF
+}};
+
+bool CPU::isIdleLoop(uint16_t start, uint16_t end) {
+	//Walks the loop body, which has to end in the jump back to start
+	//Only register, flag and branch instructions and reads from plain memory or PPUSTATUS are allowed
+	if(end - start >= (int)maxIdleLoopSize)
+		return false;
+	uint16_t addr = start;
+	while(addr <= end) {
+		if(pageTable[addr >> 8].read == nullptr)
+			return false;
+		const Instruction &instruction = opTable<false>[memGet(addr, true)];
+		unsigned int length;
+		switch(instruction.addrMode) {
+			case IMPLICIT:	length = 1; break;
+			case IMMEDIATE:
+			case ZEROPAGE:
+			case RELATIVE:	length = 2; break;
+			case ABSOLUTE:	length = 3; break;
+			default:		return false;
+		}
+		for(unsigned int i = 0; i < length; ++i) {
+			if(pageTable[(uint16_t)(addr + i) >> 8].read == nullptr)
+				return false;
+		}
+		switch(instruction.mnemonic) {
+			case LDA: case LDX: case LDY: case BIT: case CMP: case CPX: case CPY:
+			case AND: case ORA: case EOR: case ADC: case SBC: case NOP:
+				if(instruction.addrMode == ABSOLUTE) {
+					uint16_t operand = memGet(addr + 1, true) | memGet(addr + 2, true) << 8;
+					//PPUSTATUS reads only clear flags, and the PPU only sets them on an event, so
+					//every read after the first returns the same value until the next event
+					bool isPPUSTATUS = operand >= 0x2000 && operand < 0x4000 && (operand & 7) == 2;
+					if(pageTable[operand >> 8].read == nullptr && !isPPUSTATUS)
+						return false;
+				}
+				break;
+			case TAX: case TAY: case TXA: case TYA: case INX: case INY: case DEX: case DEY:
+			case CLC: case SEC: case CLV:
+				if(instruction.addrMode != IMPLICIT)
+					return false;
+				break;
+			case BCC: case BCS: case BEQ: case BNE: case BMI: case BPL: case BVC: case BVS:
+				break;
+			case JMP:
+				break;
+			default:
+				return false;
+		}
+		if(addr == end)
+			return instruction.addrMode == RELATIVE || instruction.mnemonic == JMP;
+		addr += length;
+	}
+	return false;
+}
+
+void CPU::checkIdleLoop(uint16_t start, uint16_t end) {
+	//Called for each backwards jump, with start the new PC and end the address of the jump
+	if(!idleLoop.valid || idleLoop.start != start || idleLoop.end != end) {
+		idleLoop.valid = true;
+		idleLoop.start = start;
+		idleLoop.end = end;
+		idleLoop.idle = isIdleLoop(start, end);
+	}
+	else if(idleLoop.idle) {
+		bool sameState = idleLoop.A == reg.A && idleLoop.X == reg.X && idleLoop.Y == reg.Y
+			&& idleLoop.SP == reg.SP && idleLoop.P == reg.P.value() && idleLoop.busVal == busVal;
+		//Interrupt lines only change on component events, which are never skipped
+		bool interruptPending = NMIsignal || NMIdetected || NMIflag || IRQdetected || IRQflag
+			|| (IRQsignal && reg.P.I == false);
+		//An event during the last pass may have changed what it read (eg vblank set after a PPUSTATUS read),
+		//so the pass after it has to run for real first
+		bool eventRan = idleLoop.eventCycle != nextEventCycle;
+		//A skipped cycle has to take the fast path in incCycle, so stop one short of the event
+		//Nothing is skipped once the frame is done, so Console::frameStep returns on the same cycle
+		if(sameState && !interruptPending && !eventRan && !console.ppu.isframeReady() && nextEventCycle > cpuCycle + 1) {
+			unsigned long long loopCycles = cpuCycle - idleLoop.headCycle;
+			cpuCycle += (nextEventCycle - 1 - cpuCycle) / loopCycles * loopCycles;
+		}
+	}
+	idleLoop.A = reg.A;
+	idleLoop.X = reg.X;
+	idleLoop.Y = reg.Y;
+	idleLoop.SP = reg.SP;
+	idleLoop.P = reg.P.value();
+	idleLoop.busVal = busVal;
+	idleLoop.headCycle = cpuCycle;
+	idleLoop.eventCycle = nextEventCycle;
+}
+
+template<bool traced>
+void CPU::stepInstruction() {
 	uint8_t opcode;
+	uint16_t opcodeAddr = reg.PC;
+	[[maybe_unused]] unsigned long long startCycle = cpuCycle;
+	[[maybe_unused]] uint8_t startSP = reg.SP;
+	const DecodedOp *decoded = nullptr;
+	operands = nullptr;
 	if(IRQflag | NMIflag) {
+		//The handler may change the memory an idle loop is polling
+		idleLoop.valid = false;
 		opBRKonIRQ();
+		if constexpr(PROFILER::enabled) PROFILER::call(reg.PC, startSP, cpuCycle - startCycle);
 		return;
 	}
 	else {
-		if(NES::logging) {
-			opInfo.lastRegs.PC = reg.PC;
-			opInfo.lastRegs.A = reg.A;
-			opInfo.lastRegs.X = reg.X;
-			opInfo.lastRegs.Y = reg.Y;
-			opInfo.lastRegs.SP = reg.SP;
-			opInfo.lastRegs.P.value = reg.P.value;
-			opInfo.CPUcycle = cpuCycle;
-			opInfo.PPU_dot = PPU::dot;
-			opInfo.PPU_SL = PPU::scanline;
+		if constexpr(traced) {
+			TRACE::Record &record = opInfo.record;
+			record.type = TRACE::INSTRUCTION;
+			record.PC = reg.PC;
+			record.A = reg.A;
+			record.X = reg.X;
+			record.Y = reg.Y;
+			record.SP = reg.SP;
+			record.P = reg.P.value();
+			record.cpuCycle = cpuCycle;
+			record.dot = console.ppu.dot;
+			record.scanline = console.ppu.scanline;
+			record.operand[0] = record.operand[1] = 0;
+			record.effectiveAddr = 0;
 		}
-		opcode = cpuRead(reg.PC);
+		if constexpr(!traced) decoded = decodedOp(reg.PC);
+		if(decoded) {
+			//Same bus cycle as cpuRead, without the page lookup
+			opcode = busVal = decoded->opcode;
+			incCycle();
+			if(decoded->operandsCached) operands = decoded->operand;
+		}
+		else
+			opcode = cpuRead(reg.PC);
 		++reg.PC;
+	}
 
-		if(NES::logging) {
-			opInfo.opCode = opcode;
-		}
+	const Instruction &instruction = opTable<traced>[opcode];
+	if constexpr(traced) opInfo.record.opcode = opcode;
+	if(decoded)
+		decoded->run(*this);
+	else
+		instruction.run(*this);
+
+	if constexpr(traced) {
+		//Check the bus cycles actually spent against the table. Page crossings and taken branches add
+		//up to two, sprite DMA adds its own. KIL has no count, it stops the CPU
+		[[maybe_unused]] unsigned long long busCycles = cpuCycle - startCycle;
+		if(opInfo.spriteDMA) busCycles -= opInfo.DMAendCycle - opInfo.DMAstartCycle;
+		assert(instruction.mnemonic == KIL
+			|| (busCycles >= instruction.cycles && busCycles <= instruction.cycles + 2u));
+		logStep();
 	}
-	if(NES::logging) opInfo.addrMode = AddressingMode::IMPLICIT;
-	switch (opcode) {
-		case 0x69:
-			if(NES::logging) opInfo.opName = "ADC";
-			opADC(Immediate());
-			break;
-		case 0x65:
-			if(NES::logging) opInfo.opName = "ADC";
-			opADC(ZeroPage());
-			break;
-		case 0x75:
-			if(NES::logging) opInfo.opName = "ADC";
-			opADC(ZeroPageX());
-			break;
-		case 0x6D:
-			if(NES::logging) opInfo.opName = "ADC";
-			opADC(Absolute());
-			break;
-		case 0x7D:
-			if(NES::logging) opInfo.opName = "ADC";
-			opADC(AbsoluteX(READ));
-			break;
-		case 0x79:
-			if(NES::logging) opInfo.opName = "ADC";
-			opADC(AbsoluteY(READ));
-			break;
-		case 0x61:
-			if(NES::logging) opInfo.opName = "ADC";
-			opADC(IndirectX());
-			break;
-		case 0x71:
-			if(NES::logging) opInfo.opName = "ADC";
-			opADC(IndirectY(READ));
-			break;
-		case 0x93:
-			if(NES::logging) opInfo.opName = "AHX";
-			opAHX(IndirectY(WRITE));
-			break;
-		case 0x9F:
-			if(NES::logging) opInfo.opName = "AHX";
-			opAHX(AbsoluteY(WRITE));
-			break;
-		case 0x4B:
-			if(NES::logging) opInfo.opName = "ALR";
-			opALR(Immediate());
-			break;
-		case 0x0B:
-			if(NES::logging) opInfo.opName = "ANC";
-			opANC(Immediate());
-			break;
-		case 0x2B:
-			if(NES::logging) opInfo.opName = "ANC";
-			opANC(Immediate());
-			break;	
-		case 0x29:
-			if(NES::logging) opInfo.opName = "AND";
-			opAND(Immediate());
-			break;
-		case 0x25:
-			if(NES::logging) opInfo.opName = "AND";
-			opAND(ZeroPage());
-			break;
-		case 0x35:
-			if(NES::logging) opInfo.opName = "AND";
-			opAND(ZeroPageX());
-			break;
-		case 0x2D:
-			if(NES::logging) opInfo.opName = "AND";
-			opAND(Absolute());
-			break;
-		case 0x3D:
-			if(NES::logging) opInfo.opName = "AND";
-			opAND(AbsoluteX(READ));
-			break;
-		case 0x39:
-			if(NES::logging) opInfo.opName = "AND";
-			opAND(AbsoluteY(READ));
-			break;
-		case 0x21:
-			if(NES::logging) opInfo.opName = "AND";
-			opAND(IndirectX());
-			break;
-		case 0x31:
-			if(NES::logging) opInfo.opName = "AND";
-			opAND(IndirectY(READ));
-			break;
-		case 0x6B:
-			if(NES::logging) opInfo.opName = "ARR";
-			opARR(Immediate());
-			break;
-		case 0x0A:
-			if(NES::logging) opInfo.opName = "ASL";
-			opASL();
-			break;
-		case 0x06:
-			if(NES::logging) opInfo.opName = "ASL";
-			opASL(ZeroPage());
-			break;
-		case 0x16:
-			if(NES::logging) opInfo.opName = "ASL";
-			opASL(ZeroPageX());
-			break;
-		case 0x0E:
-			if(NES::logging) opInfo.opName = "ASL";
-			opASL(Absolute());
-			break;
-		case 0x1E:
-			if(NES::logging) opInfo.opName = "ASL";
-			opASL(AbsoluteX(READWRITE));
-			break;
-		case 0xCB:
-			if(NES::logging) opInfo.opName = "AXS";
-			opAXS(Immediate());
-			break;
-		case 0x90:
-			if(NES::logging) {
-				opInfo.opName = "BCC";
-				opInfo.addrMode = AddressingMode::RELATIVE;
-			}
-			opBCC();
-			break;
-		case 0xB0:
-			if(NES::logging) {
-				opInfo.opName = "BCS";
-				opInfo.addrMode = AddressingMode::RELATIVE;
-			}
-			opBCS();
-			break;
-		case 0xF0:
-			if(NES::logging) {
-				opInfo.opName = "BEQ";
-				opInfo.addrMode = AddressingMode::RELATIVE;
-			}
-			opBEQ();
-			break;
-		case 0x24:
-			if(NES::logging) opInfo.opName = "BIT";
-			opBIT(ZeroPage());
-			break;
-		case 0x2C:
-			if(NES::logging) opInfo.opName = "BIT";
-			opBIT(Absolute());
-			break;
-		case 0x30:
-			if(NES::logging) {
-				opInfo.opName = "BMI";
-				opInfo.addrMode = AddressingMode::RELATIVE;
-			}
-			opBMI();
-			break;
-		case 0xD0:
-			if(NES::logging) {
-				opInfo.opName = "BNE";
-				opInfo.addrMode = AddressingMode::RELATIVE;
-			}
-			opBNE();
-			break;
-		case 0x10:
-			if(NES::logging) {
-				opInfo.opName = "BPL";
-				opInfo.addrMode = AddressingMode::RELATIVE;
-			}
-			opBPL();
-			break;	
-		case 0x00:
-			if(NES::logging) opInfo.opName = "BRK";
-			opBRK();
-			break;
-		case 0x50:
-			if(NES::logging) {
-				opInfo.opName = "BVC";
-				opInfo.addrMode = AddressingMode::RELATIVE;
-			}
-			opBVC();
-			break;
-		case 0x70:
-			if(NES::logging) {
-				opInfo.opName = "BVS";
-				opInfo.addrMode = AddressingMode::RELATIVE;
-			}
-			opBVS();
-			break;
-		case 0x18:
-			if(NES::logging) opInfo.opName = "CLC";
-			opCLC();
-			break;
-		case 0xD8:
-			if(NES::logging) opInfo.opName = "CLD";
-			opCLD();
-			break;
-		case 0x58:
-			if(NES::logging) opInfo.opName = "CLI";
-			opCLI();
-			break;
-		case 0xB8:
-			if(NES::logging) opInfo.opName = "CLV";
-			opCLV();
-			break;
-		case 0xC9:
-			if(NES::logging) opInfo.opName = "CMP";
-			opCMP(Immediate());
-			break;
-		case 0xC5:
-			if(NES::logging) opInfo.opName = "CMP";
-			opCMP(ZeroPage());
-			break;
-		case 0xD5:
-			if(NES::logging) opInfo.opName = "CMP";
-			opCMP(ZeroPageX());
-			break;
-		case 0xCD:
-			if(NES::logging) opInfo.opName = "CMP";
-			opCMP(Absolute());
-			break;
-		case 0xDD:
-			if(NES::logging) opInfo.opName = "CMP";
-			opCMP(AbsoluteX(READ));
-			break;
-		case 0xD9:
-			if(NES::logging) opInfo.opName = "CMP";
-			opCMP(AbsoluteY(READ));
-			break;
-		case 0xC1:
-			if(NES::logging) opInfo.opName = "CMP";
-			opCMP(IndirectX());
-			break;
-		case 0xD1:
-			if(NES::logging) opInfo.opName = "CMP";
-			opCMP(IndirectY(READ));
-			break;
-		case 0xE0:
-			if(NES::logging) opInfo.opName = "CPX";
-			opCPX(Immediate());
-			break;
-		case 0xE4:
-			if(NES::logging) opInfo.opName = "CPX";
-			opCPX(ZeroPage());
-			break;
-		case 0xEC:
-			if(NES::logging) opInfo.opName = "CPX";
-			opCPX(Absolute());
-			break;
-		case 0xC0:
-			if(NES::logging) opInfo.opName = "CPY";
-			opCPY(Immediate());
-			break;
-		case 0xC4:
-			if(NES::logging) opInfo.opName = "CPY";
-			opCPY(ZeroPage());
-			break;
-		case 0xCC:
-			if(NES::logging) opInfo.opName = "CPY";
-			opCPY(Absolute());
-			break;
-		case 0xC3:
-			if(NES::logging) opInfo.opName = "DCP";
-			opDCP(IndirectX());
-			break;
-		case 0xC7:
-			if(NES::logging) opInfo.opName = "DCP";
-			opDCP(ZeroPage());
-			break;
-		case 0xCF:
-			if(NES::logging) opInfo.opName = "DCP";
-			opDCP(Absolute());
-			break;
-		case 0xD3:
-			if(NES::logging) opInfo.opName = "DCP";
-			opDCP(IndirectY(READWRITE));
-			break;
-		case 0xD7:
-			if(NES::logging) opInfo.opName = "DCP";
-			opDCP(ZeroPageX());
-			break;
-		case 0xDB:
-			if(NES::logging) opInfo.opName = "DCP";
-			opDCP(AbsoluteY(READWRITE));
-			break;
-		case 0xDF:
-			if(NES::logging) opInfo.opName = "DCP";
-			opDCP(AbsoluteX(READWRITE));
-			break;	
-		case 0xC6:
-			if(NES::logging) opInfo.opName = "DEC";
-			opDEC(ZeroPage());
-			break;
-		case 0xD6:
-			if(NES::logging) opInfo.opName = "DEC";
-			opDEC(ZeroPageX());
-			break;
-		case 0xCE:
-			if(NES::logging) opInfo.opName = "DEC";
-			opDEC(Absolute());
-			break;
-		case 0xDE:
-			if(NES::logging) opInfo.opName = "DEC";
-			opDEC(AbsoluteX(READWRITE));
-			break;
-		case 0xCA:
-			if(NES::logging) opInfo.opName = "DEX";
-			opDEX();
-			break;
-		case 0x88:
-			if(NES::logging) opInfo.opName = "DEY";
-			opDEY();
-			break;
-		case 0x49:
-			if(NES::logging) opInfo.opName = "EOR";
-			opEOR(Immediate());
-			break;
-		case 0x45:
-			if(NES::logging) opInfo.opName = "EOR";
-			opEOR(ZeroPage());
-			break;
-		case 0x55:
-			if(NES::logging) opInfo.opName = "EOR";
-			opEOR(ZeroPageX());
-			break;
-		case 0x4D:
-			if(NES::logging) opInfo.opName = "EOR";
-			opEOR(Absolute());
-			break;
-		case 0x5D:
-			if(NES::logging) opInfo.opName = "EOR";
-			opEOR(AbsoluteX(READ));
-			break;
-		case 0x59:
-			if(NES::logging) opInfo.opName = "EOR";
-			opEOR(AbsoluteY(READ));
-			break;
-		case 0x41:
-			if(NES::logging) opInfo.opName = "EOR";
-			opEOR(IndirectX());
-			break;
-		case 0x51:
-			if(NES::logging) opInfo.opName = "EOR";
-			opEOR(IndirectY(READ));
-			break;
-		case 0xE6:
-			if(NES::logging) opInfo.opName = "INC";
-			opINC(ZeroPage());
-			break;
-		case 0xF6:
-			if(NES::logging) opInfo.opName = "INC";
-			opINC(ZeroPageX());
-			break;
-		case 0xEE:
-			if(NES::logging) opInfo.opName = "INC";
-			opINC(Absolute());
-			break;
-		case 0xFE:
-			if(NES::logging) opInfo.opName = "INC";
-			opINC(AbsoluteX(READWRITE));
-			break;
-		case 0xE8:
-			if(NES::logging) opInfo.opName = "INX";
-			opINX();
-			break;
-		case 0xC8:
-			if(NES::logging) opInfo.opName = "INY";
-			opINY();
-			break;
-		case 0xE3:
-			if(NES::logging) opInfo.opName = "ISC";
-			opISC(IndirectX());
-			break;
-		case 0xE7:
-			if(NES::logging) opInfo.opName = "ISC";
-			opISC(ZeroPage());
-			break;
-		case 0xEF:
-			if(NES::logging) opInfo.opName = "ISC";
-			opISC(Absolute());
-			break;
-		case 0xF3:
-			if(NES::logging) opInfo.opName = "ISC";
-			opISC(IndirectY(READWRITE));
-			break;
-		case 0xF7:
-			if(NES::logging) opInfo.opName = "ISC";
-			opISC(ZeroPageX());
-			break;
-		case 0xFB:
-			if(NES::logging) opInfo.opName = "ISC";
-			opISC(AbsoluteY(READWRITE));
-			break;
-		case 0xFF:
-			if(NES::logging) opInfo.opName = "ISC";
-			opISC(AbsoluteX(READWRITE));
-			break;	
-		case 0x4C:
-			if(NES::logging) opInfo.opName = "JMP";
-			opJMP(Absolute());
-			break;
-		case 0x6C:
-			if(NES::logging) opInfo.opName = "JMP";
-			opJMP(Indirect());
-			break;
-		case 0x20:
-			if(NES::logging) opInfo.opName = "JSR";
-			opJSR(Absolute());
-			break;
-		case 0x02: case 0x12: case 0x22: case 0x32: case 0x42: case 0x52:
-		case 0x62: case 0x72: case 0x92: case 0xB2: case 0xD2: case 0xF2:
-			if(NES::logging) opInfo.opName = "KIL";
-			NES::running = false;
-			break;
-		case 0xBB:
-			if(NES::logging) opInfo.opName = "LAS";
-			opLAS(AbsoluteY(READ));
-			break;
-		case 0xA3:
-			if(NES::logging) opInfo.opName = "LAX";
-			opLAX(IndirectX());
-			break;
-		case 0xA7:
-			if(NES::logging) opInfo.opName = "LAX";
-			opLAX(ZeroPage());
-			break;
-		case 0xAB:
-			if(NES::logging) opInfo.opName = "LAX";
-			opLAX(Immediate());
-			break;
-		case 0xAF:
-			if(NES::logging) opInfo.opName = "LAX";
-			opLAX(Absolute());
-			break;
-		case 0xB3:
-			if(NES::logging) opInfo.opName = "LAX";
-			opLAX(IndirectY(READ));
-			break;
-		case 0xB7:
-			if(NES::logging) opInfo.opName = "LAX";
-			opLAX(ZeroPageY());
-			break;
-		case 0xBF:
-			if(NES::logging) opInfo.opName = "LAX";
-			opLAX(AbsoluteY(READ));
-			break;
-		case 0xA9:
-			if(NES::logging) opInfo.opName = "LDA";
-			opLDA(Immediate());
-			break;
-		case 0xA5:
-			if(NES::logging) opInfo.opName = "LDA";
-			opLDA(ZeroPage());
-			break;
-		case 0xB5:
-			if(NES::logging) opInfo.opName = "LDA";
-			opLDA(ZeroPageX());
-			break;
-		case 0xAD:
-			if(NES::logging) opInfo.opName = "LDA";
-			opLDA(Absolute());
-			break;
-		case 0xBD:
-			if(NES::logging) opInfo.opName = "LDA";
-			opLDA(AbsoluteX(READ));
-			break;
-		case 0xB9:
-			if(NES::logging) opInfo.opName = "LDA";
-			opLDA(AbsoluteY(READ));
-			break;
-		case 0xA1:
-			if(NES::logging) opInfo.opName = "LDA";
-			opLDA(IndirectX());
-			break;
-		case 0xB1:
-			if(NES::logging) opInfo.opName = "LDA";
-			opLDA(IndirectY(READ));
-			break;
-		case 0xA2:
-			if(NES::logging) opInfo.opName = "LDX";
-			opLDX(Immediate());
-			break;
-		case 0xA6:
-			if(NES::logging) opInfo.opName = "LDX";
-			opLDX(ZeroPage());
-			break;
-		case 0xB6:
-			if(NES::logging) opInfo.opName = "LDX";
-			opLDX(ZeroPageY());
-			break;
-		case 0xAE:
-			if(NES::logging) opInfo.opName = "LDX";
-			opLDX(Absolute());
-			break;
-		case 0xBE:
-			if(NES::logging) opInfo.opName = "LDX";
-			opLDX(AbsoluteY(READ));
-			break;
-		case 0xA0:
-			if(NES::logging) opInfo.opName = "LDY";
-			opLDY(Immediate());
-			break;
-		case 0xA4:
-			if(NES::logging) opInfo.opName = "LDY";
-			opLDY(ZeroPage());
-			break;
-		case 0xB4:
-			if(NES::logging) opInfo.opName = "LDY";
-			opLDY(ZeroPageX());
-			break;
-		case 0xAC:
-			if(NES::logging) opInfo.opName = "LDY";
-			opLDY(Absolute());
-			break;
-		case 0xBC:
-			if(NES::logging) opInfo.opName = "LDY";
-			opLDY(AbsoluteX(READ));
-			break;
-		case 0x4A:
-			if(NES::logging) opInfo.opName = "LSR";
-			opLSR();
-			break;
-		case 0x46:
-			if(NES::logging) opInfo.opName = "LSR";
-			opLSR(ZeroPage());
-			break;
-		case 0x56:
-			if(NES::logging) opInfo.opName = "LSR";
-			opLSR(ZeroPageX());
-			break;
-		case 0x4E:
-			if(NES::logging) opInfo.opName = "LSR";
-			opLSR(Absolute());
-			break;
-		case 0x5E:
-			if(NES::logging) opInfo.opName = "LSR";
-			opLSR(AbsoluteX(READWRITE));
-			break;
-		case 0x1A: case 0x3A: case 0x5A: case 0x7A: case 0xDA: case 0xEA: case 0xFA:
-			if(NES::logging) opInfo.opName = "NOP";
-			opNOP(reg.PC);
-			break;
-		case 0x80: case 0x82: case 0xC2: case 0xE2: case 0x89:
-			if(NES::logging) opInfo.opName = "NOP";
-			opNOP(Immediate());
-			break;
-		case 0x04: case 0x44: case 0x64:
-			if(NES::logging) opInfo.opName = "NOP";
-			opNOP(ZeroPage());
-			break;
-		case 0x0C:
-			if(NES::logging) opInfo.opName = "NOP";
-			opNOP(Absolute());
-			break;
-		case 0x1C: case 0x3C: case 0x5C: case 0x7C: case 0xDC: case 0xFC:
-			if(NES::logging) opInfo.opName = "NOP";
-			opNOP(AbsoluteX(READ));
-			break;
-		case 0x14: case 0x34: case 0x54: case 0x74: case 0xD4: case 0xF4:
-			if(NES::logging) opInfo.opName = "NOP";
-			opNOP(ZeroPageX());
-			break;
-		case 0x09:
-			if(NES::logging) opInfo.opName = "ORA";
-			opORA(Immediate());
-			break;
-		case 0x05:
-			if(NES::logging) opInfo.opName = "ORA";
-			opORA(ZeroPage());
-			break;
-		case 0x15:
-			if(NES::logging) opInfo.opName = "ORA";
-			opORA(ZeroPageX());
-			break;
-		case 0x0D:
-			if(NES::logging) opInfo.opName = "ORA";
-			opORA(Absolute());
-			break;
-		case 0x1D:
-			if(NES::logging) opInfo.opName = "ORA";
-			opORA(AbsoluteX(READ));
-			break;
-		case 0x19:
-			if(NES::logging) opInfo.opName = "ORA";
-			opORA(AbsoluteY(READ));
-			break;
-		case 0x01:
-			if(NES::logging) opInfo.opName = "ORA";
-			opORA(IndirectX());
-			break;
-		case 0x11:
-			if(NES::logging) opInfo.opName = "ORA";
-			opORA(IndirectY(READ));
-			break;
-		case 0x48:
-			if(NES::logging) opInfo.opName = "PHA";
-			opPHA();
-			break;
-		case 0x08:
-			if(NES::logging) opInfo.opName = "PHP";
-			opPHP();
-			break;
-		case 0x68:
-			if(NES::logging) opInfo.opName = "PLA";
-			opPLA();
-			break;
-		case 0x28:
-			if(NES::logging) opInfo.opName = "PLP";
-			opPLP();
-			break;
-		case 0x23:
-			if(NES::logging) opInfo.opName = "RLA";
-			opRLA(IndirectX());
-			break;
-		case 0x27:
-			if(NES::logging) opInfo.opName = "RLA";
-			opRLA(ZeroPage());
-			break;
-		case 0x2F:
-			if(NES::logging) opInfo.opName = "RLA";
-			opRLA(Absolute());
-			break;
-		case 0x33:
-			if(NES::logging) opInfo.opName = "RLA";
-			opRLA(IndirectY(READWRITE));
-			break;
-		case 0x37:
-			if(NES::logging) opInfo.opName = "RLA";
-			opRLA(ZeroPageX());
-			break;
-		case 0x3B:
-			if(NES::logging) opInfo.opName = "RLA";
-			opRLA(AbsoluteY(READWRITE));
-			break;
-		case 0x3F:
-			if(NES::logging) opInfo.opName = "RLA";
-			opRLA(AbsoluteX(READWRITE));
-			break;
-		case 0x2A:
-			if(NES::logging) opInfo.opName = "ROL";
-			opROL();
-			break;
-		case 0x26:
-			if(NES::logging) opInfo.opName = "ROL";
-			opROL(ZeroPage());
-			break;
-		case 0x36:
-			if(NES::logging) opInfo.opName = "ROL";
-			opROL(ZeroPageX());
-			break;
-		case 0x2E:
-			if(NES::logging) opInfo.opName = "ROL";
-			opROL(Absolute());
-			break;
-		case 0x3E:
-			if(NES::logging) opInfo.opName = "ROL";
-			opROL(AbsoluteX(READWRITE));
-			break;
-		case 0x6A:
-			if(NES::logging) opInfo.opName = "ROR";
-			opROR();
-			break;
-		case 0x66:
-			if(NES::logging) opInfo.opName = "ROR";
-			opROR(ZeroPage());
-			break;
-		case 0x76:
-			if(NES::logging) opInfo.opName = "ROR";
-			opROR(ZeroPageX());
-			break;
-		case 0x6E:
-			if(NES::logging) opInfo.opName = "ROR";
-			opROR(Absolute());
-			break;
-		case 0x7E:
-			if(NES::logging) opInfo.opName = "ROR";
-			opROR(AbsoluteX(READWRITE));
-			break;
-		case 0x63:
-			if(NES::logging) opInfo.opName = "RRA";
-			opRRA(IndirectX());
-			break;
-		case 0x67:
-			if(NES::logging) opInfo.opName = "RRA";
-			opRRA(ZeroPage());
-			break;
-		case 0x6F:
-			if(NES::logging) opInfo.opName = "RRA";
-			opRRA(Absolute());
-			break;
-		case 0x73:
-			if(NES::logging) opInfo.opName = "RRA";
-			opRRA(IndirectY(READWRITE));
-			break;
-		case 0x77:
-			if(NES::logging) opInfo.opName = "RRA";
-			opRRA(ZeroPageX());
-			break;
-		case 0x7B:
-			if(NES::logging) opInfo.opName = "RRA";
-			opRRA(AbsoluteY(READWRITE));
-			break;
-		case 0x7F:
-			if(NES::logging) opInfo.opName = "RRA";
-			opRRA(AbsoluteX(READWRITE));
-			break;	
-		case 0x40:
-			if(NES::logging) opInfo.opName = "RTI";
-			opRTI();
-			break;
-		case 0x60:
-			if(NES::logging) opInfo.opName = "RTS";
-			opRTS();
-			break;
-		case 0x83:
-			if(NES::logging) opInfo.opName = "SAX";
-			opSAX(IndirectX());
-			break;
-		case 0x87:
-			if(NES::logging) opInfo.opName = "SAX";
-			opSAX(ZeroPage());
-			break;
-		case 0x8F:
-			if(NES::logging) opInfo.opName = "SAX";
-			opSAX(Absolute());
-			break;
-		case 0x97:
-			if(NES::logging) opInfo.opName = "SAX";
-			opSAX(ZeroPageY());
-			break;
-		case 0xE9:
-			if(NES::logging) opInfo.opName = "SBC";
-			opSBC(Immediate());
-			break;
-		case 0xE5:
-			if(NES::logging) opInfo.opName = "SBC";
-			opSBC(ZeroPage());
-			break;
-		case 0xEB:
-			if(NES::logging) opInfo.opName = "SBC";
-			opSBC(Immediate());
-			break;
-		case 0xF5:
-			if(NES::logging) opInfo.opName = "SBC";
-			opSBC(ZeroPageX());
-			break;
-		case 0xED:
-			if(NES::logging) opInfo.opName = "SBC";
-			opSBC(Absolute());
-			break;
-		case 0xFD:
-			if(NES::logging) opInfo.opName = "SBC";
-			opSBC(AbsoluteX(READ));
-			break;
-		case 0xF9:
-			if(NES::logging) opInfo.opName = "SBC";
-			opSBC(AbsoluteY(READ));
-			break;
-		case 0xE1:
-			if(NES::logging) opInfo.opName = "SBC";
-			opSBC(IndirectX());
-			break;
-		case 0xF1:
-			if(NES::logging) opInfo.opName = "SBC";
-			opSBC(IndirectY(READ));
-			break;
-		case 0x38:
-			if(NES::logging) opInfo.opName = "SEC";
-			opSEC();
-			break;
-		case 0xF8:
-			if(NES::logging) opInfo.opName = "SED";
-			opSED();
-			break;
-		case 0x78:
-			if(NES::logging) opInfo.opName = "SEI";
-			opSEI();
-			break;
-		case 0x9E:
-			if(NES::logging) opInfo.opName = "SHX";
-			opSHX(AbsoluteY(WRITE));
-			break;
-		case 0x9C:
-			if(NES::logging) opInfo.opName = "SHY";
-			opSHY(AbsoluteX(WRITE));
-			break;
-		case 0x03:
-			if(NES::logging) opInfo.opName = "SLO";
-			opSLO(IndirectX());
-			break;
-		case 0x07:
-			if(NES::logging) opInfo.opName = "SLO";
-			opSLO(ZeroPage());
-			break;
-		case 0x0F:
-			if(NES::logging) opInfo.opName = "SLO";
-			opSLO(Absolute());
-			break;
-		case 0x13:
-			if(NES::logging) opInfo.opName = "SLO";
-			opSLO(IndirectY(READWRITE));
-			break;
-		case 0x17:
-			if(NES::logging) opInfo.opName = "SLO";
-			opSLO(ZeroPageX());
-			break;
-		case 0x1B:
-			if(NES::logging) opInfo.opName = "SLO";
-			opSLO(AbsoluteY(READWRITE));
-			break;
-		case 0x1F:
-			if(NES::logging) opInfo.opName = "SLO";
-			opSLO(AbsoluteX(READWRITE));
-			break;
-		case 0x43:
-			if(NES::logging) opInfo.opName = "SRE";
-			opSRE(IndirectX());
-			break;
-		case 0x47:
-			if(NES::logging) opInfo.opName = "SRE";
-			opSRE(ZeroPage());
-			break;
-		case 0x4F:
-			if(NES::logging) opInfo.opName = "SRE";
-			opSRE(Absolute());
-			break;
-		case 0x53:
-			if(NES::logging) opInfo.opName = "SRE";
-			opSRE(IndirectY(READWRITE));
-			break;
-		case 0x57:
-			if(NES::logging) opInfo.opName = "SRE";
-			opSRE(ZeroPageX());
-			break;
-		case 0x5B:
-			if(NES::logging) opInfo.opName = "SRE";
-			opSRE(AbsoluteY(READWRITE));
-			break;
-		case 0x5F:
-			if(NES::logging) opInfo.opName = "SRE";
-			opSRE(AbsoluteX(READWRITE));
-			break;
-		case 0x85:
-			if(NES::logging) opInfo.opName = "STA";
-			opSTA(ZeroPage());
-			break;
-		case 0x95:
-			if(NES::logging) opInfo.opName = "STA";
-			opSTA(ZeroPageX());
-			break;
-		case 0x8D:
-			if(NES::logging) opInfo.opName = "STA";
-			opSTA(Absolute());
-			break;
-		case 0x9D:
-			if(NES::logging) opInfo.opName = "STA";
-			opSTA(AbsoluteX(WRITE));
-			break;
-		case 0x99:
-			if(NES::logging) opInfo.opName = "STA";
-			opSTA(AbsoluteY(WRITE));
-			break;
-		case 0x81:
-			if(NES::logging) opInfo.opName = "STA";
-			opSTA(IndirectX());
-			break;
-		case 0x91:
-			if(NES::logging) opInfo.opName = "STA";
-			opSTA(IndirectY(WRITE));
-			break;
-		case 0x86:
-			if(NES::logging) opInfo.opName = "STX";
-			opSTX(ZeroPage());
-			break;
-		case 0x96:
-			if(NES::logging) opInfo.opName = "STX";
-			opSTX(ZeroPageY());
-			break;
-		case 0x8E:
-			if(NES::logging) opInfo.opName = "STX";
-			opSTX(Absolute());
-			break;
-		case 0x84:
-			if(NES::logging) opInfo.opName = "STY";
-			opSTY(ZeroPage());
-			break;
-		case 0x94:
-			if(NES::logging) opInfo.opName = "STY";
-			opSTY(ZeroPageX());
-			break;
-		case 0x8C:
-			if(NES::logging) opInfo.opName = "STY";
-			opSTY(Absolute());
-			break;
-		case 0x9B:
-			if(NES::logging) opInfo.opName = "TAS";
-			opTAS(AbsoluteY(WRITE));
-			break;
-		case 0xAA:
-			if(NES::logging) opInfo.opName = "TAX";
-			opTAX();
-			break;
-		case 0xA8:
-			if(NES::logging) opInfo.opName = "TAY";
-			opTAY();
-			break;
-		case 0xBA:
-			if(NES::logging) opInfo.opName = "TSX";
-			opTSX();
-			break;
-		case 0x8A:
-			if(NES::logging) opInfo.opName = "TXA";
-			opTXA();
-			break;
-		case 0x9A:
-			if(NES::logging) opInfo.opName = "TXS";
-			opTXS();
-			break;
-		case 0x98:
-			if(NES::logging) opInfo.opName = "TYA";
-			opTYA();
-			break;
-		case 0x8B:
-			if(NES::logging) opInfo.opName = "XAA";
-			opXAA(Immediate());
-			break;
+	else if(reg.PC <= opcodeAddr)
+		checkIdleLoop(reg.PC, opcodeAddr);
+
+	if constexpr(PROFILER::enabled) {
+		//Cycles skipped through an idle loop are charged to the jump closing it
+		PROFILER::instruction(opcodeAddr, opcode, cpuCycle - startCycle);
+		switch(instruction.mnemonic) {
+			case JSR: case BRK: PROFILER::call(reg.PC, startSP); break;
+			case RTS: case RTI: PROFILER::ret(reg.SP); break;
+			default: break;
+		}
 	}
 
-	if(NES::logging)
-		logStep();
+}
+
+void CPU::step() {
+	(this->*stepVariant)();
+}
 
+void CPU::setTracing(bool enable) {
+	//Trace records include the PPU position, so the PPU can't run behind
+	syncComponents();
+	tracing = enable;
+	scheduleNextEvent();
+	stepVariant = enable ? &CPU::stepInstruction<true> : &CPU::stepInstruction<false>;
+	opInfo.NMIduringBRK = opInfo.spriteDMA = false;
 }
 
-void interruptDetect()
+void CPU::interruptDetect()
 {
 	IRQflag = IRQdetected;
 	NMIflag |= NMIdetected;
@@ -1162,34 +752,36 @@ void interruptDetect()
 	NMIdetected = NMIsignal;
 }
 
-void forceNMI(bool setLow) {
+void CPU::forceNMI(bool setLow) {
 	NMIdetected = setLow;
 	NMIflag = setLow;
 	NMIsignal = setLow;
 }
 
-void setNMI(bool setLow) {
+void CPU::setNMI(bool setLow) {
 	NMIsignal = setLow;
 }
 
-void setIRQfromAPU(bool setLow)
+void CPU::setIRQfromAPU(bool setLow)
 {
 	IRQfromAPU = setLow;
 	setIRQ(IRQfromAPU | IRQfromCart);
 }
 
-void setIRQfromCart(bool setLow)
+void CPU::setIRQfromCart(bool setLow)
 {
 	IRQfromCart = setLow;
 	setIRQ(IRQfromAPU | IRQfromCart);
 }
 
-void setIRQ(bool setLow) {
+void CPU::setIRQ(bool setLow) {
 	IRQsignal = setLow;
 }
 
-void OAMDMA_write() {
-	if(NES::logging) logInterrupt("[Sprite DMA Start - Cycle: " + std::to_string(cpuCycle) + "]");
+void CPU::OAMDMA_write() {
+	//Recorded unconditionally. Cheaper than branching on the trace mode for a rare event
+	opInfo.spriteDMA = true;
+	opInfo.DMAstartCycle = cpuCycle;
 	if(cpuCycle % 2 == 1) {
 		//Odd cpuCycle
 		cpuRead(reg.PC);
@@ -1199,191 +791,130 @@ void OAMDMA_write() {
 	for(int i = 0; i<256; ++i) {
 		cpuWrite(0x2004, cpuRead((((uint16_t)OAMDMA)<<8)|((uint8_t)i)));
 	}
-	if(NES::logging) logInterrupt("[Sprite DMA End - Cycle: " + std::to_string(cpuCycle) + "]");
+	opInfo.DMAendCycle = cpuCycle;
 }
 
-void setPC(uint16_t newPC) {
+void CPU::setPC(uint16_t newPC) {
 	reg.PC = newPC;
 }
 
-void logStep()
+void CPU::logStep()
 {
-	NES::logFile << std::hex << std::uppercase << std::setfill('0')
-				 << std::setw(4) << static_cast<int>(opInfo.lastRegs.PC) << "  "
-				 << std::setw(2) << static_cast<int>(opInfo.opCode) << " ";
-
-	switch (opInfo.addrMode) {
-		case AddressingMode::ABSOLUTE:
-			NES::logFile << std::setw(2) << static_cast<int>(opInfo.addrL) << " "
-				<< std::setw(2) << static_cast<int>(opInfo.addrH) << "  " << opInfo.opName
-				<< " $" << std::setw(4) << static_cast<int>(opInfo.actAddr)
-				<< "\t\t\t\t\t";
-			break;
-		case AddressingMode::ABSOLUTEX:
-			NES::logFile << std::setw(2) << static_cast<int>(opInfo.addrL) << " "
-				<< std::setw(2) << static_cast<int>(opInfo.addrH) << "  " << opInfo.opName
-				<< " $" << std::setw(2) << static_cast<int>(opInfo.addrH)
-				<< std::setw(2) << static_cast<int>(opInfo.addrL) << ",X @ $"
-				<< std::setw(4) << static_cast<int>(opInfo.actAddr)
-				<< "\t\t\t";
-			break;
-		case AddressingMode::ABSOLUTEY:
-			NES::logFile << std::setw(2) << static_cast<int>(opInfo.addrL) << " "
-				<< std::setw(2) << static_cast<int>(opInfo.addrH) << "  " << opInfo.opName
-				<< " $" << std::setw(2) << static_cast<int>(opInfo.addrH)
-				<< std::setw(2) << static_cast<int>(opInfo.addrL) << ",Y @ $"
-				<< std::setw(4) << static_cast<int>(opInfo.actAddr)
-				<< "\t\t\t";
-			break;
-		case AddressingMode::ZEROPAGE:
-			NES::logFile << std::setw(2) << static_cast<int>(opInfo.addrL) << "     "
-				<< opInfo.opName << " $" << std::setw(2) << static_cast<int>(opInfo.addrL)
-				<< "\t\t\t\t\t\t";
-			break;
-		case AddressingMode::ZEROPAGEX:
-			NES::logFile << std::setw(2) << static_cast<int>(opInfo.addrL) << "     "
-				<< opInfo.opName << " $" << std::setw(2) << static_cast<int>(opInfo.addrL)
-				<< ",X @ $" << std::setw(4) << static_cast<int>(opInfo.actAddr)
-				<< "\t\t\t";
-			break;
-		case AddressingMode::ZEROPAGEY:
-			NES::logFile << std::setw(2) << static_cast<int>(opInfo.addrL) << "     "
-				<< opInfo.opName << " $" << std::setw(2) << static_cast<int>(opInfo.addrL)
-				<< ",Y @ $" << std::setw(4) << static_cast<int>(opInfo.actAddr)
-				<< "\t\t\t";
-			break;
-		case AddressingMode::IMMEDIATE:
-			NES::logFile << std::setw(2) << static_cast<int>(opInfo.addrL) << "     "
-				<< opInfo.opName << " #$" << std::setw(2) << static_cast<int>(opInfo.addrL)
-				<< "\t\t\t\t\t";
-			break;
-		case AddressingMode::RELATIVE:
-			NES::logFile << std::setw(2) << static_cast<int>(opInfo.addrL) << "     "
-				<< opInfo.opName << " $" << std::setw(2) << static_cast<int>(opInfo.addrL)
-				<< "\t\t\t\t\t\t";
-			break;
-		case AddressingMode::IMPLICIT:
-			NES::logFile << "       " << opInfo.opName << "\t\t\t\t\t\t\t";
-			break;
-		case AddressingMode::INDIRECT:
-			NES::logFile << std::setw(2) << static_cast<int>(opInfo.addrL) << " "
-				<< std::setw(2) << static_cast<int>(opInfo.addrH) << "  " << opInfo.opName
-				<< " $" << std::setw(2) << static_cast<int>(opInfo.addrH)
-				<< std::setw(2) << static_cast<int>(opInfo.addrL) << " @ $"
-				<< std::setw(4) << static_cast<int>(opInfo.actAddr)
-				<< "\t\t\t";
-			break;
-		case AddressingMode::IDX_INDIRECT:
-			NES::logFile << std::setw(2) << static_cast<int>(opInfo.addrL) << "     "
-				<< opInfo.opName << " ($" << std::setw(2) << static_cast<int>(opInfo.addrL)
-				<< ",X) @ $"	<< std::setw(4) << static_cast<int>(opInfo.actAddr)
-				<< "\t\t\t";
-			break;
-		case AddressingMode::INDIRECT_IDX:
-			NES::logFile << std::setw(2) << static_cast<int>(opInfo.addrL) << "     "
-				<< opInfo.opName << " ($" << std::setw(2) << static_cast<int>(opInfo.addrL)
-				<< "),Y @ $"	<< std::setw(4) << static_cast<int>(opInfo.actAddr)
-				<< "\t\t\t";
-			break;
+	TRACE::write(opInfo.record);
+
+	TRACE::Record event = {};
+	if(opInfo.spriteDMA) {
+		event.type = TRACE::SPRITE_DMA_START;
+		event.cpuCycle = opInfo.DMAstartCycle;
+		TRACE::write(event);
+		event.type = TRACE::SPRITE_DMA_END;
+		event.cpuCycle = opInfo.DMAendCycle;
+		TRACE::write(event);
+	}
+	event.cpuCycle = cpuCycle;
+	if(opInfo.NMIduringBRK) {
+		event.type = TRACE::NMI_DURING_BRK;
+		TRACE::write(event);
 	}
+	if(NMIflag) {
+		event.type = TRACE::NMI_TRIGGERED;
+		TRACE::write(event);
+	}
+	else if(IRQflag) {
+		event.type = TRACE::IRQ_TRIGGERED;
+		TRACE::write(event);
+	}
+	opInfo.NMIduringBRK = opInfo.spriteDMA = false;
+}
 
-	NES::logFile << std::hex << std::uppercase << std::setfill('0')
-		<< "A:" << std::setw(2) << static_cast<int>(opInfo.lastRegs.A)
-		<< " X:" << std::setw(2) << static_cast<int>(opInfo.lastRegs.X)
-		<< " Y:" << std::setw(2) << static_cast<int>(opInfo.lastRegs.Y)
-		<< " P:" << std::setw(2) << static_cast<int>(opInfo.lastRegs.P.value)
-		<< " SP:" << std::setw(2) << static_cast<int>(opInfo.lastRegs.SP)
-		<< " CYC:" << std::dec << std::setfill(' ') << std::setw(3) << opInfo.PPU_dot
-		<< " SL:" << std::setw(3) << opInfo.PPU_SL
-		<< " CPUCyc:" << (long long)opInfo.CPUcycle << std::endl;
-	
-	if(opInfo.interrupts != "")	NES::logFile << opInfo.interrupts << std::endl;
-	if(NMIflag) NES::logFile << "[NMI Triggered]" << std::endl;
-	else if(IRQflag) NES::logFile << "[IRQ Triggered]" << std::endl;
-	opInfo.interrupts = "";
+const char* CPU::getMnemonic(uint8_t opcode)
+{
+	return mnemonicNames[opTable<true>[opcode].mnemonic];
 }
 
-void logInterrupt(std::string txt)
+CPU::AddressingMode CPU::getAddressingMode(uint8_t opcode)
 {
-	if(opInfo.interrupts != "") opInfo.interrupts += "\n";
-	opInfo.interrupts += txt;
+	return opTable<true>[opcode].addrMode;
 }
 
 
 //Addressing functions
 //Returns final address
 
-uint16_t Immediate() {
+template<bool traced>
+uint8_t CPU::fetchOperand() {
+	//Reads the next instruction byte. Decoded instructions already have it, but the bus cycle still happens
+	if constexpr(!traced) {
+		if(operands) {
+			uint8_t value = busVal = *operands++;
+			incCycle();
+			++reg.PC;
+			return value;
+		}
+	}
+	uint8_t value = cpuRead(reg.PC);
+	++reg.PC;
+	return value;
+}
+
+uint16_t CPU::Implied() {
+	//For the implied NOPs, which still perform a dummy read of the next byte
+	return reg.PC;
+}
+
+template<bool traced>
+uint16_t CPU::Immediate() {
 	uint16_t addr = reg.PC;
 	++reg.PC;
-	if(NES::logging) {
-		opInfo.addrMode = AddressingMode::IMMEDIATE;
-	}
+	if constexpr(traced) opInfo.record.operand[0] = memGet(addr, true);
 	return addr;
 }
 
-uint16_t ZeroPage() {
-	uint8_t addr = cpuRead(reg.PC);
-	++reg.PC;
-	if(NES::logging) {
-		opInfo.addrMode = AddressingMode::ZEROPAGE;
-		opInfo.actAddr = opInfo.addrL = addr;
-	}
+template<bool traced>
+uint16_t CPU::ZeroPage() {
+	uint8_t addr = fetchOperand<traced>();
+	if constexpr(traced) opInfo.record.effectiveAddr = opInfo.record.operand[0] = addr;
 	return addr;
 }
 
-uint16_t ZeroPageX() {
-	uint8_t addr = cpuRead(reg.PC);
-	if(NES::logging) {
-		opInfo.addrMode = AddressingMode::ZEROPAGEX;
-		opInfo.addrL = addr;
-	}
-	++reg.PC;
+template<bool traced>
+uint16_t CPU::ZeroPageX() {
+	uint8_t addr = fetchOperand<traced>();
+	if constexpr(traced) opInfo.record.operand[0] = addr;
 	cpuRead(addr); //Dummy read
 	addr += reg.X;
-	if(NES::logging) opInfo.actAddr = addr;
+	if constexpr(traced) opInfo.record.effectiveAddr = addr;
 	return addr;
 }
 
-uint16_t ZeroPageY() {
-	uint8_t addr = cpuRead(reg.PC);
-	if(NES::logging) {
-		opInfo.addrMode = AddressingMode::ZEROPAGEY;
-		opInfo.addrL = addr;
-	}
-	++reg.PC;
+template<bool traced>
+uint16_t CPU::ZeroPageY() {
+	uint8_t addr = fetchOperand<traced>();
+	if constexpr(traced) opInfo.record.operand[0] = addr;
 	cpuRead(addr); //Dummy read
 	addr += reg.Y;
-	if(NES::logging) opInfo.actAddr = addr;
+	if constexpr(traced) opInfo.record.effectiveAddr = addr;
 	return addr;
 }
 
-uint16_t Absolute() {
-	uint16_t addr = cpuRead(reg.PC);
-	if(NES::logging) {
-		opInfo.addrMode = AddressingMode::ABSOLUTE;
-		opInfo.addrL = addr;
-	}
-	++reg.PC;
-	uint16_t addr2 = ((uint16_t)cpuRead(reg.PC) << 8);
-	if(NES::logging) opInfo.addrH = addr2 >> 8;
+template<bool traced>
+uint16_t CPU::Absolute() {
+	uint16_t addr = fetchOperand<traced>();
+	if constexpr(traced) opInfo.record.operand[0] = addr;
+	uint16_t addr2 = ((uint16_t)fetchOperand<traced>() << 8);
+	if constexpr(traced) opInfo.record.operand[1] = addr2 >> 8;
 	addr |= addr2;
-	++reg.PC;
-	if(NES::logging) opInfo.actAddr = addr;
+	if constexpr(traced) opInfo.record.effectiveAddr = addr;
 	return addr;
 }
 
-uint16_t AbsoluteX(OpType optype) {
-	uint16_t addr = cpuRead(reg.PC);
-	if(NES::logging) {
-		opInfo.addrMode = AddressingMode::ABSOLUTEX;
-		opInfo.addrL = addr;
-	}
-	++reg.PC;
-	uint16_t addr2 = ((uint16_t)cpuRead(reg.PC) << 8);
-	if(NES::logging) opInfo.addrH = addr2 >> 8;
+template<bool traced, CPU::OpType optype>
+uint16_t CPU::AbsoluteX() {
+	uint16_t addr = fetchOperand<traced>();
+	if constexpr(traced) opInfo.record.operand[0] = addr;
+	uint16_t addr2 = ((uint16_t)fetchOperand<traced>() << 8);
+	if constexpr(traced) opInfo.record.operand[1] = addr2 >> 8;
 	addr |= addr2;
-	++reg.PC;
 
 	if(optype == READ) {
 		if((addr + reg.X) != ((addr & 0xFF00) | ((addr + reg.X) & 0xFF))) {
@@ -1395,21 +926,17 @@ uint16_t AbsoluteX(OpType optype) {
 	}
 	
 	addr += reg.X;	
-	if(NES::logging) opInfo.actAddr = addr;
+	if constexpr(traced) opInfo.record.effectiveAddr = addr;
 	return addr;
 }
 
-uint16_t AbsoluteY(OpType optype) {
-	uint16_t addr = cpuRead(reg.PC);
-	if(NES::logging) {
-		opInfo.addrMode = AddressingMode::ABSOLUTEY;
-		opInfo.addrL = addr;
-	}
-	++reg.PC;
-	uint16_t addr2 = ((uint16_t)cpuRead(reg.PC) << 8);
-	if(NES::logging) opInfo.addrH = addr2 >> 8;
+template<bool traced, CPU::OpType optype>
+uint16_t CPU::AbsoluteY() {
+	uint16_t addr = fetchOperand<traced>();
+	if constexpr(traced) opInfo.record.operand[0] = addr;
+	uint16_t addr2 = ((uint16_t)fetchOperand<traced>() << 8);
+	if constexpr(traced) opInfo.record.operand[1] = addr2 >> 8;
 	addr |= addr2;
-	++reg.PC;
 
 	if(optype == READ) {
 		if ((addr + reg.Y) != ((addr & 0xFF00) | ((addr + reg.Y) & 0xFF))) {
@@ -1421,50 +948,40 @@ uint16_t AbsoluteY(OpType optype) {
 	}
 	
 	addr += reg.Y;	
-	if(NES::logging) opInfo.actAddr = addr;
+	if constexpr(traced) opInfo.record.effectiveAddr = addr;
 	return addr;
 }
 
-uint16_t Indirect() {
-	uint16_t addr_loc = cpuRead(reg.PC);
-	if(NES::logging) {
-		opInfo.addrMode = AddressingMode::INDIRECT;
-		opInfo.addrL = addr_loc;
-	}
-	++reg.PC;
-	uint16_t addr_loc2 = ((uint16_t)cpuRead(reg.PC) << 8);
-	if(NES::logging) opInfo.addrH = addr_loc2;
+template<bool traced>
+uint16_t CPU::Indirect() {
+	uint16_t addr_loc = fetchOperand<traced>();
+	if constexpr(traced) opInfo.record.operand[0] = addr_loc;
+	uint16_t addr_loc2 = ((uint16_t)fetchOperand<traced>() << 8);
+	if constexpr(traced) opInfo.record.operand[1] = addr_loc2 >> 8;
 	addr_loc |= addr_loc2;
-	++reg.PC;
 	uint16_t addr = cpuRead(addr_loc);
 	//Implemented 6502 bug. If address if xxFF, next address is xx00 (eg 02FF and 0200)
 	addr |= ((uint16_t)cpuRead((addr_loc&0xFF00)|((uint8_t)(addr_loc+1))) << 8);
-	if(NES::logging) opInfo.actAddr = addr;
+	if constexpr(traced) opInfo.record.effectiveAddr = addr;
 	return addr;
 }
 
-uint16_t IndirectX() {
-	uint8_t iaddr = cpuRead(reg.PC);
-	if(NES::logging) {
-		opInfo.addrMode = AddressingMode::IDX_INDIRECT;
-		opInfo.addrL = iaddr;
-	}
-	++reg.PC;
+template<bool traced>
+uint16_t CPU::IndirectX() {
+	uint8_t iaddr = fetchOperand<traced>();
+	if constexpr(traced) opInfo.record.operand[0] = iaddr;
 	cpuRead(iaddr); //Dummy read
 	iaddr += reg.X;
 	uint16_t addr = cpuRead(iaddr);
 	addr |= ((uint16_t)cpuRead((uint8_t)(iaddr+1)) << 8);
-	if(NES::logging) opInfo.actAddr = addr;
+	if constexpr(traced) opInfo.record.effectiveAddr = addr;
 	return addr;
 }
 
-uint16_t IndirectY(OpType optype) {
-	uint8_t iaddr = cpuRead(reg.PC);
-	if(NES::logging) {
-		opInfo.addrMode = AddressingMode::INDIRECT_IDX;
-		opInfo.addrL = iaddr;
-	}
-	++reg.PC;
+template<bool traced, CPU::OpType optype>
+uint16_t CPU::IndirectY() {
+	uint8_t iaddr = fetchOperand<traced>();
+	if constexpr(traced) opInfo.record.operand[0] = iaddr;
 	uint16_t addr = cpuRead(iaddr);
 	addr |= ((uint16_t)cpuRead((uint8_t)(iaddr+1)) << 8);
 	if(optype == READ) {
@@ -1477,106 +994,90 @@ uint16_t IndirectY(OpType optype) {
 	}
 	
 	addr += reg.Y;
-	if(NES::logging) opInfo.actAddr = addr;
+	if constexpr(traced) opInfo.record.effectiveAddr = addr;
 	return addr;
 }
 
 
 
 //CPU operation functions
-void opADC(uint16_t addr) {
+void CPU::opADC(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	uint16_t sum = reg.A + M + reg.P.C;
 	reg.P.C = (sum > 0xFF) ? 1 : 0;
 	reg.P.V = (~(reg.A^M) & (reg.A^((uint8_t)sum)) & 0x80) ? 1 : 0;
 	reg.A = (uint8_t)sum;
-	reg.P.Z = (reg.A == 0) ? 1 : 0;
-	reg.P.N = ((reg.A >> 7) > 0) ? 1 : 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opAHX(uint16_t addr) {
+void CPU::opAHX(uint16_t addr) {
 	uint8_t val = reg.A & reg.X & (addr >> 8);
-	if(NES::logging) opInfo.val = val;
 	cpuWrite(addr, val);
 }
 
-void opALR(uint16_t addr) {
+void CPU::opALR(uint16_t addr) {
 	// AND M followed by LSR A
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	reg.A &= M;
 	reg.P.C = reg.A & 1; //Set to old A per LSR behavior
 	reg.A = reg.A >> 1;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opANC(uint16_t addr) {
+void CPU::opANC(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	reg.A &= M;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
-	reg.P.C = reg.P.N;
+	reg.P.setNZ(reg.A);
+	reg.P.C = reg.A >> 7;
 }
 
-void opAND(uint16_t addr) {
+void CPU::opAND(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	reg.A &= M;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opARR(uint16_t addr) {
+void CPU::opARR(uint16_t addr) {
 	//AND M followed by ROR A
 	//Uses strange logic for flags
 	//See http://www.6502.org/users/andre/petindex/local/64doc.txt
 
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	reg.A &= M;
 
 	reg.A = (reg.A >> 1) | (reg.P.C << 7);
-	reg.P.N = reg.P.C;
-	reg.P.Z = (reg.A == 0);
+	reg.P.setNZ(reg.A);
 	reg.P.C = (reg.A & 0x40) ? 1 : 0;
 	reg.P.V = (reg.P.C ^ ((reg.A >> 5) & 1)) ? 1 : 0;
 }
 
-void opASL() {
+void CPU::opASL() {
 	cpuRead(reg.PC);
 	reg.P.C = ((reg.A >> 7) > 0) ? 1 : 0;
 	reg.A = reg.A << 1;
-	reg.P.Z = (reg.A == 0) ? 1 : 0;
-	reg.P.N = ((reg.A >> 7) > 0) ? 1 : 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opASL(uint16_t addr) {
+void CPU::opASL(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M); //Dummy write
 	reg.P.C = ((M >> 7) > 0) ? 1 : 0;
 	M = M << 1;
-	reg.P.Z = (M == 0) ? 1 : 0;
-	reg.P.N = ((M >> 7) > 0) ? 1 : 0;
+	reg.P.setNZ(M);
 	cpuWrite(addr, M);
 }
 
-void opAXS(uint16_t addr) {
+void CPU::opAXS(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	reg.P.C = ((reg.A & reg.X) >= M) ? 1 : 0;
 	reg.X = (reg.A & reg.X) - M;
-	reg.P.N = ((reg.X >> 7) > 0) ? 1 : 0;
-	reg.P.Z = (reg.X == 0) ? 1 : 0;
+	reg.P.setNZ(reg.X);
 }
 
-void opBCC() {
-	int8_t delta = static_cast<int8_t>(cpuRead(reg.PC));
-	if(NES::logging) opInfo.addrL = delta;
-	++reg.PC;
+template<bool traced>
+void CPU::opBCC() {
+	int8_t delta = static_cast<int8_t>(fetchOperand<traced>());
+	if constexpr(traced) opInfo.record.operand[0] = delta;
 	if(reg.P.C == 0) {
 		uint16_t oldPC = reg.PC;
 		reg.PC += delta;
@@ -1590,10 +1091,10 @@ void opBCC() {
 	}
 }
 
-void opBCS() {
-	int8_t delta = static_cast<int8_t>(cpuRead(reg.PC));
-	if(NES::logging) opInfo.addrL = delta;
-	++reg.PC;
+template<bool traced>
+void CPU::opBCS() {
+	int8_t delta = static_cast<int8_t>(fetchOperand<traced>());
+	if constexpr(traced) opInfo.record.operand[0] = delta;
 	if(reg.P.C) {
 		uint16_t oldPC = reg.PC;
 		reg.PC += delta;
@@ -1607,11 +1108,11 @@ void opBCS() {
 	}
 }
 
-void opBEQ() {
-	int8_t delta = static_cast<int8_t>(cpuRead(reg.PC));
-	if(NES::logging) opInfo.addrL = delta;
-	++reg.PC;
-	if(reg.P.Z) {
+template<bool traced>
+void CPU::opBEQ() {
+	int8_t delta = static_cast<int8_t>(fetchOperand<traced>());
+	if constexpr(traced) opInfo.record.operand[0] = delta;
+	if(reg.P.Z()) {
 		uint16_t oldPC = reg.PC;
 		reg.PC += delta;
 		if((oldPC & 0xFF00) != (reg.PC & 0xFF00)) {
@@ -1624,19 +1125,18 @@ void opBEQ() {
 	}
 }
 
-void opBIT(uint16_t addr) {
+void CPU::opBIT(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
-	reg.P.Z = (reg.A & M) == 0;
-	reg.P.N = (M & 1<<7) != 0;
+	reg.P.Zresult = reg.A & M;
+	reg.P.Nresult = M;
 	reg.P.V = (M & 1<<6) != 0;
 }
 
-void opBMI() {
-	int8_t delta = static_cast<int8_t>(cpuRead(reg.PC));
-	if(NES::logging) opInfo.addrL = delta;
-	++reg.PC;
-	if(reg.P.N) {
+template<bool traced>
+void CPU::opBMI() {
+	int8_t delta = static_cast<int8_t>(fetchOperand<traced>());
+	if constexpr(traced) opInfo.record.operand[0] = delta;
+	if(reg.P.N()) {
 		uint16_t oldPC = reg.PC;
 		reg.PC += delta;
 		if((oldPC & 0xFF00) != (reg.PC & 0xFF00)) {
@@ -1649,11 +1149,11 @@ void opBMI() {
 	}
 }
 
-void opBNE() {
-	int8_t delta = static_cast<int8_t>(cpuRead(reg.PC));
-	if(NES::logging) opInfo.addrL = delta;
-	++reg.PC;
-	if(reg.P.Z == 0) {
+template<bool traced>
+void CPU::opBNE() {
+	int8_t delta = static_cast<int8_t>(fetchOperand<traced>());
+	if constexpr(traced) opInfo.record.operand[0] = delta;
+	if(reg.P.Z() == 0) {
 		uint16_t oldPC = reg.PC;
 		reg.PC += delta;
 		if((oldPC & 0xFF00) != (reg.PC & 0xFF00)) {
@@ -1666,11 +1166,11 @@ void opBNE() {
 	}
 }
 
-void opBPL() {
-	int8_t delta = static_cast<int8_t>(cpuRead(reg.PC));
-	if(NES::logging) opInfo.addrL = delta;
-	++reg.PC;
-	if(reg.P.N == 0) {
+template<bool traced>
+void CPU::opBPL() {
+	int8_t delta = static_cast<int8_t>(fetchOperand<traced>());
+	if constexpr(traced) opInfo.record.operand[0] = delta;
+	if(reg.P.N() == 0) {
 		uint16_t oldPC = reg.PC;
 		reg.PC += delta;
 		if((oldPC & 0xFF00) != (reg.PC & 0xFF00)) {
@@ -1683,7 +1183,8 @@ void opBPL() {
 	}
 }
 
-void opBRK() {
+template<bool traced>
+void CPU::opBRK() {
 	cpuRead(reg.PC); //Dummy read
 	++reg.PC;
 	cpuWrite(((uint16_t)0x01 << 8) | reg.SP, reg.PC >> 8);
@@ -1691,26 +1192,19 @@ void opBRK() {
 	cpuWrite(((uint16_t)0x01 << 8) | reg.SP, reg.PC);
 	--reg.SP;
 
-	//Copy P since the B flag is only passed onto stack
-	int8_t oldP = reg.P.value;
-
 	uint16_t newaddr;
 
-	reg.P.B = 3;
 	//Will catch interrupts here
 	//if(NMI_triggered || NMI_detected) {
 	if(NMIflag | NMIdetected) {
 		newaddr = 0xFFFA;
-		if(NES::logging) {
-			logInterrupt("[NMI Interrupt during BRK]");
-		}
+		if constexpr(traced) opInfo.NMIduringBRK = true;
 	}
 	else {
 		newaddr = 0xFFFE;
 		++reg.PC;
 	}
-	cpuWrite(((uint16_t)0x01 << 8) | reg.SP, reg.P.value);
-	reg.P.value = oldP;
+	cpuWrite(((uint16_t)0x01 << 8) | reg.SP, reg.P.value() | 0x30); //B flag is only passed onto stack
 	reg.P.I = 1;
 	--reg.SP;
 	uint16_t addr = cpuRead(newaddr);
@@ -1722,7 +1216,7 @@ void opBRK() {
 	NMIflag = false;
 }
 
-void opBRKonIRQ() {
+void CPU::opBRKonIRQ() {
 	//Include opcode fetching
 	cpuRead(reg.PC); //Dummy read
 	cpuRead(reg.PC); //Dummy read
@@ -1732,13 +1226,9 @@ void opBRKonIRQ() {
 	cpuWrite(((uint16_t)0x01 << 8) | reg.SP, reg.PC);
 	--reg.SP;
 
-	//Copy P since the B flag is only passed onto stack
-	int8_t oldP = reg.P.value;
-
 	uint16_t newaddr;
 
-	reg.P.B = 2;
-	
+
 	if(NMIflag | NMIdetected) {
 		newaddr = 0xFFFA;
 		NMIsignal = false;
@@ -1747,8 +1237,7 @@ void opBRKonIRQ() {
 		newaddr = 0xFFFE;
 	}
 
-	cpuWrite(((uint16_t)0x01 << 8) | reg.SP, reg.P.value);
-	reg.P.value = oldP;
+	cpuWrite(((uint16_t)0x01 << 8) | reg.SP, reg.P.value() | 0x20); //B flag is only passed onto stack
 	reg.P.I = 1;
 	--reg.SP;
 	uint16_t addr = cpuRead(newaddr);
@@ -1759,10 +1248,10 @@ void opBRKonIRQ() {
 	NMIflag = false;
 }
 
-void opBVC()  {
-	int8_t delta = static_cast<int8_t>(cpuRead(reg.PC));
-	if(NES::logging) opInfo.addrL = delta;
-	++reg.PC;
+template<bool traced>
+void CPU::opBVC() {
+	int8_t delta = static_cast<int8_t>(fetchOperand<traced>());
+	if constexpr(traced) opInfo.record.operand[0] = delta;
 	if(reg.P.V == 0) {
 		uint16_t oldPC = reg.PC;
 		reg.PC += delta;
@@ -1776,10 +1265,10 @@ void opBVC()  {
 	}
 }
 
-void opBVS() {
-	int8_t delta = static_cast<int8_t>(cpuRead(reg.PC));
-	if(NES::logging) opInfo.addrL = delta;
-	++reg.PC;
+template<bool traced>
+void CPU::opBVS() {
+	int8_t delta = static_cast<int8_t>(fetchOperand<traced>());
+	if constexpr(traced) opInfo.record.operand[0] = delta;
 	if(reg.P.V) {
 		uint16_t oldPC = reg.PC;
 		reg.PC += delta;
@@ -1793,22 +1282,22 @@ void opBVS() {
 	}
 }
 
-void opCLC() {
+void CPU::opCLC() {
 	cpuRead(reg.PC);
 	reg.P.C = 0;
 }
 
-void opCLD() {
+void CPU::opCLD() {
 	cpuRead(reg.PC);
 	reg.P.D = 0;
 }
 
-void opCLI() {
+void CPU::opCLI() {
 	cpuRead(reg.PC);
 	reg.P.I = 0;
 }
 
-void opCLV() {
+void CPU::opCLV() {
 	cpuRead(reg.PC);
 	reg.P.V = 0;
 }
@@ -1816,130 +1305,104 @@ void opCLV() {
 /*void opCMP(uint8_t M) {
 	//pollInterrupts();
 	reg.P.C = (reg.A >= M);
-	reg.P.Z = (reg.A == M);
-	reg.P.N = ((uint8_t)(reg.A-M)>>7) == 1;
+	reg.P.setNZ(reg.A - M);
 	incCycle();
 }*/
 
-void opCMP(uint16_t addr) {
+void CPU::opCMP(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	reg.P.C = (reg.A >= M);
-	reg.P.Z = (reg.A == M);
-	reg.P.N = ((uint8_t)(reg.A-M)>>7) == 1;
+	reg.P.setNZ(reg.A - M);
 }
 
 /*void opCPX(uint8_t M) {
-	if(NES::logging) opInfo.val = M;
 	reg.P.C = (reg.X >= M);
-	reg.P.Z = (reg.X == M);
-	reg.P.N = ((uint8_t)(reg.X-M)>>7) == 1;
+	reg.P.setNZ(reg.X - M);
 	incCycle();
 }*/
 
-void opCPX(uint16_t addr) {
+void CPU::opCPX(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	reg.P.C = (reg.X >= M);
-	reg.P.Z = (reg.X == M);
-	reg.P.N = ((uint8_t)(reg.X-M)>>7) == 1;
+	reg.P.setNZ(reg.X - M);
 }
 
 /*void opCPY(uint8_t M) {
 	//pollInterrupts();
-	if(NES::logging) opInfo.val = M;
 	reg.P.C = (reg.Y >= M);
-	reg.P.Z = (reg.Y == M);
-	reg.P.N = ((uint8_t)(reg.Y-M)>>7) == 1;
+	reg.P.setNZ(reg.Y - M);
 	incCycle();
 }*/
 
-void opCPY(uint16_t addr) {
+void CPU::opCPY(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	reg.P.C = (reg.Y >= M);
-	reg.P.Z = (reg.Y == M);
-	reg.P.N = ((uint8_t)(reg.Y-M)>>7) == 1;
+	reg.P.setNZ(reg.Y - M);
 }
 
-void opDCP(uint16_t addr) {
+void CPU::opDCP(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M);
 	M -= 1;
 	reg.P.C = (reg.A >= M);
-	reg.P.Z = (reg.A == M);
-	reg.P.N = ((uint8_t)(reg.A-M)>>7) == 1;
+	reg.P.setNZ(reg.A - M);
 	cpuWrite(addr, M);
 }
 
-void opDEC(uint16_t addr) {
+void CPU::opDEC(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M);
 	M -= 1;
-	reg.P.Z = (M == 0);
-	reg.P.N = (M >> 7) > 0;
+	reg.P.setNZ(M);
 	cpuWrite(addr, M);
 }
 
-void opDEX() {
+void CPU::opDEX() {
 	cpuRead(reg.PC);
 	reg.X -= 1;
-	reg.P.Z = (reg.X == 0);
-	reg.P.N = (reg.X >> 7) > 0;
+	reg.P.setNZ(reg.X);
 }
 
-void opDEY() {
+void CPU::opDEY() {
 	cpuRead(reg.PC);
 	reg.Y -= 1;
-	reg.P.Z = (reg.Y == 0);
-	reg.P.N = (reg.Y >> 7) > 0;
+	reg.P.setNZ(reg.Y);
 }
 
-void opEOR() {
+void CPU::opEOR() {
 	uint8_t M = cpuRead(reg.PC);
-	if(NES::logging) opInfo.val = M;
 	reg.A ^= M;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opEOR(uint16_t addr) {
+void CPU::opEOR(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	reg.A ^= M;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opINC(uint16_t addr) {
+void CPU::opINC(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M);
 	M += 1;
-	reg.P.Z = (M == 0);
-	reg.P.N = (M >> 7) > 0;
+	reg.P.setNZ(M);
 	cpuWrite(addr, M);
 }
 
-void opINX() {
+void CPU::opINX() {
 	cpuRead(reg.PC);
 	reg.X += 1;
-	reg.P.Z = (reg.X == 0);
-	reg.P.N = (reg.X >> 7) > 0;
+	reg.P.setNZ(reg.X);
 }
 
-void opINY() {
+void CPU::opINY() {
 	cpuRead(reg.PC);
 	reg.Y += 1;
-	reg.P.Z = (reg.Y == 0);
-	reg.P.N = (reg.Y >> 7) > 0;
+	reg.P.setNZ(reg.Y);
 }
 
-void opISC(uint16_t addr) {
+void CPU::opISC(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M); //Dummy write
 	M += 1;
 	cpuWrite(addr, M);
@@ -1948,15 +1411,14 @@ void opISC(uint16_t addr) {
 	reg.P.C = (sum > 0xFF) ? 1 : 0;
 	reg.P.V = (~(reg.A^M) & (reg.A^((uint8_t)sum)) & 0x80) ? 1 : 0;
 	reg.A = (uint8_t)sum;
-	reg.P.Z = (reg.A == 0) ? 1 : 0;
-	reg.P.N = ((reg.A >> 7) > 0) ? 1 : 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opJMP(uint16_t addr) {
+void CPU::opJMP(uint16_t addr) {
 	reg.PC = addr;
 }
 
-void opJSR(uint16_t addr) {
+void CPU::opJSR(uint16_t addr) {
 	cpuRead((0x01 << 8) | reg.PC);
 	cpuWrite(((uint16_t)0x01 << 8) | reg.SP, (reg.PC-1) >> 8);
 	--reg.SP;
@@ -1965,135 +1427,112 @@ void opJSR(uint16_t addr) {
 	reg.PC = addr;
 }
 
-void opLAS(uint16_t addr) {
+void CPU::opKIL() {
+	console.running = false;
+}
+
+void CPU::opLAS(uint16_t addr) {
 	uint8_t val = cpuRead(addr);
-	if(NES::logging) opInfo.val = val;
 	val &= reg.SP;
 	reg.A = val;
 	reg.SP = val;
 	reg.X = val;
-	reg.P.Z = (val == 0);
-	reg.P.N = ((val & 0x80) > 0);
+	reg.P.setNZ(val);
 }
 
-void opLAX(uint16_t addr) {
+void CPU::opLAX(uint16_t addr) {
 	reg.A = reg.X = cpuRead(addr);
-	if(NES::logging) opInfo.val = reg.A;
-	reg.P.Z = (reg.X == 0);
-	reg.P.N = (reg.X >> 7) > 0;
+	reg.P.setNZ(reg.X);
 }
 
-void opLDA() {
+void CPU::opLDA() {
 	reg.A = cpuRead(reg.PC);
-	if(NES::logging) opInfo.val = reg.A;
 	++reg.PC;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opLDA(uint16_t addr) {
+void CPU::opLDA(uint16_t addr) {
 	reg.A = cpuRead(addr);
-	if(NES::logging) opInfo.val = reg.A;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opLDX() {
+void CPU::opLDX() {
 	reg.X = cpuRead(reg.PC);
-	if(NES::logging) opInfo.val = reg.X;
 	++reg.PC;
-	reg.P.Z = (reg.X == 0);
-	reg.P.N = (reg.X >> 7) > 0;
+	reg.P.setNZ(reg.X);
 }
 
-void opLDX(uint16_t addr) {
+void CPU::opLDX(uint16_t addr) {
 	reg.X = cpuRead(addr);
-	if(NES::logging) opInfo.val = reg.X;
-	reg.P.Z = (reg.X == 0);
-	reg.P.N = (reg.X >> 7) > 0;
+	reg.P.setNZ(reg.X);
 }
 
-void opLDY() {
+void CPU::opLDY() {
 	reg.Y = cpuRead(reg.PC);
-	if(NES::logging) opInfo.val = reg.Y;
 	++reg.PC;
-	reg.P.Z = (reg.Y == 0);
-	reg.P.N = (reg.Y >> 7) > 0;
+	reg.P.setNZ(reg.Y);
 }
 
-void opLDY(uint16_t addr) {
+void CPU::opLDY(uint16_t addr) {
 	reg.Y = cpuRead(addr);
-	if(NES::logging) opInfo.val = reg.Y;
-	reg.P.Z = (reg.Y == 0);
-	reg.P.N = (reg.Y >> 7) > 0;
+	reg.P.setNZ(reg.Y);
 }
 
-void opLSR() {
+void CPU::opLSR() {
 	cpuRead(reg.PC);
 	reg.P.C = reg.A & 1;
 	reg.A = reg.A >> 1;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opLSR(uint16_t addr) {
+void CPU::opLSR(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M); //Dummy write
 	reg.P.C = M & 1;
 	M = M >> 1;
 	cpuWrite(addr, M);
-	reg.P.Z = (M == 0);
-	reg.P.N = (M >> 7) > 0;
+	reg.P.setNZ(M);
 }
 
-void opNOP(uint16_t addr) {
+void CPU::opNOP(uint16_t addr) {
 	cpuRead(addr); //Dummy read
 }
 
-void opORA(uint16_t addr) {
+void CPU::opORA(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	reg.A |= M;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opPHA() {
+void CPU::opPHA() {
 	cpuRead(reg.PC);
 	cpuWrite(((uint16_t)0x01 << 8) | reg.SP, reg.A);
 	--reg.SP;
 }
 
-void opPHP() {
+void CPU::opPHP() {
 	cpuRead(reg.PC);
-	int8_t Pold = reg.P.value;
-	reg.P.B = 3;
-	cpuWrite(((uint16_t)0x01 << 8) | reg.SP, reg.P.value);
-	reg.P.value = Pold;
+	cpuWrite(((uint16_t)0x01 << 8) | reg.SP, reg.P.value() | 0x30); //B flag is only passed onto stack
 	--reg.SP;
 }
 
-void opPLA() {
+void CPU::opPLA() {
 	cpuRead(reg.PC);
 	cpuRead((0x01 << 8) | reg.SP);
 	++reg.SP;
 	reg.A = cpuRead(((uint16_t)0x01 << 8) | reg.SP);
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opPLP() {
+void CPU::opPLP() {
 	cpuRead(reg.PC);
 	cpuRead((0x01 << 8) | reg.SP);
 	++reg.SP;
-	reg.P.value = cpuRead(((uint16_t)0x01 << 8) | reg.SP);
-	reg.P.B = 0;
+	reg.P.load(cpuRead(((uint16_t)0x01 << 8) | reg.SP));
 }
 
-void opRLA(uint16_t addr) {
+void CPU::opRLA(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M);
 	uint8_t C0 = reg.P.C;
 	reg.P.C = (M >> 7) > 0;
@@ -2101,57 +1540,49 @@ void opRLA(uint16_t addr) {
 	M |= C0;
 	cpuWrite(addr, M);
 	reg.A &= M;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opROL() {
+void CPU::opROL() {
 	cpuRead(reg.PC);
 	uint8_t C0 = reg.P.C;
 	reg.P.C = ((reg.A >> 7) > 0) ? 1 : 0;
 	reg.A = (reg.A << 1) | C0;
-	reg.P.Z = (reg.A == 0) ? 1 : 0;
-	reg.P.N = ((reg.A >> 7) > 0) ? 1 : 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opROL(uint16_t addr) {
+void CPU::opROL(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M); //Dummy write
 	uint8_t C0 = reg.P.C;
 	reg.P.C = ((M >> 7) > 0) ? 1 : 0;
 	M = (M << 1) | C0;
-	reg.P.Z = (M == 0) ? 1 : 0;
-	reg.P.N = ((M >> 7) > 0) ? 1 : 0;
+	reg.P.setNZ(M);
 	cpuWrite(addr, M);
 }
 
-void opROR() {
+void CPU::opROR() {
 	cpuRead(reg.PC);
 	bool C0 = reg.P.C;
 	reg.P.C = (reg.A & 1);
 	reg.A = reg.A >> 1;
 	reg.A |= C0 ? (1 << 7) : 0;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = C0;
+	reg.P.setNZ(reg.A);
 }
 
-void opROR(uint16_t addr) {
+void CPU::opROR(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M); //Dummy write
 	uint8_t C0 = reg.P.C;
 	reg.P.C = (M & 1);
 	M = M >> 1;
 	M |= C0 ? (1 << 7) : 0;
 	cpuWrite(addr, M);
-	reg.P.Z = (M == 0);
-	reg.P.N = C0;
+	reg.P.setNZ(M);
 }
 
-void opRRA(uint16_t addr) {
+void CPU::opRRA(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M); //Dummy write
 	uint8_t C0 = reg.P.C;
 	reg.P.C = (M & 1);
@@ -2162,16 +1593,14 @@ void opRRA(uint16_t addr) {
 	reg.P.C = (sum > 0xFF) ? 1 : 0;
 	reg.P.V = (~(reg.A^M) & (reg.A^((uint8_t)sum)) & 0x80) ? 1 : 0;
 	reg.A = (uint8_t)sum;
-	reg.P.Z = (reg.A == 0) ? 1 : 0;
-	reg.P.N = ((reg.A >> 7) > 0) ? 1 : 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opRTI() {
+void CPU::opRTI() {
 	cpuRead(reg.PC);
 	cpuRead(((uint16_t)0x01 << 8) | reg.SP);
 	++reg.SP;
-	reg.P.value = cpuRead(((uint16_t)0x01 << 8) | reg.SP);
-	reg.P.B = 0;
+	reg.P.load(cpuRead(((uint16_t)0x01 << 8) | reg.SP));
 	++reg.SP;
 	uint16_t addr = cpuRead(((uint16_t)0x01 << 8) | reg.SP);
 	++reg.SP;
@@ -2179,7 +1608,7 @@ void opRTI() {
 	reg.PC = addr;
 }
 
-void opRTS() {
+void CPU::opRTS() {
 	cpuRead(reg.PC);
 	cpuRead(((uint16_t)0x01 << 8) | reg.SP);
 	++reg.SP;
@@ -2190,140 +1619,126 @@ void opRTS() {
 	reg.PC = addr + 1;
 }
 
-void opSAX(uint16_t addr) {
+void CPU::opSAX(uint16_t addr) {
 	cpuWrite(addr, reg.A&reg.X);
 }
 
-void opSBC(uint16_t addr) {
+void CPU::opSBC(uint16_t addr) {
 	//SBC works the same as ADC, with the value from memory bit flipped
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	M = ~M;
 	uint16_t sum = reg.A + M + reg.P.C;
 	reg.P.C = (sum > 0xFF) ? 1 : 0;
 	reg.P.V = (~(reg.A^M) & (reg.A^((uint8_t)sum)) & 0x80) ? 1 : 0;
 	reg.A = (uint8_t)sum;
-	reg.P.Z = (reg.A == 0) ? 1 : 0;
-	reg.P.N = ((reg.A >> 7) > 0) ? 1 : 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opSEC() {
+void CPU::opSEC() {
 	cpuRead(reg.PC);
 	reg.P.C = 1;
 }
 
-void opSED() {
+void CPU::opSED() {
 	cpuRead(reg.PC);
 	reg.P.D = 1;
 }
 
-void opSEI() {
+void CPU::opSEI() {
 	cpuRead(reg.PC);
 	reg.P.I = 1;
 }
 
-void opSHX(uint16_t addr) {
+void CPU::opSHX(uint16_t addr) {
 	uint8_t H = addr >> 8;
 	uint8_t L = addr & 0xFF;
 	uint8_t val = reg.X & (H + 1);
 	cpuWrite(((uint16_t)val << 8) | L, val);
 }
 
-void opSHY(uint16_t addr) {
+void CPU::opSHY(uint16_t addr) {
 	uint8_t H = addr >> 8;
 	uint8_t L = addr & 0xFF;
 	uint8_t val = reg.Y & (H + 1);
 	cpuWrite(((uint16_t)val << 8) | L, val);
 }
 
-void opSLO(uint16_t addr) {
+void CPU::opSLO(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M);
 	reg.P.C = (M >> 7) > 0;
 	M = M << 1;
 	cpuWrite(addr, M);
 	reg.A |= M;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opSRE(uint16_t addr) {
+void CPU::opSRE(uint16_t addr) {
 	uint8_t M = cpuRead(addr);
-	if(NES::logging) opInfo.val = M;
 	cpuWrite(addr, M);
 	reg.P.C = M & 1;
 	M = M >> 1;
 	cpuWrite(addr, M);
 	reg.A ^= M;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opSTA(uint16_t addr) {
+void CPU::opSTA(uint16_t addr) {
 	cpuWrite(addr, reg.A);
 }
 
-void opSTX(uint16_t addr) {
+void CPU::opSTX(uint16_t addr) {
 	cpuWrite(addr, reg.X);
 }
 
-void opSTY(uint16_t addr) {
+void CPU::opSTY(uint16_t addr) {
 	cpuWrite(addr, reg.Y);
 }
 
-void opTAS(uint16_t addr) {
+void CPU::opTAS(uint16_t addr) {
 	reg.SP = reg.A & reg.X;
 	uint8_t val = reg.A & reg.X & (addr >> 8);
 	cpuWrite(addr, val);
 }
 
-void opTAX() {
+void CPU::opTAX() {
 	cpuRead(reg.PC);
 	reg.X = reg.A;
-	reg.P.Z = (reg.X == 0);
-	reg.P.N = (reg.X >> 7) > 0;
+	reg.P.setNZ(reg.X);
 }
 
-void opTAY() {
+void CPU::opTAY() {
 	cpuRead(reg.PC);
 	reg.Y = reg.A;
-	reg.P.Z = (reg.Y == 0);
-	reg.P.N = (reg.Y >> 7) > 0;
+	reg.P.setNZ(reg.Y);
 }
 
-void opTSX() {
+void CPU::opTSX() {
 	cpuRead(reg.PC);
 	reg.X = reg.SP;
-	reg.P.Z = (reg.X == 0);
-	reg.P.N = (reg.X >> 7) > 0;
+	reg.P.setNZ(reg.X);
 }
 
-void opTXA() {
+void CPU::opTXA() {
 	cpuRead(reg.PC);
 	reg.A = reg.X;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opTXS() {
+void CPU::opTXS() {
 	cpuRead(reg.PC);
 	reg.SP = reg.X;
 }
 
-void opTYA() {
+void CPU::opTYA() {
 	cpuRead(reg.PC);
 	reg.A = reg.Y;
-	reg.P.Z = (reg.A == 0);
-	reg.P.N = (reg.A >> 7) > 0;
+	reg.P.setNZ(reg.A);
 }
 
-void opXAA(uint16_t addr) {
+void CPU::opXAA(uint16_t addr) {
 	uint8_t val = cpuRead(addr);
-	if(NES::logging) opInfo.val = val;
 	reg.A = reg.X & val;
-	reg.P.N = (reg.A & 0x80) > 0;
-	reg.P.Z = (reg.A == 0);
+	reg.P.setNZ(reg.A);
 }
 
-}
\ No newline at end of file
@@ -1,142 +1,342 @@
 #pragma once
 
 #include <stdint.h>
-#include <string>
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include "trace.h"
 
-namespace CPU {
+class Console;
 
-enum OpType {
-	//To change behavior of addressing modes which depend on type
-	//In terms of reading/writing to memory. Not internal registers or flags
-	READ,
-	WRITE,
-	READWRITE,
-};
+class CPU {
+	public:
+	enum OpType {
+		//To change behavior of addressing modes which depend on type
+		//In terms of reading/writing to memory. Not internal registers or flags
+		READ,
+		WRITE,
+		READWRITE,
+	};
+
+	enum AddressingMode {
+		ABSOLUTE,
+		ABSOLUTEX,
+		ABSOLUTEY,
+		ZEROPAGE,
+		ZEROPAGEX,
+		ZEROPAGEY,
+		IMMEDIATE,
+		RELATIVE,
+		IMPLICIT,
+		INDIRECT,
+		IDX_INDIRECT,
+		INDIRECT_IDX,
+	};
+
+	explicit CPU(Console &console) : console(console) {}
+
+	uint8_t busVal;
+
+	unsigned long long cpuCycle;
+
+	void powerOn();
+	void reset();
+	void step();
+	void setTracing(bool enable);
+	void syncComponents();
+
+	uint8_t memGet(uint16_t addr, bool peek = false);
+	void memSet(uint16_t addr, uint8_t val);
+
+	//Page table for gamepak memory. Mappers call these at powerOn and on bank switches
+	//Mapped ranges are accessed directly. Unmapped ranges go through the mapper's memGet/memSet
+	//Sizes are multiples of 0x100. A block smaller than the range is mirrored across it
+	void mapMemory(uint16_t addr, uint32_t size, uint8_t *mem, uint32_t memSize, bool writable);
+	void mapMemory(uint16_t addr, uint32_t size, const uint8_t *mem, uint32_t memSize);	//Read only
+	void unmapMemory(uint16_t addr, uint32_t size);
+
+	void setNMI(bool setLow);
+	void forceNMI(bool setLow);
+	void setIRQfromAPU(bool setLow);
+	void setIRQfromCart(bool setLow);
+	void setPC(uint16_t newPC);
+
+	static const char* getMnemonic(uint8_t opcode);
+	static AddressingMode getAddressingMode(uint8_t opcode);
+
+	private:
+	Console &console;
+
+	//Interupts (NMI and IRQ) go through 3 steps when triggering the CPU
+	//Step 1: A device pulls the NMI or IRQ line low (simulated with setNMI() and setIRQfromX() setting NMIsignal or IRQ signal)
+	//		  IRQfromAPU and IRQfromCart used to ensure proper behavior with multiple devices possibly pulling the line low
+	//Step 2: During phi2 of each CPU cycle, the status of these lines is detected (simulated with interruptDetect())
+	//		  If interrupt detected on lines, the internal NMI or IRQ detected signal is triggered during the following phi1
+	//		  This sets IRQ/NMIdetected in the emulator
+	//Step 3: The NMI/IRQ detected signals are polled at certain points. Documentation is unclear, but is assumed to also be
+	//		  during phi2 of each CPU cycle. This behavior is also simulated with interruptDetect(), which sets the IRQ/NMIflag
+	bool IRQfromAPU, IRQfromCart;
+	bool NMIsignal, IRQsignal;
+	bool IRQdetected, IRQflag, NMIdetected, NMIflag;
+
+	//N and Z are kept as the last result that set them and only worked out when read
+	//(branches, pushes and traces), so most instructions just store their result
+	//The "Break" flags only exist on the stack copy, see PHP/BRK
+	struct StatusReg {
+		uint8_t Nresult;	//Negative if bit 7 set
+		uint8_t Zresult;	//Zero if 0
+		bool C; //Carry
+		bool I; //Interrupt Disable
+		bool D; //Decimal (not used on NES)
+		bool V; //Overflow
+
+		bool N() const { return Nresult & 0x80; }
+		bool Z() const { return Zresult == 0; }
+		void setNZ(uint8_t result) { Nresult = Zresult = result; }
+
+		uint8_t value() const {
+			return N() << 7 | V << 6 | D << 3 | I << 2 | Z() << 1 | C;
+		}
+		void load(uint8_t value) {
+			Nresult = value;
+			Zresult = ~value & 0x02;
+			C = value & 0x01;
+			I = value & 0x04;
+			D = value & 0x08;
+			V = value & 0x40;
+		}
+	};
+
+	struct CPURegisters {
+		uint16_t PC;
+		uint8_t SP;
+		uint8_t A;
+		uint8_t X;
+		uint8_t Y;
+		StatusReg P;
+	} reg;
+
+	struct OpInfo {
+		TRACE::Record record;
+		bool NMIduringBRK;
+		bool spriteDMA;
+		unsigned long long DMAstartCycle;
+		unsigned long long DMAendCycle;
+	} opInfo;
 
-extern uint8_t busVal;
-
-extern unsigned long long cpuCycle;
-
-void powerOn();
-void reset();
-void step();
-void incCycle(bool ignoreIRQ=false);
-uint8_t cpuRead(uint16_t addr, bool ignoreIRQ=false);
-void cpuWrite(uint16_t addr, uint8_t val, bool ignoreIRQ=false);
-
-uint8_t memGet(uint16_t addr, bool peek = false);
-void memSet(uint16_t addr, uint8_t val);
-
-void OAMDMA_write();
-void interruptDetect();
-void setNMI(bool setLow);
-void forceNMI(bool setLow);
-void setIRQfromAPU(bool setLow);
-void setIRQfromCart(bool setLow);
-void setIRQ(bool setLow);
-void setPC(uint16_t newPC);
-
-void logStep();
-void logInterrupt(std::string txt);
-
-//Addressing functions
-uint16_t Immediate();
-uint16_t ZeroPage();
-uint16_t ZeroPageX();
-uint16_t ZeroPageY();
-uint16_t Absolute();
-uint16_t AbsoluteX(OpType optype);
-uint16_t AbsoluteY(OpType optype);
-uint16_t Indirect();
-uint16_t IndirectX();
-uint16_t IndirectY(OpType optype);
-
-//CPU operation functions
-void opADC(uint16_t addr);
-void opAHX(uint16_t addr);
-void opALR(uint16_t addr);
-void opANC(uint16_t addr);
-void opAND(uint16_t addr);
-void opARR(uint16_t addr);
-void opASL();
-void opASL(uint16_t addr);
-void opAXS(uint16_t addr);
-void opBCC();
-void opBCS();
-void opBEQ();
-void opBIT(uint16_t addr);
-void opBMI();
-void opBNE();
-void opBPL();
-void opBRK();
-void opBRKonIRQ();
-void opBVC();
-void opBVS();
-void opCLC();
-void opCLD();
-void opCLI();
-void opCLV();
-void opCMP(uint8_t M);
-void opCMP(uint16_t addr);
-void opCPX(uint8_t M);
-void opCPX(uint16_t addr);
-void opCPY(uint8_t M);
-void opCPY(uint16_t addr);
-void opDCP(uint16_t addr);
-void opDEC(uint16_t addr);
-void opDEX();
-void opDEY();
-void opEOR(void);
-void opEOR(uint16_t addr);
-void opINC(uint16_t addr);
-void opINX();
-void opINY();
-void opISC(uint16_t addr);
-void opJMP(uint16_t addr);
-void opJSR(uint16_t addr);
-void opLAS(uint16_t addr);
-void opLAX(uint16_t addr);
-void opLDA();
-void opLDA(uint16_t addr);
-void opLDX();
-void opLDX(uint16_t addr);
-void opLDY();
-void opLDY(uint16_t addr);
-void opLSR();
-void opLSR(uint16_t addr);
-void opNOP(uint16_t addr);
-void opORA(uint16_t addr);
-void opPHA();
-void opPHP();
-void opPLA();
-void opPLP();
-void opRLA(uint16_t addr);
-void opROL();
-void opROL(uint16_t addr);
-void opROR();
-void opROR(uint16_t addr);
-void opRRA(uint16_t addr);
-void opRTI();
-void opRTS();
-void opSAX(uint16_t addr);
-void opSBC(uint16_t addr);
-void opSEC();
-void opSED();
-void opSEI();
-void opSHX(uint16_t addr);
-void opSHY(uint16_t addr);
-void opSLO(uint16_t addr);
-void opSRE(uint16_t addr);
-void opSTA(uint16_t addr);
-void opSTX(uint16_t addr);
-void opSTY(uint16_t addr);
-void opTAS(uint16_t addr);
-void opTAX();
-void opTAY();
-void opTSX();
-void opTXA();
-void opTXS();
-void opTYA();
-void opXAA(uint16_t addr);
-
-}
\ No newline at end of file
+	enum Mnemonic : uint8_t {
+		ADC, AHX, ALR, ANC, AND, ARR, ASL, AXS, BCC, BCS,
+		BEQ, BIT, BMI, BNE, BPL, BRK, BVC, BVS, CLC, CLD,
+		CLI, CLV, CMP, CPX, CPY, DCP, DEC, DEX, DEY, EOR,
+		INC, INX, INY, ISC, JMP, JSR, KIL, LAS, LAX, LDA,
+		LDX, LDY, LSR, NOP, ORA, PHA, PHP, PLA, PLP, RLA,
+		ROL, ROR, RRA, RTI, RTS, SAX, SBC, SEC, SED, SEI,
+		SHX, SHY, SLO, SRE, STA, STX, STY, TAS, TAX, TAY,
+		TSX, TXA, TXS, TYA, XAA,
+	};
+
+	//Decode table entry. One per opcode
+	struct Instruction {
+		void (*run)(CPU &cpu);		//Operation bound to the addressing function that supplies its operand
+		AddressingMode addrMode;
+		Mnemonic mnemonic;
+		uint8_t cycles;				//Base cycle count. Page crossings, taken branches and DMA add to this
+								//Checked against the bus cycles counted by the traced variant
+	};
+
+	template<bool traced> static const std::array<Instruction, 256> opTable;
+
+	std::array<uint8_t, 2048> RAM;
+	uint8_t OAMDMA;
+
+	//Component scheduling
+	//The PPU, APU and mapper run behind the CPU and are only caught up when the CPU touches their
+	//registers, or on the cycle where one of them next does something the CPU can see:
+	//NMI line changes, frame end, APU frame IRQ and DMC memory reads
+	//Mappers clocked by PPU bus activity and CPU tracing need every cycle, so they run in lockstep
+	unsigned long long syncedCycle;		//Last cycle the components have been run for
+	unsigned long long nextEventCycle;	//Next cycle which has to be run in step with the CPU
+	bool tracing = false;
+
+	//Idle loop fast-forward
+	//A short backwards jump whose loop body only reads plain memory and has no side effects is a candidate
+	//If the registers are the same on two passes through the loop start, every further pass is identical
+	//until an interrupt or a component event, so those passes are skipped by advancing cpuCycle
+	struct IdleLoop {
+		bool valid;			//start and end describe the last backwards jump taken
+		bool idle;			//Loop body is side effect free
+		uint16_t start;
+		uint16_t end;		//Address of the jump back to start
+		//Registers and bus when start was last reached
+		uint8_t A, X, Y, SP, P, busVal;
+		unsigned long long headCycle;
+		unsigned long long eventCycle;	//nextEventCycle then. Moves on if an event ran during the pass
+	} idleLoop;
+
+	static const unsigned int maxIdleLoopSize = 32;
+
+	//Decode cache for code run from PRG-ROM
+	//Instructions in read only gamepak pages are decoded the first time they run. After that the handler
+	//and operand bytes come from here, though every operand fetch still takes its bus cycle
+	//Decoded ops are kept per 256 byte page of ROM, found by the page's address in the ROM image, so a
+	//bank that's switched out and back in, or mirrored at several addresses, is only decoded once
+	//mapMemory only drops the link from a CPU page to its decoded page, which is looked up again on use
+	//Pages with a write pointer (RAM, PRG-RAM) are never cached, so no write can change a decoded op
+	struct DecodedOp {
+		void (*run)(CPU &cpu);	//Untraced decode table handler. nullptr until decoded
+		uint8_t opcode;
+		bool operandsCached;	//False if the operands run into the next page, which can be another bank
+		uint8_t operand[2];
+	};
+	typedef std::array<DecodedOp, 256> DecodedPage;
+	std::unordered_map<const uint8_t*, std::unique_ptr<DecodedPage>> decodeCache;	//By ROM page address
+	std::array<DecodedPage*, 0x80> decodedPages = {};	//For CPU pages 0x80-0xFF. nullptr until looked up
+	const uint8_t *operands = nullptr;		//Cached operands of the running instruction, or nullptr to read them
+
+	//CPU address space page table. One entry per 256 byte page
+	//Pages backed by plain memory (RAM, PRGROM, PRGRAM) are read and written through a direct pointer
+	//Everything else goes through a handler, which does the register decoding
+	struct MemPage {
+		const uint8_t *read;	//Direct pointer to the page, or nullptr to use readHandler
+		uint8_t *write;		//Direct pointer to the page, or nullptr to use writeHandler
+		uint8_t (CPU::*readHandler)(uint16_t addr, bool peek);
+		void (CPU::*writeHandler)(uint16_t addr, uint8_t val);
+	};
+
+	std::array<MemPage, 256> pageTable;
+
+	uint8_t PPUregGet(uint16_t addr, bool peek);
+	void PPUregSet(uint16_t addr, uint8_t val);
+	uint8_t IOregGet(uint16_t addr, bool peek);
+	void IOregSet(uint16_t addr, uint8_t val);
+	uint8_t cartGet(uint16_t addr, bool peek);
+	void cartSet(uint16_t addr, uint8_t val);
+	void setPageHandlers(unsigned int page, uint8_t (CPU::*readHandler)(uint16_t, bool), void (CPU::*writeHandler)(uint16_t, uint8_t));
+	void initPageTable();
+	void invalidateDecoded(uint16_t addr, uint32_t size);
+	const DecodedOp *decodedOp(uint16_t addr);
+	static unsigned int instructionLength(AddressingMode mode);
+
+	void incCycle(bool ignoreIRQ=false);
+	void scheduleNextEvent();
+	bool isIdleLoop(uint16_t start, uint16_t end);
+	void checkIdleLoop(uint16_t start, uint16_t end);
+	uint8_t cpuRead(uint16_t addr, bool ignoreIRQ=false);
+	void cpuWrite(uint16_t addr, uint8_t val, bool ignoreIRQ=false);
+
+	//Untraced unless logging is enabled, so normal runs carry no trace bookkeeping
+	template<bool traced> void stepInstruction();
+	void (CPU::*stepVariant)() = &CPU::stepInstruction<false>;
+
+	void OAMDMA_write();
+	void interruptDetect();
+	void setIRQ(bool setLow);
+	void logStep();
+
+	//Glue for the decode table
+	template<void (CPU::*op)()> static void execute(CPU &cpu);
+	template<void (CPU::*op)(uint16_t), uint16_t (CPU::*mode)()> static void execute(CPU &cpu);
+
+	//Addressing functions
+	template<bool traced> uint8_t fetchOperand();
+	uint16_t Implied();
+	template<bool traced> uint16_t Immediate();
+	template<bool traced> uint16_t ZeroPage();
+	template<bool traced> uint16_t ZeroPageX();
+	template<bool traced> uint16_t ZeroPageY();
+	template<bool traced> uint16_t Absolute();
+	template<bool traced, OpType optype> uint16_t AbsoluteX();
+	template<bool traced, OpType optype> uint16_t AbsoluteY();
+	template<bool traced> uint16_t Indirect();
+	template<bool traced> uint16_t IndirectX();
+	template<bool traced, OpType optype> uint16_t IndirectY();
+
+	//CPU operation functions
+	void opADC(uint16_t addr);
+	void opAHX(uint16_t addr);
+	void opALR(uint16_t addr);
+	void opANC(uint16_t addr);
+	void opAND(uint16_t addr);
+	void opARR(uint16_t addr);
+	void opASL();
+	void opASL(uint16_t addr);
+	void opAXS(uint16_t addr);
+	template<bool traced> void opBCC();
+	template<bool traced> void opBCS();
+	template<bool traced> void opBEQ();
+	void opBIT(uint16_t addr);
+	template<bool traced> void opBMI();
+	template<bool traced> void opBNE();
+	template<bool traced> void opBPL();
+	template<bool traced> void opBRK();
+	void opBRKonIRQ();
+	template<bool traced> void opBVC();
+	template<bool traced> void opBVS();
+	void opCLC();
+	void opCLD();
+	void opCLI();
+	void opCLV();
+	void opCMP(uint8_t M);
+	void opCMP(uint16_t addr);
+	void opCPX(uint8_t M);
+	void opCPX(uint16_t addr);
+	void opCPY(uint8_t M);
+	void opCPY(uint16_t addr);
+	void opDCP(uint16_t addr);
+	void opDEC(uint16_t addr);
+	void opDEX();
+	void opDEY();
+	void opEOR(void);
+	void opEOR(uint16_t addr);
+	void opINC(uint16_t addr);
+	void opINX();
+	void opINY();
+	void opISC(uint16_t addr);
+	void opJMP(uint16_t addr);
+	void opJSR(uint16_t addr);
+	void opKIL();
+	void opLAS(uint16_t addr);
+	void opLAX(uint16_t addr);
+	void opLDA();
+	void opLDA(uint16_t addr);
+	void opLDX();
+	void opLDX(uint16_t addr);
+	void opLDY();
+	void opLDY(uint16_t addr);
+	void opLSR();
+	void opLSR(uint16_t addr);
+	void opNOP(uint16_t addr);
+	void opORA(uint16_t addr);
+	void opPHA();
+	void opPHP();
+	void opPLA();
+	void opPLP();
+	void opRLA(uint16_t addr);
+	void opROL();
+	void opROL(uint16_t addr);
+	void opROR();
+	void opROR(uint16_t addr);
+	void opRRA(uint16_t addr);
+	void opRTI();
+	void opRTS();
+	void opSAX(uint16_t addr);
+	void opSBC(uint16_t addr);
+	void opSEC();
+	void opSED();
+	void opSEI();
+	void opSHX(uint16_t addr);
+	void opSHY(uint16_t addr);
+	void opSLO(uint16_t addr);
+	void opSRE(uint16_t addr);
+	void opSTA(uint16_t addr);
+	void opSTX(uint16_t addr);
+	void opSTY(uint16_t addr);
+	void opTAS(uint16_t addr);
+	void opTAX();
+	void opTAY();
+	void opTSX();
+	void opTXA();
+	void opTXS();
+	void opTYA();
+	void opXAA(uint16_t addr);
+};
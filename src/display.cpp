@@ -3,6 +3,8 @@
 #include <glad/glad.h>
 #include <SDL.h>
 #include <iostream>
+#include <cstring>
+#include <cstdint>
 
 Display::Display()
 {
@@ -16,6 +18,7 @@ Display::Display(int width, int height, const char* title)
 
 Display::~Display()
 {
+    deleteIndexTexture();
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
@@ -37,12 +40,15 @@ void Display::init(int width, int height, const char* title)
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
 
     gl_context = SDL_GL_CreateContext(window);
+    //Emulation runs on its own thread, so vsync is what paces the GUI loop
+    SDL_GL_SetSwapInterval(1);
 
     if (!gladLoadGLLoader(SDL_GL_GetProcAddress)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
     }
 
     shader.init();
+    paletteShader.init(true);
 
     //Setup vertex data and buffers and configure
     glGenVertexArrays(1, &VAO);
@@ -76,24 +82,143 @@ void Display::init(int width, int height, const char* title)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+    //64x8 palette texture for indexed frames
+    glGenTextures(1, &paletteTexture);
+    glBindTexture(GL_TEXTURE_2D, paletteTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
     resizeImage();
 }
 
 void Display::loadTexture(int width, int height, uint8_t *data)
 {
+    indexed = false;
+    glBindTexture(GL_TEXTURE_2D, texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
     textureHeight = height;
     textureWidth = width;
 }
 
+void Display::loadIndexedTexture(int width, int height, const uint8_t *data, int emphasis)
+{
+    if(indexTexture == 0 || width != indexWidth || height != indexHeight)
+        createIndexTexture(width, height);
+
+    uploadSlot = (uploadSlot + 1) % UPLOAD_BUFFERS;
+    //Wait until the GPU has finished the last upload from this slot
+    if(uploadFences[uploadSlot] != nullptr) {
+        glClientWaitSync((GLsync)uploadFences[uploadSlot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync((GLsync)uploadFences[uploadSlot]);
+        uploadFences[uploadSlot] = nullptr;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+    if(uploadMapping != nullptr) {
+        memcpy(uploadMapping + uploadSlot*uploadSize, data, uploadSize);
+    }
+    else {
+        void *buffer = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, uploadSlot*uploadSize, uploadSize,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        memcpy(buffer, data, uploadSize);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    indexed = true;
+    this->emphasis = emphasis;
+    glBindTexture(GL_TEXTURE_2D, indexTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, indexWidth, indexHeight, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+        (void*)(uintptr_t)(uploadSlot*uploadSize));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    uploadFences[uploadSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    textureHeight = indexHeight;
+    textureWidth = indexWidth;
+}
+
+void Display::createIndexTexture(int width, int height)
+{
+    //Storage is only allocated again if the frame size changes
+    deleteIndexTexture();
+    indexWidth = width;
+    indexHeight = height;
+    uploadSize = width*height;
+
+    glGenTextures(1, &indexTexture);
+    glBindTexture(GL_TEXTURE_2D, indexTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if(GLAD_GL_ARB_texture_storage)
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, width, height);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+
+    glGenBuffers(1, &uploadPBO);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+    if(GLAD_GL_ARB_buffer_storage) {
+        //Mapped once and left mapped. Coherent, so writes need no flush before the upload
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, uploadSize*UPLOAD_BUFFERS, nullptr, flags);
+        uploadMapping = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, uploadSize*UPLOAD_BUFFERS, flags);
+    }
+    else {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, uploadSize*UPLOAD_BUFFERS, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void Display::deleteIndexTexture()
+{
+    if(indexTexture == 0) return;
+    for(void *&fence : uploadFences) {
+        if(fence != nullptr)
+            glDeleteSync((GLsync)fence);
+        fence = nullptr;
+    }
+    if(uploadMapping != nullptr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        uploadMapping = nullptr;
+    }
+    glDeleteBuffers(1, &uploadPBO);
+    glDeleteTextures(1, &indexTexture);
+    indexTexture = uploadPBO = 0;
+}
+
+void Display::loadPalette(const std::array<uint32_t, 512> &palette)
+{
+    glBindTexture(GL_TEXTURE_2D, paletteTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 64, 8, 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, palette.data());
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
 void Display::renderFrame()
 {
     glClearColor(0,0,0,1);
     glClear(GL_COLOR_BUFFER_BIT);
     
-    glBindTexture(GL_TEXTURE_2D, texture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, indexed ? indexTexture : texture);
 
-    shader.use();
+    if(indexed) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, paletteTexture);
+        glActiveTexture(GL_TEXTURE0);
+        paletteShader.use();
+        paletteShader.setInt("indexTexture", 0);
+        paletteShader.setInt("paletteTexture", 1);
+        paletteShader.setInt("emphasis", emphasis);
+    }
+    else {
+        shader.use();
+    }
     glBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
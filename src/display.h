@@ -18,6 +18,13 @@ public:
     //Load new texture into buffer
     void loadTexture(int width, int height, uint8_t *data);
 
+    //Load a frame of NES palette indices, resolved on the GPU with the table from loadPalette
+    //emphasis is PPUMASK bits 5-7 and picks the row of the table
+    //Frames stream through a ring of upload buffers, so the call only waits if the GPU is three behind
+    void loadIndexedTexture(int width, int height, const uint8_t *data, int emphasis);
+    //ARGB8888 colors for emphasis << 6 | index, as from RENDER::buildARGBPalette
+    void loadPalette(const std::array<uint32_t, 512> &palette);
+
     //Render texture and menu if enabled
     void renderFrame();
 
@@ -37,11 +44,23 @@ private:
     int textureWidth = 256, textureHeight = 240, menuBarHeight = 19;
     SDL_GLContext gl_context;
     SDL_Window *window;
-    Shader shader;
+    Shader shader, paletteShader;
+    bool indexed = false;
+    int emphasis = 0;
 
     std::function<void()> menuCallbackFun;
 
-    unsigned int VBO, VAO, EBO, texture;
+    unsigned int VBO, VAO, EBO, texture, paletteTexture;
+
+    //Indexed frames: immutable texture plus a ring of pixel buffer objects to upload from
+    static const int UPLOAD_BUFFERS = 3;
+    unsigned int indexTexture = 0, uploadPBO = 0;
+    int indexWidth = 0, indexHeight = 0, uploadSize = 0, uploadSlot = 0;
+    uint8_t *uploadMapping = nullptr;	//Persistent mapping of the whole ring, if supported
+    std::array<void*, UPLOAD_BUFFERS> uploadFences = {};	//GLsync for the last upload from each slot
+
+    void createIndexTexture(int width, int height);
+    void deleteIndexTexture();
 
     float vertices[20] = {
          //positions          // texture coords
@@ -1,9 +1,89 @@
 #include "emulator.h"
 #include "nes.h"
 #include "gui.h"
+#include "triplebuffer.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace EMULATOR {
 
+//The NES runs on its own thread. The GUI thread only talks to it through these
+std::atomic<bool> stopping;
+std::atomic<uint16_t> input;
+TripleBuffer<Frame> frames;
+std::mutex commandMutex;
+std::vector<std::function<void()>> commands;
+
+void post(std::function<void()> command)
+{
+    std::lock_guard<std::mutex> lock(commandMutex);
+    commands.push_back(command);
+}
+
+void setInput(uint16_t buttons)
+{
+    input.store(buttons, std::memory_order_relaxed);
+}
+
+bool latestFrame(const Frame *&frame)
+{
+    bool changed = frames.update();
+    frame = &frames.front();
+    return changed;
+}
+
+bool isStopping()
+{
+    return stopping;
+}
+
+void runCommands()
+{
+    std::vector<std::function<void()>> pending;
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        pending.swap(commands);
+    }
+    for(auto &command : pending)
+        command();
+}
+
+void publishFrame()
+{
+    Frame &frame = frames.back();
+    std::copy(NES::getPixelMap(), NES::getPixelMap() + frame.pixels.size(), frame.pixels.begin());
+    frame.emphasis = NES::getEmphasis();
+    frame.number = NES::getFrameNum();
+    frames.publish();
+}
+
+void emulationLoop()
+{
+    unsigned long lastFrame = NES::getFrameNum();
+    while(stopping == false) {
+        runCommands();
+
+        uint16_t buttons = input.load(std::memory_order_relaxed);
+        NES::controller_state[0] = buttons & 0xFF;
+        NES::controller_state[1] = buttons >> 8;
+
+        NES::frameStep();
+        if(NES::romLoaded && NES::getFrameNum() != lastFrame) {
+            lastFrame = NES::getFrameNum();
+            publishFrame();
+        }
+
+        //Audio output paces the emulator. Without it, only pausing slows it down
+        if(NES::running)
+            GUI::updateAudio();
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
 int start(StartOptions startOptions)
 {
     if(startOptions.disableAudio) GUI::onEmuSpeedMax();
@@ -16,14 +96,21 @@ int start(StartOptions startOptions)
         if(NES::loadROM(startOptions.filename) == 0)
 	        NES::powerOn();
     }
-	
+
+    stopping = false;
+    std::thread emulation(emulationLoop);
+
     while(GUI::quit == 0)
 	{
 		GUI::update();
-		NES::frameStep();
 	}
 
+    stopping = true;
+    emulation.join();
+
+    NES::disableLogging();
+    if(startOptions.profile) NES::writeProfile("profile");
     return 0;
 }
 
-} //EMULATOR
\ No newline at end of file
+} //EMULATOR
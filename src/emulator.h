@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <array>
+#include <functional>
 
 namespace EMULATOR {
 
@@ -9,11 +11,31 @@ struct StartOptions {
     bool startAtPC = false;
     uint16_t debugPC;
     bool log = false;
+    bool profile = false;
     bool disableAudio = false;
 };
 
+//A completed frame, as handed from the emulation thread to the GUI
+struct Frame {
+    std::array<uint8_t, 256*240> pixels;   //Palette indices, as PPU::pixelMap
+    uint8_t emphasis;                       //PPUMASK bits 5-7 at the end of the frame
+    unsigned long number;
+};
+
 
 int start(StartOptions startOptions);
 
+//Called from the GUI thread
+//Runs command on the emulation thread between frames. Anything touching NES state has to go through here
+void post(std::function<void()> command);
+//Controller 1 buttons in the low byte, controller 2 in the high byte. Read once per frame
+void setInput(uint16_t buttons);
+//Latest completed frame. Returns true if it changed since the last call
+bool latestFrame(const Frame *&frame);
+
+//Called from the emulation thread
+//True once the GUI wants the emulation thread to exit. Anything it waits on has to give up when this is set
+bool isStopping();
+
 
-} //EMULATOR
\ No newline at end of file
+} //EMULATOR
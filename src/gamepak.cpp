@@ -1,5 +1,5 @@
 #include "gamepak.h"
-#include "ppu.h"
+#include "console.h"
 #include "Mapper/mapper.h"
 #include "Mapper/mapper0.h"
 #include "Mapper/mapper1.h"
@@ -13,28 +13,35 @@
 #include <array>
 #include <math.h>
 
-namespace GAMEPAK {
+static const char* headerName = "NES\x1A";
 
-Mapper *mapper;
-const char* headerName = "NES\x1A";
-ROMInfo romInfo = {0};
-long mapperNum = 0;
-int submapperNum = 0;
+GAMEPAK::~GAMEPAK()
+{
+	delete mapper;
+}
+
+template<class M>
+void GAMEPAK::bind(M *newMapper) {
+	delete mapper;
+	mapper = newMapper;
+	bus = newMapper->bus();
+	//Watching fetches is a property of the board, so this only has to be decided once
+	bool direct = !newMapper->M::watchesPPUfetches();
+	CHRpages = direct ? newMapper->CHRpageTable() : nullptr;
+	nametables = direct ? newMapper->nametablePageTable() : nullptr;
+}
 
-int loadROM(std::ifstream &file) {
+int GAMEPAK::loadROM(std::shared_ptr<const ROMImage> newImage) {
 	std::array<char, 16> headerdata;
 	uint8_t mapperNum;
 
-	file.seekg(0, file.end);
-	long fileSize = file.tellg();
-	file.seekg(0, file.beg);
-
+	long fileSize = newImage->size();
 	if(fileSize < 16) {
 		std::cerr << "Invalid file" << std::endl;
 		return 1;
 	}
 
-	file.read(headerdata.data(),16);
+	memcpy(headerdata.data(), newImage->data(), 16);
 	
 	if(memcmp(headerName,headerdata.data(),4) != 0) {
 		std::cout << "Invalid file format\nIS: ";
@@ -136,6 +143,29 @@ int loadROM(std::ifstream &file) {
 		romInfo.iNESversion = 1;
 	}
 
+	if(mapperNum > 4) {
+		std::cerr << "Unsupported mapper: " << (int)mapperNum << std::endl;
+		return 1;
+	}
+
+	//Smallest PRG and CHR bank each mapper switches. Mappers page ROM in whole banks, so it has to be
+	//made of them, and there has to be PRG to run. No CHR is fine, mappers use CHR RAM instead
+	static const long bankSizes[5][2] = {
+		{0x4000, 0x2000},	//NROM
+		{0x4000, 0x1000},	//MMC1
+		{0x4000, 0x2000},	//UxROM
+		{0x4000, 0x2000},	//CNROM
+		{0x2000, 0x0400},	//MMC3
+	};
+	if(romInfo.PRGROMsize == 0) {
+		std::cerr << "No PRG ROM. Unable to load." << std::endl;
+		return 1;
+	}
+	if(romInfo.PRGROMsize % bankSizes[mapperNum][0] != 0 || romInfo.CHRROMsize % bankSizes[mapperNum][1] != 0) {
+		std::cerr << "PRG or CHR ROM size isn't a whole number of banks. Unable to load." << std::endl;
+		return 1;
+	}
+
 	if((romInfo.PRGROMsize + romInfo.CHRROMsize) > (fileSize - 16 - ((romInfo.trainer) ? 512 : 0))) {
 		std::cerr << "File size smaller than expected for defined program size. Unable to load." << std::endl;
 		std::cerr << "File size: " << fileSize << " Expected: "
@@ -147,60 +177,45 @@ int loadROM(std::ifstream &file) {
 				  << "Misc ROM area not currently supported, and will be ignored." << std::endl;
 	}
 	
+	//Mapper sets up its own pages at powerOn
+	console.cpu.unmapMemory(0x4100, 0xBF00);
+
+	//PRG then CHR, after the header and the trainer if there is one
+	size_t PRGstart = 16 + ((romInfo.trainer) ? 512 : 0);
+	ROMSpan PRG = newImage->span(PRGstart, romInfo.PRGROMsize);
+	ROMSpan CHR = newImage->span(PRGstart + romInfo.PRGROMsize, romInfo.CHRROMsize);
 	switch(mapperNum) {
-		case 0: mapper = new Mapper0(romInfo, file); break;
-		case 1: mapper = new Mapper1(romInfo, file); break;
-		case 2: mapper = new Mapper2(romInfo, file); break;
-		case 3: mapper = new Mapper3(romInfo, file); break;
-		case 4: mapper = new Mapper4(romInfo, file); break;
-		default:
-			std::cerr << "Unsupported mapper: " << (int)mapperNum << std::endl;
-			return 1;
+		case 0: bind(new Mapper0(console, romInfo, PRG, CHR)); break;
+		case 1: bind(new Mapper1(console, romInfo, PRG, CHR)); break;
+		case 2: bind(new Mapper2(console, romInfo, PRG, CHR)); break;
+		case 3: bind(new Mapper3(console, romInfo, PRG, CHR)); break;
+		case 4: bind(new Mapper4(console, romInfo, PRG, CHR)); break;
 	}
+	//The old mapper is gone, so its image can go too
+	image = std::move(newImage);
 	
 	return 0;
 }
 
-void powerOn() {
+void GAMEPAK::powerOn() {
 	mapper->powerOn();
 }
 
-void reset()
+void GAMEPAK::reset()
 {
 	mapper->reset();
 }
 
-void CPUstep()
-{
-	mapper->CPUstep();
-}
-
-void PPUstep()
-{
-	mapper->PPUstep();
-}
-
-uint8_t CPUmemGet(uint16_t addr, bool peek) {
-	return mapper->memGet(addr, peek);
+uint8_t GAMEPAK::CPUmemGet(uint16_t addr, bool peek) {
+	return bus.CPUmemGet(mapper, addr, peek);
 }
 
-void CPUmemSet(uint16_t addr, uint8_t val) {
-	mapper->memSet(addr, val);
+void GAMEPAK::CPUmemSet(uint16_t addr, uint8_t val) {
+	bus.CPUmemSet(mapper, addr, val);
 }
 
-uint8_t PPUmemGet(uint16_t addr, bool peek)
+unsigned int GAMEPAK::PRGbank(uint16_t addr) const
 {
-	return mapper->PPUmemGet(addr, peek);
+	if(mapper == nullptr) return 0;
+	return mapper->PRGbank(addr);
 }
-
-void PPUmemSet(uint16_t addr, uint8_t val)
-{
-	mapper->PPUmemSet(addr, val);
-}
-
-void PPUbusAddrChanged(uint16_t newAddr)
-{
-	mapper->PPUbusAddrChanged(newAddr);
-}
-
-}
\ No newline at end of file
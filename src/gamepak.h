@@ -1,81 +1,133 @@
 #pragma once
 
 #include <stdint.h>
-#include <fstream>
+#include <memory>
+#include "romimage.h"
 
-namespace GAMEPAK {
+class Console;
+class Mapper;
 
-struct iNES_Header {
-	char NES[4];				//bytes 0-3
-	uint8_t PRGROM_Size;		//bytes 4
-	uint8_t CHRROM_Size;		//bytes 5
-	uint8_t mirroring : 1;		//bytes 6.0
-	uint8_t BattRAM : 1;		//bytes 6.1
-	uint8_t trainer : 1;		//bytes 6.2
-	uint8_t FourScreenMode : 1;	//bytes 6.3
-	uint8_t mapperNib1 : 4;		//bytes 6.4-7
-	uint8_t consoleType : 2;	//bytes 7.0-1
-	uint8_t iNES2 : 2;			//bytes 7.2-3
-	uint8_t mapperNib2 : 4;		//bytes 7.4-7
-	uint8_t PRGRAM_Size;		//bytes 8
-}__attribute__((packed));
+class GAMEPAK {
+	public:
+	struct iNES_Header {
+		char NES[4];				//bytes 0-3
+		uint8_t PRGROM_Size;		//bytes 4
+		uint8_t CHRROM_Size;		//bytes 5
+		uint8_t mirroring : 1;		//bytes 6.0
+		uint8_t BattRAM : 1;		//bytes 6.1
+		uint8_t trainer : 1;		//bytes 6.2
+		uint8_t FourScreenMode : 1;	//bytes 6.3
+		uint8_t mapperNib1 : 4;		//bytes 6.4-7
+		uint8_t consoleType : 2;	//bytes 7.0-1
+		uint8_t iNES2 : 2;			//bytes 7.2-3
+		uint8_t mapperNib2 : 4;		//bytes 7.4-7
+		uint8_t PRGRAM_Size;		//bytes 8
+	}__attribute__((packed));
 
-struct iNES2_Header {
-	char NES[4];					//bytes 0-3
-	uint8_t PRGROM_LSB;				//bytes 4
-	uint8_t CHRROM_LSB;				//bytes 5
-	uint8_t mirroring : 1;			//bytes 6.0
-	uint8_t BattRAM : 1;			//bytes 6.1
-	uint8_t trainer : 1;			//bytes 6.2
-	uint8_t FourScreenMode : 1;		//bytes 6.3
-	uint8_t mapperNib1 : 4;			//bytes 6.4-7
-	uint8_t consoleType : 2;		//bytes 7.0-1
-	uint8_t iNES2 : 2;				//bytes 7.2-3
-	uint8_t mapperNib2 : 4;			//bytes 7.4-7
-	uint8_t mapperNib3 : 4;			//bytes 8.0-3
-	uint8_t submapper : 4;			//bytes 8.4-7
-	uint8_t PRGROM_MSB : 4;			//bytes 9.0-3
-	uint8_t CHRROM_MSB : 4;			//bytes 9.4-7
-	uint8_t PRGRAM_shiftcnt : 4;	//bytes 10.0-3
-	uint8_t PRGNVRAM_shiftcnt : 4;	//bytes 10.4-7
-	uint8_t CHRRAM_shiftcnt : 4;	//bytes 11.0-3
-	uint8_t CHRNVRAM_shiftcnt : 4;	//bytes 11.4-7
-	uint8_t timingMode : 2;			//bytes 12.0-1
-	uint8_t junkByte12 : 6;			//bytes 12.2-7
-	uint8_t PPU_Console_Type : 4;	//bytes 13.0-3
-	uint8_t vsHardwareType : 4;		//bytes 13.4-7
-	uint8_t miscRomCnt	: 2;		//bytes 14.0-1
-	uint8_t junkByte14 : 6;			//bytes 14.2-7
-	uint8_t defExpDevice : 6;		//bytes 15.0-5
-	uint8_t junkByte15 : 2;			//bytes 15.6-7
-}__attribute__((packed));
+	struct iNES2_Header {
+		char NES[4];					//bytes 0-3
+		uint8_t PRGROM_LSB;				//bytes 4
+		uint8_t CHRROM_LSB;				//bytes 5
+		uint8_t mirroring : 1;			//bytes 6.0
+		uint8_t BattRAM : 1;			//bytes 6.1
+		uint8_t trainer : 1;			//bytes 6.2
+		uint8_t FourScreenMode : 1;		//bytes 6.3
+		uint8_t mapperNib1 : 4;			//bytes 6.4-7
+		uint8_t consoleType : 2;		//bytes 7.0-1
+		uint8_t iNES2 : 2;				//bytes 7.2-3
+		uint8_t mapperNib2 : 4;			//bytes 7.4-7
+		uint8_t mapperNib3 : 4;			//bytes 8.0-3
+		uint8_t submapper : 4;			//bytes 8.4-7
+		uint8_t PRGROM_MSB : 4;			//bytes 9.0-3
+		uint8_t CHRROM_MSB : 4;			//bytes 9.4-7
+		uint8_t PRGRAM_shiftcnt : 4;	//bytes 10.0-3
+		uint8_t PRGNVRAM_shiftcnt : 4;	//bytes 10.4-7
+		uint8_t CHRRAM_shiftcnt : 4;	//bytes 11.0-3
+		uint8_t CHRNVRAM_shiftcnt : 4;	//bytes 11.4-7
+		uint8_t timingMode : 2;			//bytes 12.0-1
+		uint8_t junkByte12 : 6;			//bytes 12.2-7
+		uint8_t PPU_Console_Type : 4;	//bytes 13.0-3
+		uint8_t vsHardwareType : 4;		//bytes 13.4-7
+		uint8_t miscRomCnt	: 2;		//bytes 14.0-1
+		uint8_t junkByte14 : 6;			//bytes 14.2-7
+		uint8_t defExpDevice : 6;		//bytes 15.0-5
+		uint8_t junkByte15 : 2;			//bytes 15.6-7
+	}__attribute__((packed));
 
-struct ROMInfo {
-	bool trainer;
-	long PRGROMsize;
-	long CHRROMsize;
-	long PRGRAMsize;
-	long PRGNVRAMsize;
-	long CHRRAMsize;
-	long CHRNVRAMsize;
-	uint8_t mirroringMode;
-	bool batteryPresent;
-	bool fourScreenMode;
-	uint8_t iNESversion;
-};
+	struct ROMInfo {
+		bool trainer;
+		long PRGROMsize;
+		long CHRROMsize;
+		long PRGRAMsize;
+		long PRGNVRAMsize;
+		long CHRRAMsize;
+		long CHRNVRAMsize;
+		uint8_t mirroringMode;
+		bool batteryPresent;
+		bool fourScreenMode;
+		uint8_t iNESversion;
+	};
+
+	//Entry points into the loaded mapper, bound once by loadROM (see makeBus in Mapper/mapper.h)
+	//Each one is a non-virtual call into the concrete mapper class, compiled alongside it so the
+	//mapper's own code is inlined. Steps are null for mappers that don't use them
+	struct MapperBus {
+		uint8_t (*CPUmemGet)(Mapper *mapper, uint16_t addr, bool peek);
+		void (*CPUmemSet)(Mapper *mapper, uint16_t addr, uint8_t val);
+		uint8_t (*PPUmemGet)(Mapper *mapper, uint16_t addr, bool peek);
+		void (*PPUmemSet)(Mapper *mapper, uint16_t addr, uint8_t val);
+		void (*CPUstep)(Mapper *mapper);
+		void (*PPUstep)(Mapper *mapper);
+		void (*PPUbusAddrChanged)(Mapper *mapper, uint16_t newAddr);
+		bool (*clockedByPPU)(Mapper *mapper);
+		bool (*watchesPPUfetches)(Mapper *mapper);
+		unsigned int (*CHRbank)(Mapper *mapper, uint16_t addr);
+	};
+
+	explicit GAMEPAK(Console &console) : console(console) {}
+	~GAMEPAK();
+	GAMEPAK(const GAMEPAK&) = delete;
+	GAMEPAK &operator=(const GAMEPAK&) = delete;
 
-int loadROM(std::ifstream &file);
-void powerOn();
-void reset();
-void CPUstep();
-void PPUstep();
+	int loadROM(std::shared_ptr<const ROMImage> image);
+	void powerOn();
+	void reset();
 
-uint8_t CPUmemGet(uint16_t addr, bool peek = false);
-void CPUmemSet(uint16_t addr, uint8_t val);
-uint8_t PPUmemGet(uint16_t addr, bool peek = false);
-void PPUmemSet(uint16_t addr, uint8_t val);
+	inline void CPUstep() { if(bus.CPUstep) bus.CPUstep(mapper); }
+	inline void PPUstep() { if(bus.PPUstep) bus.PPUstep(mapper); }
+	inline bool stepsWithCPU() { return bus.CPUstep != nullptr; }
 
-void PPUbusAddrChanged(uint16_t newAddr);
+	uint8_t CPUmemGet(uint16_t addr, bool peek = false);
+	void CPUmemSet(uint16_t addr, uint8_t val);
+	inline uint8_t PPUmemGet(uint16_t addr, bool peek = false) { return bus.PPUmemGet(mapper, addr, peek); }
+	//Pattern and nametable fetches while rendering (addr below 0x3F00). Read straight through the
+	//mapper's pages unless it watches the fetches, so most mappers cost two loads instead of a call
+	inline uint8_t PPUfetch(uint16_t addr) {
+		if(CHRpages == nullptr) return bus.PPUmemGet(mapper, addr, false);
+		if(addr < 0x2000) return CHRpages[addr >> 10][addr & 0x3FF];
+		return nametables[(addr >> 10) & 3][addr & 0x3FF];
+	}
+	inline void PPUmemSet(uint16_t addr, uint8_t val) { bus.PPUmemSet(mapper, addr, val); }
 
+	inline void PPUbusAddrChanged(uint16_t newAddr) { bus.PPUbusAddrChanged(mapper, newAddr); }
+	//These three are safe to call with no ROM loaded
+	inline bool clockedByPPU() { return bus.clockedByPPU && bus.clockedByPPU(mapper); }
+	inline bool watchesPPUfetches() { return bus.watchesPPUfetches && bus.watchesPPUfetches(mapper); }
+	inline unsigned int CHRbank(uint16_t addr) { return bus.CHRbank ? bus.CHRbank(mapper, addr) : 0; }
+	unsigned int PRGbank(uint16_t addr) const;
 
-} //GAMEPAK
\ No newline at end of file
+	private:
+	Console &console;
+
+	Mapper *mapper = nullptr;
+	MapperBus bus = {};
+	//Mapper's page tables, or null if it watches PPU fetches (see PPUfetch)
+	const uint8_t *const *CHRpages = nullptr;
+	const uint8_t *const *nametables = nullptr;
+	std::shared_ptr<const ROMImage> image;	//Mapper reads ROM straight out of this
+	ROMInfo romInfo = {};
+	long mapperNum = 0;
+	int submapperNum = 0;
+
+	template<class M> void bind(M *newMapper);
+};
@@ -2,6 +2,9 @@
 #include "display.h"
 #include "nes.h"
 #include "render.h"
+#include "emulator.h"
+#include "spscring.h"
+#include "resampler.h"
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_sdl.h"
 #include "imgui/imgui_impl_opengl3.h"
@@ -11,6 +14,7 @@
 #include <cstring>
 #include <array>
 #include <vector>
+#include <atomic>
 #include <iostream>
 #if defined(__WIN32__)
 #include <windows.h>
@@ -23,20 +27,21 @@ Display mainDisplay;
 SDL_Event event;
 const uint8_t *kbState = SDL_GetKeyboardState(NULL);
 
-std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT * 3> mainpixelMap;
+std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT> blankScreen; //Palette indices shown with no ROM loaded
+const EMULATOR::Frame *shownFrame = nullptr;
+uint8_t controller1 = 0;
 std::array<uint32_t, 16*8 * 16*8> PTpixelMap;
 
-//Ratio between APU sample rate and emulator sample rate isn't a
-//whole number, so using a float accounts for rounding
-float rawSamplesPerSample = 1;
-
-int volatile audio_buffer_count, audio_rb_idx;
-int audio_wb_idx, audio_wb_pos;
-std::vector<std::array<int16_t, AUDIO_BUFFER_SIZE>> audio_buffers;
-SDL_sem * volatile audio_semaphore;
+//Samples on their way from the emulation thread to the SDL audio callback
+SPSCRing<int16_t> audioRing(AUDIO_RING_SIZE);
+size_t audioLatency;    //Most samples kept queued in audioRing
+SDL_AudioDeviceID audioDevice = 0;
+int deviceSampleRate = AUDIO_SAMPLE_RATE;
+//From the APU's rate to whatever the device settled on
+Resampler resampler(AUDIO_RESAMPLER_TAPS);
 
 bool showFPS = false;
-bool disableAudio = false;
+std::atomic<bool> disableAudio{false};
 bool debugPPU = false;
 
 bool quit = false;
@@ -73,8 +78,10 @@ int init()
         return 1;
     }
 
-    mainpixelMap.fill(0);
-    mainDisplay.loadTexture(SCREEN_WIDTH, SCREEN_HEIGHT, mainpixelMap.data());
+    //Frames are uploaded as palette indices and colored by the shader
+    blankScreen.fill(0x0F); //Black
+    mainDisplay.loadPalette(RENDER::buildARGBPalette());
+    mainDisplay.loadIndexedTexture(SCREEN_WIDTH, SCREEN_HEIGHT, blankScreen.data(), 0);
 
     return 0;
 }
@@ -144,32 +151,29 @@ int init()
 }*/
 
 int initAudio() {
-    audio_rb_idx = 0;
-    audio_wb_idx = 0;
-    audio_wb_pos = 0;
-
-    rawSamplesPerSample = (float)NES::APU_CLOCK_RATE/AUDIO_SAMPLE_RATE;
-
-    //Create audio buffer
-    int32_t sample_latency = WANTED_AUDIO_LATENCY_MS * AUDIO_SAMPLE_RATE * AUDIO_CHANNELS / 1000;
-    audio_buffer_count = sample_latency / AUDIO_BUFFER_SIZE;
-    if(audio_buffer_count < 2)
-        audio_buffer_count = 2;
-    audio_buffers.resize(audio_buffer_count);
-
-    //Create SDL semaphore
-    audio_semaphore = SDL_CreateSemaphore(audio_buffer_count-1);
+    NES::setAudioSampleRate(AUDIO_SAMPLE_RATE);
 
-    SDL_AudioSpec wantedSpec;
+    SDL_AudioSpec wantedSpec, obtainedSpec;
+    SDL_zero(wantedSpec);
     wantedSpec.freq = AUDIO_SAMPLE_RATE;
     wantedSpec.format = AUDIO_S16SYS;
     wantedSpec.channels = AUDIO_CHANNELS;
     wantedSpec.samples = AUDIO_BUFFER_SIZE;
     wantedSpec.callback = fill_audio_buffer;
 
-    if(SDL_OpenAudio(&wantedSpec, 0) < 0)
+    //Take the device's own rate rather than have SDL convert, the resampler does a better job
+    audioDevice = SDL_OpenAudioDevice(NULL, 0, &wantedSpec, &obtainedSpec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if(audioDevice == 0)
         return 1;
-    SDL_PauseAudio(0);
+    deviceSampleRate = obtainedSpec.freq;
+    resampler = Resampler(AUDIO_RESAMPLER_TAPS, 0.9 * std::min(1.0, (double)deviceSampleRate / AUDIO_SAMPLE_RATE));
+    resampler.setRatio((double)AUDIO_SAMPLE_RATE / deviceSampleRate);
+
+    audioLatency = WANTED_AUDIO_LATENCY_MS * deviceSampleRate * AUDIO_CHANNELS / 1000;
+    audioLatency = std::max(audioLatency, (size_t)AUDIO_BUFFER_SIZE*2);
+    audioLatency = std::min(audioLatency, audioRing.capacity());
+
+    SDL_PauseAudioDevice(audioDevice, 0);
     return 0;
 }
 
@@ -196,32 +200,32 @@ void update()
                     RctrlPressed = true;
                     break;
                 case SDLK_x:
-                    NES::controller_state[0] |= 1;
+                    controller1 |= 1;
                     break;
                 case SDLK_z:
-                    NES::controller_state[0] |= (1<<1);
+                    controller1 |= (1<<1);
                     break;
                 case SDLK_SPACE:
-                    NES::controller_state[0] |= (1<<2);
+                    controller1 |= (1<<2);
                     break;
                 case SDLK_RETURN:
-                    NES::controller_state[0] |= (1<<3);
+                    controller1 |= (1<<3);
                     break;
                 case SDLK_UP:
-                    NES::controller_state[0] |= (1<<4);
+                    controller1 |= (1<<4);
                     break;
                 case SDLK_DOWN:
-                    NES::controller_state[0] |= (1<<5);
+                    controller1 |= (1<<5);
                     break;
                 case SDLK_LEFT:
-                    NES::controller_state[0] |= (1<<6);
+                    controller1 |= (1<<6);
                     break;
                 case SDLK_RIGHT:
-                    NES::controller_state[0] |= (1<<7);
+                    controller1 |= (1<<7);
                     break;
                 case SDLK_r:
                     if(LctrlPressed || RctrlPressed) {
-                        NES::reset();
+                        EMULATOR::post(NES::reset);
                     }
                     break;
                 case SDLK_ESCAPE:
@@ -240,52 +244,47 @@ void update()
                     RctrlPressed = false;
                     break;
                 case SDLK_x:
-                    NES::controller_state[0] &= ~1;
+                    controller1 &= ~1;
                     break;
                 case SDLK_z:
-                    NES::controller_state[0] &= ~(1<<1);
+                    controller1 &= ~(1<<1);
                     break;
                 case SDLK_SPACE:
-                    NES::controller_state[0] &= ~(1<<2);
+                    controller1 &= ~(1<<2);
                     break;
                 case SDLK_RETURN:
-                    NES::controller_state[0] &= ~(1<<3);
+                    controller1 &= ~(1<<3);
                     break;
                 case SDLK_UP:
-                    NES::controller_state[0] &= ~(1<<4);
+                    controller1 &= ~(1<<4);
                     break;
                 case SDLK_DOWN:
-                    NES::controller_state[0] &= ~(1<<5);
+                    controller1 &= ~(1<<5);
                     break;
                 case SDLK_LEFT:
-                    NES::controller_state[0] &= ~(1<<6);
+                    controller1 &= ~(1<<6);
                     break;
                 case SDLK_RIGHT:
-                    NES::controller_state[0] &= ~(1<<7);
+                    controller1 &= ~(1<<7);
                     break;
             }
         }
     }
 
-    //Update controller 2 keypresses
-    NES::controller_state[1] = 0;
+    //Controller 2 isn't mapped to anything yet
+    EMULATOR::setInput(controller1);
     
     updateMainWindow();
     //if(debugPPU) {
     //    updatePPUWindow();
     //}
-    if(disableAudio == false)
-        updateAudio();
 
 }
 
 void updateMainWindow() {
-    if(NES::romLoaded)
-        RENDER::convertNTSC2RGB(mainpixelMap.data(), NES::getPixelMap(), SCREEN_WIDTH*SCREEN_HEIGHT*3);
-    else
-        mainpixelMap.fill(0);
-    
-    mainDisplay.loadTexture(SCREEN_WIDTH, SCREEN_HEIGHT, mainpixelMap.data());
+    //Only uploads when the emulation thread has finished a new frame
+    if(EMULATOR::latestFrame(shownFrame))
+        mainDisplay.loadIndexedTexture(SCREEN_WIDTH, SCREEN_HEIGHT, shownFrame->pixels.data(), shownFrame->emphasis);
 
     mainDisplay.renderFrame();
 }
@@ -320,45 +319,52 @@ void updateMainWindow() {
 }*/
 
 void updateAudio() {
-    //Currently downsample using nearest neighbor method
-    //TODO: Look into using FIR filter or similar
-    int size = NES::rawAudio.writeIdx - NES::rawAudio.readIdx;
-    if(size < 0) size += NES::rawAudio.buffer.size();
-
-    float currentRawBufferIdx = NES::rawAudio.readIdx;
-    while(size > 0) {
-        audio_buffers[audio_wb_idx][audio_wb_pos] = (int16_t)((NES::rawAudio.buffer[(unsigned int)currentRawBufferIdx]*2.0f - 1.0f) * 0xFFF);
-        currentRawBufferIdx += rawSamplesPerSample;
-        if(currentRawBufferIdx >= NES::rawAudio.buffer.size()) currentRawBufferIdx -= (float)NES::rawAudio.buffer.size();
-        size -= rawSamplesPerSample;
-        ++audio_wb_pos;
-
-        if(audio_wb_pos >= AUDIO_BUFFER_SIZE) {
-            //If current buffer full, move to next one
-            //If all buffers full, wait
-            audio_wb_pos = 0;
-            audio_wb_idx = (audio_wb_idx + 1) % audio_buffer_count;
-            SDL_SemWait(audio_semaphore);
+    //Runs on the emulation thread, and blocks it while enough audio is queued
+    if(disableAudio) return;
+
+    //The APU hands over finished, band limited samples, which only need moving to the device rate
+    std::array<int16_t, AUDIO_BUFFER_SIZE> block;
+    std::array<int16_t, AUDIO_BUFFER_SIZE> resampled;
+    int count;
+    while((count = NES::readAudio(block.data(), block.size())) > 0) {
+        int written = 0;
+        while(written < count) {
+            written += resampler.write(block.data() + written, count - written);
+            int produced;
+            while((produced = resampler.read(resampled.data(), resampled.size())) > 0)
+                queueAudio(resampled.data(), produced);
         }
     }
-    NES::rawAudio.readIdx = currentRawBufferIdx;
 }
 
-void fill_audio_buffer(void *user_data, uint8_t *out, int byte_count) {
-    if(SDL_SemValue(audio_semaphore) < audio_buffers.size() - 1) {
-        //At least one full buffer
-        if(byte_count != AUDIO_BUFFER_SIZE*sizeof(int16_t))
-            std::cout << "Wrong buffer size: " << byte_count << " vs " << AUDIO_BUFFER_SIZE*sizeof(int16_t) << std::endl;
-        memcpy(out, audio_buffers[audio_rb_idx].data(), AUDIO_BUFFER_SIZE*sizeof(int16_t));
-        audio_rb_idx = (audio_rb_idx+1) % audio_buffers.size();
-        SDL_SemPost(audio_semaphore);
-    }
-    else {
-        //No buffers full. Just output silence
-        memset(out, 0, byte_count);
+void queueAudio(const int16_t *samples, size_t count) {
+    //Keeps at most audioLatency samples queued. The device drains them at a steady rate
+    //If it stops draining, samples are dropped once the emulation thread is asked to exit
+    while(count > 0) {
+        size_t queued = audioRing.size();
+        if(queued >= audioLatency) {
+            if(EMULATOR::isStopping()) return;
+            SDL_Delay(1);
+            continue;
+        }
+        size_t pushed = audioRing.push(samples, std::min(count, audioLatency - queued));
+        samples += pushed;
+        count -= pushed;
     }
 }
 
+size_t queuedAudio() {
+    return audioRing.size();
+}
+
+void fill_audio_buffer(void *user_data, uint8_t *out, int byte_count) {
+    //Runs on the SDL audio thread. Pads with silence if the emulator falls behind
+    int16_t *samples = (int16_t*)out;
+    size_t count = byte_count / sizeof(int16_t);
+    size_t popped = audioRing.pop(samples, count);
+    std::fill(samples + popped, samples + count, 0);
+}
+
 void _drawmainMenuBar() {
 	static bool menu_open_file = false;
 	static bool menu_quit = false;
@@ -439,7 +445,8 @@ void _drawmainMenuBar() {
 			ImGui::EndMenu();
 		}
         if(showFPS) {
-            std::string FPStext = "FPS: " + std::to_string(ImGui::GetIO().Framerate);
+            std::string FPStext = "FPS: " + std::to_string(ImGui::GetIO().Framerate)
+                + "  Audio: " + std::to_string(queuedAudio() * 1000 / deviceSampleRate) + "ms";
             ImGui::TextColored(ImColor(255,100,100), FPStext.c_str());
         }
 		ImGui::EndMainMenuBar();
@@ -458,7 +465,7 @@ void onOpenFile()
         ZeroMemory( &ofn,      sizeof( ofn ) );
         ofn.lStructSize  = sizeof( ofn );
         ofn.hwndOwner    = NULL;  // If you have a window to center over, put its HANDLE here
-        ofn.lpstrFilter  = "iNES ROM Files\0*.nes\0Any File\0*.*\0";
+        ofn.lpstrFilter  = "iNES ROM Files\0*.nes;*.zip;*.gz\0Any File\0*.*\0";
         ofn.lpstrFile    = filename;
         ofn.nMaxFile     = MAX_PATH;
         ofn.lpstrTitle   = "Select a ROM to load";
@@ -466,8 +473,11 @@ void onOpenFile()
     
     if (GetOpenFileNameA( &ofn ))
     {
-        NES::loadROM(filename);
-        NES::powerOn();
+        std::string file(filename);
+        EMULATOR::post([file]() {
+            if(NES::loadROM(file) == 0)
+                NES::powerOn();
+        });
     }
 }
 #endif
@@ -479,28 +489,30 @@ void onQuit()
 
 void onEmuRun()
 {
-    NES::pause(false);
+    EMULATOR::post([]() { NES::pause(false); });
 }
 
 void onEmuPause()
 {
-    NES::pause(true);
+    EMULATOR::post([]() { NES::pause(true); });
 }
 
 void onEmuStep()
 {
-    NES::pause(true);
-    NES::frameStep(true);
+    EMULATOR::post([]() {
+        NES::pause(true);
+        NES::frameStep(true);
+    });
 }
 
 void onEmuPower()
 {
-    NES::powerOn();
+    EMULATOR::post(NES::powerOn);
 }
 
 void onEmuReset()
 {
-    NES::reset();
+    EMULATOR::post(NES::reset);
 }
 
 void onEmuSpeed(int pct)
@@ -525,9 +537,9 @@ void onDebugWindow()
 
 void onGetFrameInfo()
 {
-    uint8_t *screenOutput = NES::getPixelMap();
-    unsigned int crc = crc32(0L, screenOutput, 240*256);
-    std::cout << "FrameNum: " << std::dec << NES::getFrameNum() << " CRC: 0x" << std::hex << crc << std::endl;
+    if(shownFrame == nullptr) return;
+    unsigned int crc = crc32(0L, shownFrame->pixels.data(), shownFrame->pixels.size());
+    std::cout << "FrameNum: " << std::dec << shownFrame->number << " CRC: 0x" << std::hex << crc << std::endl;
 }
 
 
@@ -535,7 +547,7 @@ void close()
 {
     delete &mainDisplay;
     //SDL_DestroyWindow(PPUwindow);
-    SDL_CloseAudioDevice(1);
+    SDL_CloseAudioDevice(audioDevice);
     SDL_Quit();
     return;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
 namespace GUI {
 
@@ -17,8 +18,10 @@ const int SCREEN_SCALE = 2;
 
 const int AUDIO_SAMPLE_RATE = 48000;
 const int AUDIO_BUFFER_SIZE = 1024;
+const int AUDIO_RESAMPLER_TAPS = 32;
 const int AUDIO_CHANNELS = 1;
 const int WANTED_AUDIO_LATENCY_MS = 200;
+const int AUDIO_RING_SIZE = 16384;    //Power of two, more than the latency above
 
 extern float avgFPS;
 
@@ -32,9 +35,10 @@ void update();
 void updateMainWindow();
 void updatePPUWindow();
 void updateAudio();
+void queueAudio(const int16_t *samples, size_t count);
+size_t queuedAudio();   //Samples waiting for the audio device
 void fill_audio_buffer(void *user_data, uint8_t *out, int byte_count);
 void close();
-void downsample(int16_t *output, float *input, int &size);
 
 void _drawmainMenuBar();
 void onOpenFile();
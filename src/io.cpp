@@ -1,29 +1,22 @@
 #include "io.h"
-#include "nes.h"
-#include "cpu.h"
+#include "console.h"
 #include <array>
 
-namespace IO
+void IO::init()
 {
-
-std::array<uint8_t, 2> controller_shiftR;
-bool controllerStrobe;
-
-void init()
-{
-    NES::controller_state[0] = 0;
-    NES::controller_state[1] = 0;
+    console.controller_state[0] = 0;
+    console.controller_state[1] = 0;
     controller_shiftR[0] = 0;
     controller_shiftR[1] = 0;
     controllerStrobe = false;
 }
 
-uint8_t regGet(uint16_t addr, bool peek)
+uint8_t IO::regGet(uint16_t addr, bool peek)
 {
     uint8_t val = 0;
     if(addr == 0x4016) {
         if(controllerStrobe) {
-            val = NES::controller_state[0] & 1;
+            val = console.controller_state[0] & 1;
         }
         else {
             val = controller_shiftR[0] & 1;
@@ -32,7 +25,7 @@ uint8_t regGet(uint16_t addr, bool peek)
     }
     else if(addr == 0x4017) {
         if(controllerStrobe) {
-            val = NES::controller_state[1] & 1;
+            val = console.controller_state[1] & 1;
         }
         else {
             val = controller_shiftR[1] & 1;
@@ -40,23 +33,21 @@ uint8_t regGet(uint16_t addr, bool peek)
         }
     }
     else {
-        return CPU::busVal;
+        return console.cpu.busVal;
     }
-    return (CPU::busVal & 0xE0) | val;
+    return (console.cpu.busVal & 0xE0) | val;
 }
 
-void regSet(uint16_t addr, uint8_t val)
+void IO::regSet(uint16_t addr, uint8_t val)
 {
     if(addr == 0x4016) {
         if((val & 1) > 0) {
             controllerStrobe = true;
         }
         else {
-            controller_shiftR[0] = NES::controller_state[0];
-            controller_shiftR[1] = NES::controller_state[1];
+            controller_shiftR[0] = console.controller_state[0];
+            controller_shiftR[1] = console.controller_state[1];
             controllerStrobe = false;
         }
     }
 }
-
-} // IO
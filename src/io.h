@@ -3,11 +3,20 @@
 #include <stdint.h>
 #include <array>
 
-namespace IO
+class Console;
+
+class IO
 {
+	public:
+	explicit IO(Console &console) : console(console) {}
+
+	void init();
+	uint8_t regGet(uint16_t addr, bool peek = false);
+	void regSet(uint16_t addr, uint8_t val);
 
-void init();
-uint8_t regGet(uint16_t addr, bool peek = false);
-void regSet(uint16_t addr, uint8_t val);
+	private:
+	Console &console;
 
-}
+	std::array<uint8_t, 2> controller_shiftR;
+	bool controllerStrobe;
+};
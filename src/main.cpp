@@ -10,6 +10,7 @@ int main(int argc, char *argv[])
 		("f,file", "File name", cxxopts::value<std::string>())
 		("PC", "Start program at specific memory address", cxxopts::value<uint16_t>())
 		("log", "enable logging", cxxopts::value<bool>()->default_value("false"))
+		("profile", "write guest code profile on exit (needs a CPU_PROFILER build)", cxxopts::value<bool>()->default_value("false"))
 		("disableAudio", "Disables audio, unthrottling emulator", cxxopts::value<bool>()->default_value("false"))
 		("h,help", "Print usage")
 		;
@@ -27,6 +28,7 @@ int main(int argc, char *argv[])
 		startOptions.debugPC = vm["PC"].as<uint16_t>();
 	}
 	if(vm.count("log")) startOptions.log = true;
+	if(vm.count("profile")) startOptions.profile = true;
 	if(vm.count("disableAudio")) startOptions.disableAudio = true;
 
 	//Start program
@@ -1,115 +1,120 @@
 #include "nes.h"
-#include "apu.h"
-#include "cpu.h"
-#include "gamepak.h"
-#include "ppu.h"
+#include "console.h"
+#include "trace.h"
+#include "profiler.h"
 #include <iostream>
-#include <fstream>
 #include <array>
 
 
 namespace NES {
 
-//Audio
-AudioBuffer rawAudio;
-std::array<uint8_t, 2> controller_state;
+Console &console()
+{
+    static Console defaultConsole;
+    return defaultConsole;
+}
+
+std::array<uint8_t, 2> &controller_state = console().controller_state;
+bool &running = console().running;
+bool &romLoaded = console().romLoaded;
 
 //Options
 bool logging = false;
-bool PC_debug_start_flag = false;
-uint16_t PC_debug_start = 0;
-
-std::ofstream logFile;
-
-bool running = false;
-bool romLoaded = false;
 
 void enableLogging()
 {
-    logging = true;
-	logFile.open("log.txt",std::ios::trunc);
+    //Binary trace, render it with the tracefmt tool
+    logging = TRACE::open("log.bin");
+    console().cpu.setTracing(logging);
 }
 
-int loadROM(std::string filename)
+void disableLogging()
 {
-    romLoaded = false;
-    std::ifstream file(filename, std::ios::binary);
-    if(file.fail()) {
-        std::cerr << "Unable to open file" << std::endl;
-        return 1;
+    console().cpu.setTracing(false);
+    TRACE::close();
+    logging = false;
+}
+
+void writeProfile(std::string basename)
+{
+    if(!PROFILER::enabled) {
+        std::cerr << "Profiling needs a build with CPU_PROFILER enabled" << std::endl;
+        return;
     }
-    if(GAMEPAK::loadROM(file) > 0) {
-		return 1;
-	}
-	file.close();
-    romLoaded = true;
-    return 0;
+    PROFILER::writeCSV(basename + ".csv");
+    PROFILER::writeOpcodeCSV(basename + "_opcodes.csv");
+    PROFILER::writeCollapsed(basename + ".folded");
 }
 
-void powerOn()
+int loadROM(std::string filename, std::string entry)
 {
-    GAMEPAK::powerOn();
-    CPU::powerOn();
-	PPU::powerOn();
-	APU::powerOn();
+    return console().loadROM(filename, entry);
+}
 
-	if(PC_debug_start_flag) {
-		CPU::setPC(PC_debug_start);
-	}
+int loadROM(const uint8_t *data, size_t size)
+{
+    return console().loadROM(data, size);
+}
 
-    running = true;
+void powerOn()
+{
+    console().powerOn();
 }
 
 void reset()
 {
-    GAMEPAK::reset();
-    CPU::reset();
-    PPU::reset();
-    APU::reset();
+    console().reset();
 }
 
 void pause(bool enable)
 {
-    running = !enable;
+    console().pause(enable);
 }
 
 void frameStep(bool force)
 {
-    if(running || force) {
-        while(PPU::isframeReady() == 0) {
-            CPU::step();
-        }
-        PPU::setframeReady(false);
-    }
+    console().frameStep(force);
 }
 
 void setDebugPC(bool enable, uint16_t debugPC)
 {
-    if(enable) {
-        PC_debug_start_flag = true;
-        PC_debug_start = debugPC;
-    }
-    else
-        PC_debug_start_flag = false;
-    
+    console().setDebugPC(enable, debugPC);
 }
 
 unsigned long getFrameNum()
 {
-    return PPU::frame;
+    return console().getFrameNum();
+}
+
+void setAudioSampleRate(int rate)
+{
+    console().setAudioSampleRate(rate);
+}
+
+int readAudio(int16_t *out, int count)
+{
+    return console().readAudio(out, count);
 }
 
 uint8_t getPalette(uint16_t addr) {
-    return PPU::getPalette(addr);
+    return console().getPalette(addr);
 }
 
 uint8_t* getPixelMap() {
-    return PPU::pixelMap.data();
+    return console().getPixelMap();
+}
+
+uint8_t getEmphasis() {
+    return console().getEmphasis();
+}
+
+void setOutputBuffer(uint32_t *buffer, const std::array<uint32_t, 512> &palette) {
+    console().setOutputBuffer(buffer, palette);
 }
 
 std::array<std::array<uint8_t, 16*16*64>, 2> getPatternTableBuffers() {
-    return PPU::getPatternTableBuffers();
+    return console().getPatternTableBuffers();
 }
 
 
-} //NES
\ No newline at end of file
+} //NES
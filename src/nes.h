@@ -1,13 +1,18 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
 #include <string>
 #include <array>
 
+class Console;
+
+//Drives one default Console, for callers that only ever run a single game
+//Create Console objects directly to run more than one
 namespace NES {
 
 const int CPU_CLOCK_RATE = 1789773;
 const int APU_CLOCK_RATE = CPU_CLOCK_RATE;
-const int APU_AUDIO_BUFFER_SIZE = APU_CLOCK_RATE / 30; //Roughly two frames of audio
 
 enum Options
 {
@@ -15,23 +20,20 @@ enum Options
     SET_PC_START    = 1 << 1,
 };
 
-struct AudioBuffer {
-    std::array<float, APU_AUDIO_BUFFER_SIZE> buffer;
-    int writeIdx;
-    int readIdx;
-};
-
-extern AudioBuffer rawAudio;
-extern std::array<uint8_t, 2> controller_state;
+Console &console();	//The default console
 
-extern bool running, romLoaded;
+//The default console's
+extern std::array<uint8_t, 2> &controller_state;
+extern bool &running, &romLoaded;
 
 extern bool logging;
-extern uint16_t PC_debug_start;
-extern std::ofstream logFile;
 
 void enableLogging();
-int loadROM(std::string filename);
+void disableLogging();
+void writeProfile(std::string basename);
+//Filename can be a .nes, .gz or .zip file or a directory, see ROMLOADER::load
+int loadROM(std::string filename, std::string entry = "");
+int loadROM(const uint8_t *data, size_t size);
 void powerOn();
 void reset();
 void pause(bool enable);
@@ -42,6 +44,10 @@ void setDebugPC(bool enable, uint16_t debugPC = 0);
 unsigned long getFrameNum();
 uint8_t getPalette(uint16_t addr);
 uint8_t* getPixelMap();
+uint8_t getEmphasis();
+void setAudioSampleRate(int rate);
+int readAudio(int16_t *out, int count);
+void setOutputBuffer(uint32_t *buffer, const std::array<uint32_t, 512> &palette);
 std::array<std::array<uint8_t, 16*16*64>, 2> getPatternTableBuffers();
 
 } //NES
\ No newline at end of file
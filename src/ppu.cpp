@@ -1,88 +1,20 @@
 #include "ppu.h"
-#include "gamepak.h"
-#include "cpu.h"
+#include "console.h"
 #include "utils.h"
 #include <iostream>
 #include <cstring>
 #include <array>
-
-namespace PPU {
-
-unsigned int scanline, dot; //Dots are also called cycles and can be considered the pixel column
-unsigned long frame;
-unsigned long long ppuClock;
-std::array<uint8_t, 240*256> pixelMap = {0};
-bool frameReady;
-
-
-////////////////////////////////////////////////////
-/////Internal registers, memory, and flags//////////
-////////////////////////////////////////////////////
-
-struct VRAM {
-	union {
-		uint16_t value;
-		BitWorker<0, 5, uint16_t> coarseX;
-		BitWorker<5, 5, uint16_t> coarseY;
-		BitWorker<10, 2, uint16_t> NTsel;
-		BitWorker<12, 3, uint16_t> fineY;
-		BitWorker<8, 6, uint16_t> addrWrite1;
-		BitWorker<14, 1, uint16_t> bit14;
-		BitWorker<0, 8, uint16_t> addrWrite2;
-		BitWorker<10, 1, uint16_t> bit10;
-		BitWorker<11, 4, uint16_t> upperY;
-	};
-}  currVRAM_addr, tempVRAM_addr;
-
-//uint16_t currVRAM_addr, tempVRAM_addr; //v and t in nesdev wiki
-uint8_t fineXscroll;	//x in nesdev wiki
-bool writeToggle;		//w in nesdev wiki
-uint16_t BGtiledata_upper, BGtiledata_lower;
-uint8_t BGattri_upper, BGattri_lower;
-uint16_t busAddress;
-
-//Background latches and shift registers
-uint8_t NTlatch, ATlatch, BGLlatch, BGHlatch;
-uint16_t ATshiftL, ATshiftH;
-uint16_t BGshiftL, BGshiftH;
-uint16_t sprAddr;
-
-//Sprite memory, latches, shift registers, and counters
-std::array<uint8_t, 256> oam_data;
-std::array<uint8_t, 32> oam_sec; 
-std::array<uint8_t, 8> sprite_shiftL;
-std::array<uint8_t, 8> sprite_shiftH;
-std::array<uint8_t, 8> spriteL;
-std::array<uint8_t, 8> spriteCounter;
-bool spr0onNextLine, spr0onLine;
-
-uint8_t VRAM_buffer;
-std::array<uint8_t, 32> paletteRAM; //Internal palette control RAM. Can't be mapped
-
-//PPU data bus - used for open bus behavior
-uint8_t ioBus;
-
-//PPUCTRL flags
-//nametable select modifies part of tempVRAM_addr
-bool NMIenable, spriteSize, backgroundTileSel, spriteTileSel, incrementMode;
-
-//PPUMASK
-bool greyscale, showleftBG, showleftSpr, showBG, showSpr, emphRed, emphGrn, emphBlu;
-bool rendering;
-
-//PPUSTATUS
-bool sprOverflow, spr0hit, vblank;
-unsigned long long PPUSTATUS_read_on_cycle = 0;
-
-//OAMADDR
-uint8_t OAMaddr;
-
+#include <vector>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 ////////////////////////////////////////////////////
 /////////////////// Functions //////////////////////
 ////////////////////////////////////////////////////
 
-void powerOn()
+void PPU::powerOn()
 {
 	scanline = 0; //To be consistant with mesen for log comparison
 	dot = 30;
@@ -90,6 +22,8 @@ void powerOn()
 	ppuClock = 0;
 	frameReady = false;
 	sprOverflow = spr0hit = vblank = writeToggle = false;
+	overflowLinesValid = false;
+	tileCache.clear();
 
 	regSet(0x2000,0);
 	regSet(0x2001,0);
@@ -101,7 +35,7 @@ void powerOn()
 
 }
 
-void reset() {
+void PPU::reset() {
 	//Per https://wiki.nesdev.com/w/index.php/PPU_power_up_state
 	regSet(0x2000,0);
 	regSet(0x2001,0);
@@ -111,7 +45,7 @@ void reset() {
 	frame = 0;
 }
 
-void step()
+void PPU::step()
 {
 	++dot;
 	if(dot >= 341) {
@@ -132,7 +66,7 @@ void step()
 		if(PPUSTATUS_read_on_cycle < ppuClock - 1) {
 			vblank = true;
 			if(NMIenable)
-				CPU::setNMI(true);
+				console.cpu.setNMI(true);
 		}
 	}
 	/*if(scanline == 241 && dot == 1) {
@@ -143,19 +77,19 @@ void step()
 		else {
 			vblank = true;
 			if(NMIenable)
-				CPU::setNMI(true);
+				console.cpu.setNMI(true);
 		}
 	}*/
 	/*else if(scanline == 241 && dot == 2 ) {
 		//If PPUSTATUS read on same clock cycle or one later than vblank, unset flags
 		if(PPUSTATUS_read_on_cycle >= (ppuClock - 1)) {
 			vblank = false;
-			CPU::setNMI(false);
+			console.cpu.setNMI(false);
 		}
 	}*/
 	else if(scanline == 261 && dot == 1) {
 		vblank = spr0hit = sprOverflow = false;
-		CPU::setNMI(false);
+		console.cpu.setNMI(false);
 	}
 
 	if(scanline <= 239 || scanline == 261) {
@@ -166,7 +100,131 @@ void step()
 	if(scanline == 240 && dot == 0) frameReady = true;
 }
 
-uint8_t regGet(uint16_t addr, bool peek)
+void PPU::run(unsigned int dots)
+{
+	//Catch up a number of dots in one go
+	//Post-render and vblank lines only raise vblank at 241,1, so the rest of them are skipped over
+	//Visible lines with rendering off only draw the backdrop color, so they're filled a run at a time
+	//Visible lines with rendering on draw dots 1 to 256 a line at a time, unless the mapper watches the fetches
+	while(dots > 0) {
+		unsigned int pos = scanline*341 + dot;
+		unsigned int next = pos + 1;
+		unsigned int last;	//Last dot of the run we can take in one go
+		if(next > 240*341 && next < 261*341 && next != 241*341 + 1) {
+			last = (next <= 241*341) ? 241*341 : 261*341 - 1;
+		}
+		else if(rendering && scanline < 240 && dot == 0 && dots >= 256 && !console.gamepak.watchesPPUfetches()) {
+			renderScanline();
+			dot = 256;
+			ppuClock += 256;
+			dots -= 256;
+			continue;
+		}
+		else if(rendering == false && scanline < 240 && dot < 340) {
+			last = scanline*341 + 340;
+		}
+		else {
+			step();
+			--dots;
+			continue;
+		}
+
+		unsigned int count = std::min(dots, last - pos);
+		if(scanline < 240) {
+			//Same as renderPixel() with rendering off, for dots dot+1 to dot+count
+			unsigned int first = dot + 1;
+			unsigned int end = dot + count;
+			if(first <= 256) {
+				std::fill(pixelMap.begin() + scanline*256 + first - 1, pixelMap.begin() + scanline*256 + std::min(end, 256u), getPalette(0x3F00));
+				outputPixels(scanline*256 + first - 1, std::min(end, 256u) - first + 1);
+			}
+			unsigned int shifts = 0;
+			if(first <= 256) shifts += std::min(end, 256u) - first + 1;
+			if(end >= 321 && first <= 336) shifts += std::min(end, 336u) - std::max(first, 321u) + 1;
+			if(shifts >= 16) {
+				BGshiftL = BGshiftH = ATshiftL = ATshiftH = 0;
+			}
+			else {
+				BGshiftL <<= shifts;
+				BGshiftH <<= shifts;
+				ATshiftL <<= shifts;
+				ATshiftH <<= shifts;
+			}
+		}
+		pos += count;
+		scanline = pos / 341;
+		dot = pos % 341;
+		ppuClock += count;
+		dots -= count;
+	}
+}
+
+unsigned int PPU::dotsToNextEvent()
+{
+	//Dots until the PPU next changes state the CPU can see without a register read:
+	//vblank NMI at 241,1, NMI clear at 261,1 and frame ready at 240,0
+	//While rendering, also the dots where sprite 0 hit or sprite overflow could be set, so PPUSTATUS
+	//only changes on an event (see CPU::isIdleLoop)
+	//The odd frame skipped dot is always assumed, so this may come up one dot early
+	const unsigned int frameDots = 262*341;
+	const unsigned int skippedDot = 261*341 + 339;
+	const unsigned int events[] = {241*341 + 1, 261*341 + 1, 240*341 + 0};
+	unsigned int pos = scanline*341 + dot;
+	unsigned int toSkip = (skippedDot + frameDots - pos) % frameDots;
+	unsigned int nearest = frameDots;
+	for(unsigned int event : events) {
+		unsigned int dist = (event + frameDots - pos) % frameDots;
+		if(dist == 0) dist = frameDots;
+		if(toSkip > 0 && toSkip < dist) --dist;
+		if(dist < nearest) nearest = dist;
+	}
+	//Both come before the skipped dot, and the ones after 261,1 are never nearer than it
+	if(rendering && showBG && showSpr && !spr0hit)
+		nearest = std::min(nearest, dotsToSprite0Hit(pos));
+	if(rendering && !sprOverflow)
+		nearest = std::min(nearest, dotsToOverflowCheck(pos));
+	return nearest;
+}
+
+unsigned int PPU::dotsToSprite0Hit(unsigned int pos)
+{
+	//Sprite 0 is drawn on the lines after the ones it's in range of, at dots X+1 to X+8
+	//Those dots are each an event, as any of them can hit
+	unsigned int height = spriteSize ? 16 : 8;
+	unsigned int firstLine = oam_data[0] + 1;
+	unsigned int lastLine = std::min(oam_data[0] + height, 239u);
+	unsigned int firstDot = oam_data[3] + 1;
+	unsigned int lastDot = std::min(oam_data[3] + 8u, 255u);
+	for(unsigned int line = std::max(firstLine, scanline); line <= lastLine; ++line) {
+		if(pos + 1 < line*341 + firstDot) return line*341 + firstDot - pos;
+		if(pos < line*341 + lastDot) return 1;
+	}
+	return 262*341;
+}
+
+unsigned int PPU::dotsToOverflowCheck(unsigned int pos)
+{
+	//Sprite overflow is only set by the evaluation at dot 65 of a line with 8 or more sprites in range
+	if(!overflowLinesValid) {
+		std::array<uint8_t, 262> inRange = {};
+		unsigned int height = spriteSize ? 16 : 8;
+		for(unsigned int n = 0; n < 64; ++n) {
+			for(unsigned int line = oam_data[n*4]; line < oam_data[n*4] + height && line < 262; ++line)
+				++inRange[line];
+		}
+		nextOverflowLine[262] = 262;
+		for(int line = 261; line >= 0; --line) {
+			bool evaluated = line < 240 || line == 261;
+			nextOverflowLine[line] = (evaluated && inRange[line] >= 8) ? line : nextOverflowLine[line + 1];
+		}
+		overflowLinesValid = true;
+	}
+	unsigned int line = nextOverflowLine[(dot < 65) ? scanline : scanline + 1];
+	if(line == 262) return 262*341;
+	return line*341 + 65 - pos;
+}
+
+uint8_t PPU::regGet(uint16_t addr, bool peek)
 {
 	addr = 0x2000 + (addr % 8);
 	switch(addr) {
@@ -185,9 +243,9 @@ uint8_t regGet(uint16_t addr, bool peek)
 				PPUSTATUS_read_on_cycle = ppuClock;
 				vblank = 0;
 				if(scanline == 241 && (dot == 1 || dot == 2))
-					CPU::forceNMI(false);
+					console.cpu.forceNMI(false);
 				else
-					CPU::setNMI(false);
+					console.cpu.setNMI(false);
 				writeToggle = 0;
 				ioBus = (ioBus & 0x1F) | status;
 				return ioBus;
@@ -227,11 +285,11 @@ uint8_t regGet(uint16_t addr, bool peek)
 			//Can directly access palette since never mapped
 			if((currVRAM_addr.value % 0x4000) >= 0x3F00) {	//Palette read
 				data = getPalette(currVRAM_addr.value % 0x20);
-				if(peek == false) VRAM_buffer = GAMEPAK::PPUmemGet(currVRAM_addr.value - 0x1000);
+				if(peek == false) VRAM_buffer = console.gamepak.PPUmemGet(currVRAM_addr.value - 0x1000);
 			}
 			else {
 				data = VRAM_buffer;
-				if(peek == false) VRAM_buffer = GAMEPAK::PPUmemGet(currVRAM_addr.value);
+				if(peek == false) VRAM_buffer = console.gamepak.PPUmemGet(currVRAM_addr.value);
 			}
 			if(peek == false) {
 				if(incrementMode == 0) ++currVRAM_addr.value;
@@ -252,7 +310,7 @@ uint8_t regGet(uint16_t addr, bool peek)
 	}
 }
 
-void regSet(uint16_t addr, uint8_t val)
+void PPU::regSet(uint16_t addr, uint8_t val)
 {
 	addr = 0x2000 + (addr % 8);
 	ioBus = val; //Set I/O bus to value
@@ -261,13 +319,14 @@ void regSet(uint16_t addr, uint8_t val)
 			if(NMIenable == false && (val >> 7) > 0) {
 				NMIenable = true;
 				if(vblank)
-					CPU::setNMI(true);
+					console.cpu.setNMI(true);
 			}
 			else
 				NMIenable = (val >> 7) > 0;
 			if(NMIenable == false || vblank == false)
-				CPU::setNMI(false);
+				console.cpu.setNMI(false);
 			spriteSize = (val & 0x20) > 0;
+			overflowLinesValid = false;
 			backgroundTileSel = (val & 0x10) > 0;
 			spriteTileSel = (val & 0x08) > 0;
 			incrementMode = (val & 0x04) > 0;
@@ -283,6 +342,7 @@ void regSet(uint16_t addr, uint8_t val)
 			emphRed = (val & 0x20) > 0;
 			emphGrn = (val & 0x40) > 0;
 			emphBlu = (val >> 7) > 0;
+			emphasis = (val & 0xE0) << 1;
 			rendering = showBG | showSpr;
 			break;
 		case 0x2002: //PPUSTATUS
@@ -296,6 +356,7 @@ void regSet(uint16_t addr, uint8_t val)
 			//Only write while not rendering
 			if(rendering == false || ((scanline >= 240) && (scanline != 261))) {
 				oam_data[OAMaddr] = val;
+				overflowLinesValid = false;
 				++OAMaddr;
 			}
 			break;
@@ -333,7 +394,7 @@ void regSet(uint16_t addr, uint8_t val)
 			break;
 
 		case 0x2007: //PPUDATA
-			GAMEPAK::PPUmemSet(currVRAM_addr.value, val);
+			console.gamepak.PPUmemSet(currVRAM_addr.value, val);
 			if(rendering && (scanline == 261 || scanline < 240)) {
 				//Special behavior during rendering
 				incrementHorz();
@@ -351,7 +412,7 @@ void regSet(uint16_t addr, uint8_t val)
 	}
 }
 
-uint8_t getPalette(uint16_t addr)
+uint8_t PPU::getPalette(uint16_t addr)
 {
 	addr %= 0x20;
 	switch(addr) {
@@ -376,7 +437,7 @@ uint8_t getPalette(uint16_t addr)
 	}
 }
 
-void setPalette(uint16_t addr, uint8_t val)
+void PPU::setPalette(uint16_t addr, uint8_t val)
 {
 	addr %= 0x20;
 	switch(addr) {
@@ -396,7 +457,7 @@ void setPalette(uint16_t addr, uint8_t val)
 	paletteRAM[addr] = val;
 }
 
-void renderFrameStep()
+void PPU::renderFrameStep()
 {
 	spriteEval();
 	//Perform action based on current dot
@@ -407,31 +468,23 @@ void renderFrameStep()
 		case 1 ... 256: case 321 ... 336:
 			switch(dot % 8) {
 				case 1:
-					NTlatch = GAMEPAK::PPUmemGet(0x2000 + (currVRAM_addr.value & 0x0FFF));
+					fetchNT();
 					break;
 				case 3:
-					ATlatch = GAMEPAK::PPUmemGet( 0x23C0 + (currVRAM_addr.NTsel << 10) + ((currVRAM_addr.coarseX) / 4) + (((currVRAM_addr.coarseY) / 4) << 3));
-					if((currVRAM_addr.coarseY % 4) >= 2) ATlatch >>= 4;
-					if((currVRAM_addr.coarseX % 4) >= 2) ATlatch >>= 2;
-					ATlatch &= 0x3;
+					fetchAT();
 					break;
 				case 5:
-					BGLlatch = GAMEPAK::PPUmemGet((NTlatch << 4) + currVRAM_addr.fineY + (backgroundTileSel ? 0x1000 : 0));
+					fetchBGlow();
 					break;
 				case 7:
-					BGHlatch = GAMEPAK::PPUmemGet((NTlatch << 4) + currVRAM_addr.fineY + (backgroundTileSel ? 0x1000 : 0) + 8);
+					fetchBGhigh();
 					break;
 				case 0:					
 					if(dot != 256)
 						incrementHorz();
 					else
 						incrementVert();
-					//Load latches into shift registers every 8 cycles
-					//Treating AT shift registers as 16 bit makes things easier
-					BGshiftL = (BGshiftL & 0xFF00) | BGLlatch;
-					BGshiftH = (BGshiftH & 0xFF00) | BGHlatch;
-					ATshiftL = (ATshiftL & 0xFF00) | (((ATlatch & 1) > 0) ? 0xFF : 0);
-					ATshiftH = (ATshiftH & 0xFF00) | (((ATlatch & 2) > 0) ? 0xFF : 0);
+					loadShiftRegisters();
 					break;
 			}
 			break;
@@ -451,12 +504,78 @@ void renderFrameStep()
 			break;
 		case 337: case 339:
 			//Fetch unused NT byte
-			GAMEPAK::PPUmemGet(0x2000 + (currVRAM_addr.value & 0x0FFF));
+			console.gamepak.PPUfetch(0x2000 + (currVRAM_addr.value & 0x0FFF));
 			break;
 	}
 }
 
-void spriteEval()
+void PPU::fetchNT()
+{
+	NTlatch = console.gamepak.PPUfetch(0x2000 + (currVRAM_addr.value & 0x0FFF));
+}
+
+void PPU::fetchAT()
+{
+	ATlatch = console.gamepak.PPUfetch( 0x23C0 + (currVRAM_addr.NTsel << 10) + ((currVRAM_addr.coarseX) / 4) + (((currVRAM_addr.coarseY) / 4) << 3));
+	if((currVRAM_addr.coarseY % 4) >= 2) ATlatch >>= 4;
+	if((currVRAM_addr.coarseX % 4) >= 2) ATlatch >>= 2;
+	ATlatch &= 0x3;
+}
+
+uint16_t PPU::BGpatternAddr()
+{
+	return (NTlatch << 4) + currVRAM_addr.fineY + (backgroundTileSel ? 0x1000 : 0);
+}
+
+void PPU::fetchBGlow()
+{
+	BGLlatch = console.gamepak.PPUfetch(BGpatternAddr());
+}
+
+void PPU::fetchBGhigh()
+{
+	BGHlatch = console.gamepak.PPUfetch(BGpatternAddr() + 8);
+}
+
+std::array<uint8_t, 8> PPU::tileRow(uint16_t addr)
+{
+	//Decoded row of the tile at pattern table address addr (low bitplane)
+	unsigned int bank = console.gamepak.CHRbank(addr);
+	if(bank >= tileCache.size())
+		tileCache.resize(bank + 1);
+	TileBank &cache = tileCache[bank];
+	unsigned int tile = (addr >> 4) & 0x3F;
+	if(!cache.decoded[tile]) {
+		uint16_t tileAddr = addr & 0x1FF0;
+		for(int y = 0; y < 8; ++y) {
+			uint8_t low = console.gamepak.PPUmemGet(tileAddr + y, true);
+			uint8_t high = console.gamepak.PPUmemGet(tileAddr + y + 8, true);
+			for(int x = 0; x < 8; ++x)
+				cache.rows[tile*8 + y][x] = ((low >> (7-x)) & 1) | (((high >> (7-x)) & 1) << 1);
+		}
+		cache.decoded[tile] = true;
+	}
+	return cache.rows[tile*8 + (addr & 7)];
+}
+
+void PPU::CHRwritten(uint16_t addr)
+{
+	unsigned int bank = console.gamepak.CHRbank(addr);
+	if(bank < tileCache.size())
+		tileCache[bank].decoded[(addr >> 4) & 0x3F] = false;
+}
+
+void PPU::loadShiftRegisters()
+{
+	//Load latches into shift registers every 8 cycles
+	//Treating AT shift registers as 16 bit makes things easier
+	BGshiftL = (BGshiftL & 0xFF00) | BGLlatch;
+	BGshiftH = (BGshiftH & 0xFF00) | BGHlatch;
+	ATshiftL = (ATshiftL & 0xFF00) | (((ATlatch & 1) > 0) ? 0xFF : 0);
+	ATshiftH = (ATshiftH & 0xFF00) | (((ATlatch & 2) > 0) ? 0xFF : 0);
+}
+
+void PPU::spriteEval()
 {
 	if(scanline == 261) {
 		//Clear latches (not sure what the real NES does)
@@ -471,39 +590,7 @@ void spriteEval()
 			oam_sec.fill(0xFF);
 			break;
 		case 65:
-			{
-			//Sprite eval
-			int oam_sec_idx = 0;
-			int n, m;
-			spr0onNextLine = false;
-			for(n=0; n<64; ++n) {
-				if(oam_sec_idx >= 32) break;
-				oam_sec[oam_sec_idx] = oam_data[n*4]; //Y coord always copied
-				unsigned int yMax = oam_sec[oam_sec_idx] + 8;
-				if(spriteSize) yMax += 8;
-				if(scanline >= oam_sec[oam_sec_idx] && scanline < yMax) {
-					if(n == 0) spr0onNextLine = true;
-					for(m=0; m<4; ++m)
-						oam_sec[oam_sec_idx+m] = oam_data[n*4+m];
-					oam_sec_idx += 4;
-				}
-			}
-			//Simulates buggy overflow behavior
-			m = 0;
-			while(n < 64) {
-				unsigned int yCoord = oam_data[n*4+m];
-				unsigned int yMax = yCoord + 8;
-				if(spriteSize) yMax += 8;
-				if(scanline >= yCoord && scanline < yMax) {
-					sprOverflow = true;
-					break;
-					//NES would eval all OAM sprites, but we'll stop here
-				}
-				++n;
-				++m;
-				if(m >= 4) m = 0;
-			}
-			}
+			evaluateSprites();
 			break;
 		case 257 ... 320:
 			//Fetch sprite data
@@ -542,14 +629,14 @@ void spriteEval()
 			}
 			else if((dot - 257) % 8 == 4) { //Sprite tile low fetch
 				int sprNum = (dot - 257) / 8;
-				sprite_shiftL[sprNum] = GAMEPAK::PPUmemGet(sprAddr);
+				sprite_shiftL[sprNum] = console.gamepak.PPUfetch(sprAddr);
 				//If y-axis out of range, set sprite transparent
 				if(oam_sec[sprNum*4] >= 239)
 					sprite_shiftL[sprNum] = 0;
 			}
 			else if((dot - 257) % 8 == 6) { //Sprite tile high fetch
 				int sprNum = (dot - 257) / 8;
-				sprite_shiftH[sprNum] = GAMEPAK::PPUmemGet(sprAddr + 8);
+				sprite_shiftH[sprNum] = console.gamepak.PPUfetch(sprAddr + 8);
 				//If y-axis out of range, set sprite transparent
 				if(oam_sec[sprNum*4] >= 239)
 					sprite_shiftH[sprNum] = 0;
@@ -558,7 +645,190 @@ void spriteEval()
 	}
 }
 
-void renderPixel()
+void PPU::evaluateSprites()
+{
+	//Fill secondary OAM with the sprites on the next line
+	int oam_sec_idx = 0;
+	int n, m;
+	spr0onNextLine = false;
+	for(n=0; n<64; ++n) {
+		if(oam_sec_idx >= 32) break;
+		oam_sec[oam_sec_idx] = oam_data[n*4]; //Y coord always copied
+		unsigned int yMax = oam_sec[oam_sec_idx] + 8;
+		if(spriteSize) yMax += 8;
+		if(scanline >= oam_sec[oam_sec_idx] && scanline < yMax) {
+			if(n == 0) spr0onNextLine = true;
+			for(m=0; m<4; ++m)
+				oam_sec[oam_sec_idx+m] = oam_data[n*4+m];
+			oam_sec_idx += 4;
+		}
+	}
+	//Simulates buggy overflow behavior
+	m = 0;
+	while(n < 64) {
+		unsigned int yCoord = oam_data[n*4+m];
+		unsigned int yMax = yCoord + 8;
+		if(spriteSize) yMax += 8;
+		if(scanline >= yCoord && scanline < yMax) {
+			sprOverflow = true;
+			break;
+			//NES would eval all OAM sprites, but we'll stop here
+		}
+		++n;
+		++m;
+		if(m >= 4) m = 0;
+	}
+}
+
+void PPU::renderScanline()
+{
+	//Dots 1 to 256 of a visible line with rendering on, in one go
+	//Background pixels come from a line of 34 tiles: the two already in the shift registers,
+	//then the 32 fetched during the line, of which the last is only loaded for the next line.
+	//Sprites loaded on the previous line are drawn into a line buffer, and both are composited.
+	//Same result as stepping the dots, as the CPU is never in the middle of the run and nothing
+	//but the PPU sees the fetches (see GAMEPAK::watchesPPUfetches)
+
+	//Background, one palette index (attribute << 2 | color) per pixel
+	std::array<uint8_t, 16 + 32*8> BGline;
+	for(int i = 0; i < 16; ++i) {
+		int bit = 15 - i;
+		BGline[i] = ((BGshiftL >> bit) & 1) | (((BGshiftH >> bit) & 1) << 1)
+			| (((ATshiftL >> bit) & 1) << 2) | (((ATshiftH >> bit) & 1) << 3);
+	}
+	uint16_t prevL = 0, prevH = 0;
+	for(int tile = 0; tile < 32; ++tile) {
+		fetchNT();
+		fetchAT();
+		std::array<uint8_t, 8> row = tileRow(BGpatternAddr());
+		uint8_t *pixels = &BGline[16 + tile*8];
+		for(int i = 0; i < 8; ++i)
+			pixels[i] = row[i] | (ATlatch << 2);
+		if(tile >= 30) {
+			//The last two tiles are left in the shift registers for the next line, which need the raw bitplanes
+			prevL = BGLlatch;
+			prevH = BGHlatch;
+			fetchBGlow();
+			fetchBGhigh();
+		}
+		if(tile != 31)
+			incrementHorz();
+		else
+			incrementVert();
+	}
+	//Shift registers end with the last two tiles, as after dot 256
+	uint8_t prevAT = BGline[16 + 30*8] >> 2;
+	BGshiftL = (prevL << 8) | BGLlatch;
+	BGshiftH = (prevH << 8) | BGHlatch;
+	ATshiftL = (((prevAT & 1) > 0) ? 0xFF00 : 0) | (((ATlatch & 1) > 0) ? 0xFF : 0);
+	ATshiftH = (((prevAT & 2) > 0) ? 0xFF00 : 0) | (((ATlatch & 2) > 0) ? 0xFF : 0);
+
+	//Sprites, color | 0x10 if in front of the background | 0x20 if from sprite 0
+	std::array<uint8_t, 256> SPRline;
+	SPRline.fill(0);
+	if(showSpr) {
+		for(int i = 0; i < 8; ++i) {
+			unsigned int x = spriteCounter[i];
+			bool flipped = (spriteL[i] & 0x40) > 0;
+			for(unsigned int col = 0; col < 8 && x + col < 256; ++col) {
+				unsigned int bit = flipped ? col : 7 - col;
+				uint8_t color = ((sprite_shiftL[i] >> bit) & 1) | (((sprite_shiftH[i] >> bit) & 1) << 1);
+				uint8_t &pixel = SPRline[x + col];
+				if(color == 0 || pixel != 0 || (x + col < 8 && !showleftSpr)) continue;
+				pixel = ((spriteL[i] & 3) << 2) | color;
+				if((spriteL[i] & 0x20) == 0) pixel |= 0x10;
+				if(i == 0 && spr0onLine) pixel |= 0x20;
+			}
+			//Counters have run out and the data has been shifted out by dot 256
+			unsigned int shifts = 256 - x;
+			if(shifts >= 8) {
+				sprite_shiftL[i] = sprite_shiftH[i] = 0;
+			}
+			else if(flipped) {
+				sprite_shiftL[i] >>= shifts;
+				sprite_shiftH[i] >>= shifts;
+			}
+			else {
+				sprite_shiftL[i] <<= shifts;
+				sprite_shiftH[i] <<= shifts;
+			}
+			spriteCounter[i] = 0;
+		}
+	}
+
+	//Visible part of the background line, with masking applied
+	uint8_t *BGvisible = &BGline[fineXscroll];
+	if(!showBG)
+		std::fill(BGvisible, BGvisible + 256, 0);
+	else if(!showleftBG)
+		std::fill(BGvisible, BGvisible + 8, 0);
+
+	std::array<uint8_t, 256> pixelColors;
+	int spr0x = compositeLine(BGvisible, SPRline.data(), pixelColors.data());
+	if(spr0x >= 0 && spr0x < 255)
+		spr0hit = true;
+
+	std::array<uint8_t, 32> palette;
+	for(unsigned int i = 0; i < 32; ++i)
+		palette[i] = getPalette(0x3F00 + i);
+	uint8_t *line = &pixelMap[scanline*256];
+	for(unsigned int x = 0; x < 256; ++x)
+		line[x] = palette[pixelColors[x]];
+	outputPixels(scanline*256, 256);
+
+	//Sprite evaluation for the next line, done at dots 1 and 65
+	oam_sec.fill(0xFF);
+	evaluateSprites();
+}
+
+int PPU::compositeLine(const uint8_t *BG, const uint8_t *SPR, uint8_t *out)
+{
+	//Priority mux of renderPixel() for a whole line
+	//BG holds background palette indices (0 when masked), SPR the sprite line from renderScanline()
+	//Writes palette RAM indices to out and returns the first x where sprite 0 hits, or -1
+	int spr0x = -1;
+	unsigned int x = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i colorMask = _mm_set1_epi8(0x0F);
+	const __m128i frontMask = _mm_set1_epi8(0x10);
+	const __m128i spr0Mask = _mm_set1_epi8(0x20);
+	const __m128i lowBits = _mm_set1_epi8(0x03);
+	for(; x < 256; x += 16) {
+		__m128i bg = _mm_loadu_si128((const __m128i*)(BG + x));
+		__m128i spr = _mm_loadu_si128((const __m128i*)(SPR + x));
+		__m128i bgClear = _mm_cmpeq_epi8(bg, zero);
+		__m128i front = _mm_cmpeq_epi8(_mm_and_si128(spr, frontMask), frontMask);
+		//Sprite color + 16 if the background is clear or the sprite is in front
+		__m128i useSpr = _mm_or_si128(bgClear, front);
+		__m128i sprColor = _mm_or_si128(_mm_and_si128(spr, colorMask), frontMask);
+		__m128i pixel = _mm_or_si128(_mm_and_si128(useSpr, sprColor), _mm_andnot_si128(useSpr, bg));
+		//Set to universal background color
+		__m128i clear = _mm_cmpeq_epi8(_mm_and_si128(pixel, lowBits), zero);
+		_mm_storeu_si128((__m128i*)(out + x), _mm_andnot_si128(clear, pixel));
+
+		__m128i hit = _mm_andnot_si128(bgClear, _mm_cmpeq_epi8(_mm_and_si128(spr, spr0Mask), spr0Mask));
+		int hitMask = _mm_movemask_epi8(hit);
+		if(hitMask != 0 && spr0x < 0)
+			spr0x = x + __builtin_ctz(hitMask);
+	}
+#endif
+	for(; x < 256; ++x) {
+		uint8_t pixelColor;
+		if(BG[x] == 0 || (SPR[x] & 0x10))
+			pixelColor = (SPR[x] & 0x0F) + 16;
+		else
+			pixelColor = BG[x];
+		if((pixelColor & 3) == 0) pixelColor = 0; //Set to universal background color
+		out[x] = pixelColor;
+
+		if(spr0x < 0 && (SPR[x] & 0x20) && BG[x] != 0)
+			spr0x = x;
+	}
+	return spr0x;
+}
+
+void PPU::renderPixel()
 {
 	uint8_t BGpixelColor, SPRpixelColor, pixelColor; //Which color to use from palette
 	BGpixelColor = SPRpixelColor = pixelColor = 0;
@@ -635,6 +905,7 @@ void renderPixel()
 			//TODO allow feature for color to be chosen by current VRAM address
 			pixelMap[scanline*256 + dot - 1] = getPalette(0x3F00 + (uint16_t)pixelColor);
 		}
+		outputPixels(scanline*256 + dot - 1, 1);
 	}
 	
 	if(dot > 0 && dot < 337 && (dot < 257 || dot > 320)) {
@@ -646,7 +917,7 @@ void renderPixel()
 	}
 }
 
-void incrementHorz()
+void PPU::incrementHorz()
 {
 	//Will wrap around when hitting edge of nametable space
 	++currVRAM_addr.coarseX;
@@ -654,7 +925,7 @@ void incrementHorz()
 		currVRAM_addr.value ^= 0x0400; //Swap NT bit
 }
 
-void incrementVert()
+void PPU::incrementVert()
 {
 	++currVRAM_addr.fineY;
 	if(currVRAM_addr.fineY == 0) { //Overflows into coarseY
@@ -669,51 +940,55 @@ void incrementVert()
 	}
 }
 
-std::array<std::array<uint8_t, 16*16*64>, 2> getPatternTableBuffers() //Used in displaying pattern tables for debugging
+uint8_t PPU::getEmphasis()
+{
+	return emphasis >> 6;
+}
+
+void PPU::setOutputBuffer(uint32_t *buffer, const std::array<uint32_t, 512> &palette)
+{
+	outputBuffer = buffer;
+	outputPalette = palette;
+}
+
+void PPU::outputPixels(unsigned int start, unsigned int count)
+{
+	//Colors depend on the emphasis bits at the time each pixel is drawn, so this follows pixelMap
+	if(outputBuffer == nullptr) return;
+	const uint32_t *palette = &outputPalette[emphasis];
+	for(unsigned int i = start; i < start + count; ++i)
+		outputBuffer[i] = palette[pixelMap[i] & 0x3F];
+}
+
+std::array<std::array<uint8_t, 16*16*64>, 2> PPU::getPatternTableBuffers() //Used in displaying pattern tables for debugging
 {
 	std::array<uint8_t,4> palette;
 	for(int i=0; i<4; ++i)
 		palette[i] = getPalette(i);
 	
 	std::array<std::array<uint8_t, 16*16*64>, 2> PTpixelmap;
-	uint16_t addr, tilerowL, tilerowH;
-	for(int pixelRow=0; pixelRow<16*8; ++pixelRow) {
-		for(int tileCol=0; tileCol<16; ++tileCol) {
-			addr = ((pixelRow/8) << 8) | (tileCol << 4) | (pixelRow % 8);
-			tilerowL = GAMEPAK::PPUmemGet(addr, true);
-			tilerowH = GAMEPAK::PPUmemGet(addr+8, true);
-			for(int pixelCol=0; pixelCol<8; ++pixelCol) {
-				//uint8_t value = (((tilerowH >> (7-pixelCol))&1) << 1) | ((tilerowL >> (7-pixelCol))&1);
-				uint8_t value = palette[(((tilerowH >> (7-pixelCol))&1) << 1) | ((tilerowL >> (7-pixelCol))&1)];
-				PTpixelmap[0][pixelRow*16*8+tileCol*8+pixelCol] = value;
-			}
-		}
-	}
-	for(int pixelRow=0; pixelRow<16*8; ++pixelRow) {
-		for(int tileCol=0; tileCol<16; ++tileCol) {
-			addr = (((pixelRow/8) << 8) | (tileCol << 4) | (pixelRow % 8)) + 0x1000;
-			tilerowL = GAMEPAK::PPUmemGet(addr, true);
-			tilerowH = GAMEPAK::PPUmemGet(addr+8, true);
-			for(int pixelCol=0; pixelCol<8; ++pixelCol) {
-				uint8_t value = palette[(((tilerowH >> (7-pixelCol))&1) << 1) | ((tilerowL >> (7-pixelCol))&1)];
-				PTpixelmap[1][pixelRow*16*8+tileCol*8+pixelCol] = value;
+	for(int table=0; table<2; ++table) {
+		for(int pixelRow=0; pixelRow<16*8; ++pixelRow) {
+			for(int tileCol=0; tileCol<16; ++tileCol) {
+				uint16_t addr = (table << 12) | ((pixelRow/8) << 8) | (tileCol << 4) | (pixelRow % 8);
+				std::array<uint8_t, 8> row = tileRow(addr);
+				for(int pixelCol=0; pixelCol<8; ++pixelCol)
+					PTpixelmap[table][pixelRow*16*8+tileCol*8+pixelCol] = palette[row[pixelCol]];
 			}
 		}
 	}
 	return PTpixelmap;
 }
 
-bool isframeReady() {
+bool PPU::isframeReady() {
 	return frameReady;
 }
 
-void setframeReady(bool set) {
+void PPU::setframeReady(bool set) {
 	frameReady = set;
 }
 
-void setBusAddr(uint16_t addr) {
+void PPU::setBusAddr(uint16_t addr) {
 	busAddress = addr;
-	GAMEPAK::PPUbusAddrChanged(addr);
+	console.gamepak.PPUbusAddrChanged(addr);
 }
-
-}
\ No newline at end of file
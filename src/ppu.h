@@ -2,33 +2,144 @@
 
 #include <stdint.h>
 #include <array>
+#include <vector>
+#include "utils.h"
 
-namespace PPU {
-
-extern unsigned int scanline;
-extern unsigned int dot; //Dots are also called cycles and can be considered the pixel column
-extern unsigned long frame;
-extern std::array<uint8_t, 240*256> pixelMap;
-extern uint16_t addressBus;
-
-void powerOn();
-void reset();
-void step();
-
-uint8_t regGet(uint16_t addr, bool peek = false);
-void regSet(uint16_t addr, uint8_t val);
-
-uint8_t getPalette(uint16_t addr);
-void setPalette(uint16_t addr, uint8_t val);
-void renderFrameStep();
-void spriteEval();
-void renderPixel();
-void incrementHorz();
-void incrementVert();
-uint8_t* getPixelMap();
-std::array<std::array<uint8_t, 16*16*64>, 2> getPatternTableBuffers();
-bool isframeReady();
-void setframeReady(bool set);
-void setBusAddr(uint16_t addr);
-
-}
+class Console;
+
+class PPU {
+	public:
+	explicit PPU(Console &console) : console(console) {}
+
+	unsigned int scanline;
+	unsigned int dot; //Dots are also called cycles and can be considered the pixel column
+	unsigned long frame;
+	std::array<uint8_t, 240*256> pixelMap = {0};
+
+	void powerOn();
+	void reset();
+	void step();
+	void run(unsigned int dots);
+	unsigned int dotsToNextEvent();
+
+	uint8_t regGet(uint16_t addr, bool peek = false);
+	void regSet(uint16_t addr, uint8_t val);
+
+	uint8_t getPalette(uint16_t addr);
+	void setPalette(uint16_t addr, uint8_t val);
+	void CHRwritten(uint16_t addr);
+	//Also write each pixel to buffer (256x240) as palette[emphasis << 6 | color], where emphasis is PPUMASK bits 5-7
+	//Greyscale is already applied to color. Pass nullptr to stop
+	void setOutputBuffer(uint32_t *buffer, const std::array<uint32_t, 512> &palette);
+	uint8_t getEmphasis(); //PPUMASK bits 5-7
+	std::array<std::array<uint8_t, 16*16*64>, 2> getPatternTableBuffers();
+	bool isframeReady();
+	void setframeReady(bool set);
+
+	private:
+	Console &console;
+
+	unsigned long long ppuClock;
+	bool frameReady;
+
+	//Optional 32-bit copy of pixelMap, see setOutputBuffer
+	uint32_t *outputBuffer = nullptr;
+	std::array<uint32_t, 512> outputPalette;
+	uint16_t emphasis;	//PPUMASK emphasis bits as an offset into outputPalette
+
+
+	////////////////////////////////////////////////////
+	/////Internal registers, memory, and flags//////////
+	////////////////////////////////////////////////////
+
+	struct VRAM {
+		union {
+			uint16_t value;
+			BitWorker<0, 5, uint16_t> coarseX;
+			BitWorker<5, 5, uint16_t> coarseY;
+			BitWorker<10, 2, uint16_t> NTsel;
+			BitWorker<12, 3, uint16_t> fineY;
+			BitWorker<8, 6, uint16_t> addrWrite1;
+			BitWorker<14, 1, uint16_t> bit14;
+			BitWorker<0, 8, uint16_t> addrWrite2;
+			BitWorker<10, 1, uint16_t> bit10;
+			BitWorker<11, 4, uint16_t> upperY;
+		};
+	}  currVRAM_addr, tempVRAM_addr;
+
+	//uint16_t currVRAM_addr, tempVRAM_addr; //v and t in nesdev wiki
+	uint8_t fineXscroll;	//x in nesdev wiki
+	bool writeToggle;		//w in nesdev wiki
+	uint16_t BGtiledata_upper, BGtiledata_lower;
+	uint8_t BGattri_upper, BGattri_lower;
+	uint16_t busAddress;
+
+	//Background latches and shift registers
+	uint8_t NTlatch, ATlatch, BGLlatch, BGHlatch;
+	uint16_t ATshiftL, ATshiftH;
+	uint16_t BGshiftL, BGshiftH;
+	uint16_t sprAddr;
+
+	//Sprite memory, latches, shift registers, and counters
+	std::array<uint8_t, 256> oam_data;
+	std::array<uint8_t, 32> oam_sec;
+	std::array<uint8_t, 8> sprite_shiftL;
+	std::array<uint8_t, 8> sprite_shiftH;
+	std::array<uint8_t, 8> spriteL;
+	std::array<uint8_t, 8> spriteCounter;
+	bool spr0onNextLine, spr0onLine;
+
+	uint8_t VRAM_buffer;
+	std::array<uint8_t, 32> paletteRAM; //Internal palette control RAM. Can't be mapped
+
+	//PPU data bus - used for open bus behavior
+	uint8_t ioBus;
+
+	//PPUCTRL flags
+	//nametable select modifies part of tempVRAM_addr
+	bool NMIenable, spriteSize, backgroundTileSel, spriteTileSel, incrementMode;
+
+	//PPUMASK
+	bool greyscale, showleftBG, showleftSpr, showBG, showSpr, emphRed, emphGrn, emphBlu;
+	bool rendering;
+
+	//PPUSTATUS
+	bool sprOverflow, spr0hit, vblank;
+	unsigned long long PPUSTATUS_read_on_cycle = 0;
+
+	//OAMADDR
+	uint8_t OAMaddr;
+
+	//First line from each one on whose sprite evaluation can set sprOverflow, or 262 for none
+	//Worked out again after OAM or the sprite size changes
+	std::array<uint16_t, 263> nextOverflowLine;
+	bool overflowLinesValid = false;
+
+	//Decoded pattern tables, one entry per 1KB CHR bank (see GAMEPAK::CHRbank)
+	//Tiles are decoded the first time they're drawn and again after a write to their CHR-RAM
+	struct TileBank {
+		std::array<bool, 64> decoded;
+		std::array<std::array<uint8_t, 8>, 64*8> rows;	//Color of each pixel in a tile row, left to right
+	};
+	std::vector<TileBank> tileCache;
+
+	unsigned int dotsToSprite0Hit(unsigned int pos);
+	unsigned int dotsToOverflowCheck(unsigned int pos);
+	void renderFrameStep();
+	void fetchNT();
+	void fetchAT();
+	uint16_t BGpatternAddr();
+	void fetchBGlow();
+	void fetchBGhigh();
+	std::array<uint8_t, 8> tileRow(uint16_t addr);
+	void loadShiftRegisters();
+	void spriteEval();
+	void evaluateSprites();
+	void renderScanline();
+	static int compositeLine(const uint8_t *BG, const uint8_t *SPR, uint8_t *out);
+	void renderPixel();
+	void incrementHorz();
+	void incrementVert();
+	void outputPixels(unsigned int start, unsigned int count);
+	void setBusAddr(uint16_t addr);
+};
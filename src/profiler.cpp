@@ -0,0 +1,151 @@
+#include "profiler.h"
+#include "cpu.h"
+#include "gamepak.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <map>
+#include <memory>
+
+namespace PROFILER {
+
+struct Counters {
+	uint64_t instructions;
+	uint64_t cycles;
+};
+
+//One flat table per PRG bank, indexed by PC. Allocated the first time code runs from a bank
+std::vector<std::unique_ptr<std::array<Counters, 0x10000>>> banks;
+std::array<Counters, 256> opcodes;
+
+//Shadow call stack. Frames are entered by JSR, BRK and interrupts, and left once SP is back to
+//where it was at the call. Code which drops return addresses or jumps through RTS still unwinds
+struct Frame {
+	uint32_t location;	//PRG bank << 16 | address
+	uint8_t SP;
+};
+const size_t MAX_DEPTH = 256;
+std::vector<Frame> stack;
+std::map<std::vector<uint32_t>, uint64_t> stackCycles;
+uint64_t pendingCycles;	//Cycles spent in the current stack since it last changed
+const GAMEPAK *cartridge = nullptr;
+
+uint32_t location(uint16_t addr)
+{
+	return cartridge->PRGbank(addr) << 16 | addr;
+}
+
+void flushStack()
+{
+	if(pendingCycles == 0) return;
+	std::vector<uint32_t> key;
+	key.reserve(stack.size());
+	for(const Frame &frame : stack)
+		key.push_back(frame.location);
+	stackCycles[key] += pendingCycles;
+	pendingCycles = 0;
+}
+
+void reset(const GAMEPAK &gamepak)
+{
+	cartridge = &gamepak;
+	banks.clear();
+	opcodes.fill({0, 0});
+	stack.clear();
+	stackCycles.clear();
+	pendingCycles = 0;
+}
+
+void instruction(uint16_t PC, uint8_t opcode, unsigned int cycles)
+{
+	unsigned int bank = cartridge->PRGbank(PC);
+	if(bank >= banks.size())
+		banks.resize(bank + 1);
+	if(!banks[bank]) {
+		banks[bank] = std::make_unique<std::array<Counters, 0x10000>>();
+		banks[bank]->fill({0, 0});
+	}
+	Counters &counters = (*banks[bank])[PC];
+	++counters.instructions;
+	counters.cycles += cycles;
+	++opcodes[opcode].instructions;
+	opcodes[opcode].cycles += cycles;
+	pendingCycles += cycles;
+}
+
+void call(uint16_t target, uint8_t SP, unsigned int cycles)
+{
+	flushStack();
+	if(stack.size() == MAX_DEPTH)
+		stack.erase(stack.begin());
+	stack.push_back({location(target), SP});
+	pendingCycles += cycles;
+}
+
+void ret(uint8_t SP)
+{
+	flushStack();
+	while(!stack.empty() && stack.back().SP <= SP)
+		stack.pop_back();
+}
+
+bool openOutput(std::ofstream &file, std::string filename)
+{
+	file.open(filename, std::ios::trunc);
+	if(file.fail()) {
+		std::cerr << "Unable to open profile file " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool writeCSV(std::string filename)
+{
+	std::ofstream file;
+	if(!openOutput(file, filename)) return false;
+	file << "bank,pc,instructions,cycles\n";
+	for(unsigned int bank = 0; bank < banks.size(); ++bank) {
+		if(!banks[bank]) continue;
+		for(unsigned int PC = 0; PC < 0x10000; ++PC) {
+			const Counters &counters = (*banks[bank])[PC];
+			if(counters.instructions == 0) continue;
+			file << std::dec << bank << ",$" << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << PC
+				<< "," << std::dec << counters.instructions << "," << counters.cycles << "\n";
+		}
+	}
+	return true;
+}
+
+bool writeOpcodeCSV(std::string filename)
+{
+	std::ofstream file;
+	if(!openOutput(file, filename)) return false;
+	file << "opcode,mnemonic,instructions,cycles\n";
+	for(unsigned int opcode = 0; opcode < 256; ++opcode) {
+		if(opcodes[opcode].instructions == 0) continue;
+		file << "$" << std::hex << std::uppercase << std::setfill('0') << std::setw(2) << opcode << ","
+			<< CPU::getMnemonic(opcode) << "," << std::dec << opcodes[opcode].instructions << ","
+			<< opcodes[opcode].cycles << "\n";
+	}
+	return true;
+}
+
+bool writeCollapsed(std::string filename)
+{
+	std::ofstream file;
+	if(!openOutput(file, filename)) return false;
+	flushStack();
+	for(const auto &[frames, cycles] : stackCycles) {
+		file << "reset";
+		for(uint32_t frame : frames) {
+			file << ";" << std::hex << std::uppercase << std::setfill('0') << std::setw(2) << (frame >> 16)
+				<< ":" << std::setw(4) << (frame & 0xFFFF);
+		}
+		file << " " << std::dec << cycles << "\n";
+	}
+	return true;
+}
+
+} //PROFILER
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+class GAMEPAK;
+
+//Guest code profiler
+//Counts instructions and cycles per (PRG bank, PC) and per opcode, and cycles per call stack
+//The CPU only calls in here when built with CPU_PROFILER (cmake -DCPU_PROFILER=ON)
+//There is one profile per process. It follows whichever console was last powered on
+namespace PROFILER {
+
+#ifdef CPU_PROFILER
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+void reset(const GAMEPAK &gamepak);	//Banks are numbered by this cartridge from now on
+void instruction(uint16_t PC, uint8_t opcode, unsigned int cycles);
+void call(uint16_t target, uint8_t SP, unsigned int cycles = 0);	//SP from before the return address is pushed
+void ret(uint8_t SP);	//SP after the return address is pulled
+
+//bank,pc,instructions,cycles
+bool writeCSV(std::string filename);
+//opcode,mnemonic,instructions,cycles
+bool writeOpcodeCSV(std::string filename);
+//One line per call stack, "reset;bank:addr;bank:addr cycles", for flamegraph.pl and similar
+bool writeCollapsed(std::string filename);
+
+} //PROFILER
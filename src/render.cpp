@@ -19,6 +19,26 @@ int init()
     return 0;
 }
 
+std::array<uint32_t, 512> buildARGBPalette()
+{
+    //Each emphasis bit (red, green, blue) darkens the other two components
+    const float attenuation = 0.816328f;
+    std::array<uint32_t, 512> table;
+    for(int emphasis=0; emphasis<8; ++emphasis) {
+        for(int i=0; i<0x40; ++i) {
+            uint32_t color = 0xFF000000;
+            for(int channel=0; channel<3; ++channel) {
+                float value = (NTSCkey[i] >> (16 - channel*8)) & 0xFF;
+                if(emphasis & ~(1 << channel) & 7)
+                    value *= attenuation;
+                color |= (uint32_t)value << (16 - channel*8);
+            }
+            table[emphasis*0x40 + i] = color;
+        }
+    }
+    return table;
+}
+
 uint8_t* convertNTSC2RGB(uint8_t* outputBuffer, uint8_t* inputPixelMap, int size)
 {
     for(int i=0; i<(size/3); ++i) {
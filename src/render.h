@@ -1,10 +1,13 @@
 #pragma once
 
 #include <stdint.h>
+#include <array>
 
 namespace RENDER {
 
 uint8_t* convertNTSC2RGB(uint8_t* outputBuffer, uint8_t* inputPixelMap, int size);
+//ARGB8888 color for each emphasis << 6 | palette index, for NES::setOutputBuffer
+std::array<uint32_t, 512> buildARGBPalette();
 int init();
 
 }
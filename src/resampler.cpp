@@ -0,0 +1,166 @@
+#include "resampler.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+const float INT16_SCALE = 32768.0f;
+
+int16_t toSample(float x, int16_t)
+{
+    return (int16_t)std::max(-32768.0f, std::min(32767.0f, std::round(x * INT16_SCALE)));
+}
+
+float toSample(float x, float)
+{
+    return x;
+}
+
+}
+
+Resampler::Resampler(int taps, double cutoff) :
+    taps((taps + 7) & ~7),
+    coeffs((PHASES + 1) * this->taps),
+    input(this->taps + MAX_INPUT)
+{
+    //Output at phase p of a sample lies between input taps/2-1 and taps/2 of its window
+    const int half = this->taps / 2;
+    for(int p = 0; p <= PHASES; ++p) {
+        float *row = &coeffs[p * this->taps];
+        double sum = 0;
+        for(int i = 0; i < this->taps; ++i) {
+            double x = (i - (half - 1)) - (double)p / PHASES;
+            double sinc = (x == 0) ? 1 : std::sin(PI * cutoff * x) / (PI * cutoff * x);
+            double window = 0.42 + 0.5 * std::cos(PI * x / half) + 0.08 * std::cos(2 * PI * x / half); //Blackman
+            row[i] = (std::abs(x) < half) ? (float)(sinc * window) : 0;
+            sum += row[i];
+        }
+        //Unity gain at DC for every phase, otherwise the phase steps show up as noise
+        for(int i = 0; i < this->taps; ++i)
+            row[i] = (float)(row[i] / sum);
+    }
+    setRatio(1.0);
+    clear();
+}
+
+void Resampler::clear()
+{
+    //Starts on a window of silence, so the first output lines up with the first input
+    std::fill(input.begin(), input.end(), 0.0f);
+    filled = taps / 2 - 1;
+    position = 0;
+}
+
+void Resampler::setRatio(double ratio)
+{
+    step = (uint64_t)(ratio * (1ULL << 32) + 0.5);
+}
+
+double Resampler::getRatio() const
+{
+    return (double)step / (1ULL << 32);
+}
+
+int Resampler::write(const int16_t *in, int count)
+{
+    count = std::min(count, (int)input.size() - filled);
+    for(int i = 0; i < count; ++i)
+        input[filled + i] = in[i] / INT16_SCALE;
+    filled += count;
+    return count;
+}
+
+int Resampler::write(const float *in, int count)
+{
+    count = std::min(count, (int)input.size() - filled);
+    std::copy(in, in + count, input.begin() + filled);
+    filled += count;
+    return count;
+}
+
+int Resampler::read(int16_t *out, int count)
+{
+    return readAs(out, count);
+}
+
+int Resampler::read(float *out, int count)
+{
+    return readAs(out, count);
+}
+
+template<typename T>
+int Resampler::readAs(T *out, int count)
+{
+    int produced = 0;
+    for(; produced < count; ++produced) {
+        size_t start = position >> 32;
+        if(start + taps > (size_t)filled) break;
+        uint32_t frac = (uint32_t)position;
+        int phase = frac >> (32 - PHASE_BITS);
+        float interp = (frac & ((1u << (32 - PHASE_BITS)) - 1)) / (float)(1u << (32 - PHASE_BITS));
+        const float *lo = &coeffs[phase * taps];
+        out[produced] = toSample(filter(&input[start], lo, lo + taps, interp), T());
+        position += step;
+    }
+    discardUsed();
+    return produced;
+}
+
+float Resampler::filter(const float *in, const float *lo, const float *hi, float interp) const
+{
+    //Both neighbouring phases at once, then blend the two results
+    float sumLo, sumHi;
+    int i = 0;
+#if defined(__AVX__)
+    __m256 accLo = _mm256_setzero_ps();
+    __m256 accHi = _mm256_setzero_ps();
+    for(; i < taps; i += 8) {
+        __m256 x = _mm256_loadu_ps(in + i);
+        accLo = _mm256_add_ps(accLo, _mm256_mul_ps(x, _mm256_loadu_ps(lo + i)));
+        accHi = _mm256_add_ps(accHi, _mm256_mul_ps(x, _mm256_loadu_ps(hi + i)));
+    }
+    __m128 lo4 = _mm_add_ps(_mm256_castps256_ps128(accLo), _mm256_extractf128_ps(accLo, 1));
+    __m128 hi4 = _mm_add_ps(_mm256_castps256_ps128(accHi), _mm256_extractf128_ps(accHi, 1));
+#elif defined(__SSE__)
+    __m128 lo4 = _mm_setzero_ps();
+    __m128 hi4 = _mm_setzero_ps();
+    for(; i < taps; i += 4) {
+        __m128 x = _mm_loadu_ps(in + i);
+        lo4 = _mm_add_ps(lo4, _mm_mul_ps(x, _mm_loadu_ps(lo + i)));
+        hi4 = _mm_add_ps(hi4, _mm_mul_ps(x, _mm_loadu_ps(hi + i)));
+    }
+#endif
+#if defined(__AVX__) || defined(__SSE__)
+    //Horizontal sums
+    lo4 = _mm_add_ps(lo4, _mm_movehl_ps(lo4, lo4));
+    hi4 = _mm_add_ps(hi4, _mm_movehl_ps(hi4, hi4));
+    lo4 = _mm_add_ss(lo4, _mm_shuffle_ps(lo4, lo4, 1));
+    hi4 = _mm_add_ss(hi4, _mm_shuffle_ps(hi4, hi4, 1));
+    sumLo = _mm_cvtss_f32(lo4);
+    sumHi = _mm_cvtss_f32(hi4);
+#else
+    sumLo = 0;
+    sumHi = 0;
+    for(; i < taps; ++i) {
+        sumLo += in[i] * lo[i];
+        sumHi += in[i] * hi[i];
+    }
+#endif
+    return sumLo + (sumHi - sumLo) * interp;
+}
+
+void Resampler::discardUsed()
+{
+    //Keeps the next output's window at the front
+    size_t used = std::min((size_t)(position >> 32), (size_t)filled);
+    if(used == 0) return;
+    std::copy(input.begin() + used, input.begin() + filled, input.begin());
+    filled -= used;
+    position -= (uint64_t)used << 32;
+}
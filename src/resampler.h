@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+//Polyphase windowed sinc resampler for mono audio
+//The filter is tabulated at PHASES offsets between input samples and interpolated in between, so the
+//ratio can be changed at any time, by any amount, without rebuilding anything. That lets it follow a
+//device rate, or be nudged sample by sample to steer a buffer's fill level
+class Resampler {
+    public:
+    //Taps are rounded up to a multiple of 8. Cutoff is a fraction of the input Nyquist frequency,
+    //and has to be below the output's too if the ratio is above 1
+    explicit Resampler(int taps = 32, double cutoff = 0.9);
+
+    void clear();
+    //Input samples consumed per output sample
+    void setRatio(double ratio);
+    double getRatio() const;
+
+    //Queues input. Returns how many samples fit
+    int write(const int16_t *in, int count);
+    int write(const float *in, int count);
+    //Filters up to count output samples from what has been written, in -1 to 1 for float
+    int read(int16_t *out, int count);
+    int read(float *out, int count);
+
+    private:
+    static const int PHASE_BITS = 8;
+    static const int PHASES = 1 << PHASE_BITS;
+    static const int MAX_INPUT = 4096;	//Queued input, past the filter's history
+
+    int taps;
+    std::vector<float> coeffs;	//PHASES+1 rows of taps. The last row is the first moved along one input
+    std::vector<float> input;
+    int filled;					//Samples in input, history included
+    uint64_t position = 0;		//Of the next output in input, 32.32
+    uint64_t step;
+
+    float filter(const float *in, const float *lo, const float *hi, float interp) const;
+    template<typename T> int readAs(T *out, int count);
+    void discardUsed();
+};
@@ -0,0 +1,35 @@
+#include "romimage.h"
+#include <algorithm>
+#include <fstream>
+
+std::unique_ptr<ROMImage> ROMImage::open(const std::string &filename)
+{
+    //Copied rather than mapped. A mapping of a file that's truncated while loaded faults on access,
+    //and one that's rewritten would no longer match the CRC the image is cached under
+    std::ifstream file(filename, std::ios::binary);
+    if(file.fail()) return nullptr;
+    std::vector<uint8_t> bytes;
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    if(size > 0) {
+        bytes.resize(size);
+        file.seekg(0, std::ios::beg);
+        file.read((char*)bytes.data(), size);
+        bytes.resize(file.gcount());
+    }
+    return std::unique_ptr<ROMImage>(new ROMImage(std::move(bytes)));
+}
+
+ROMImage::ROMImage(std::vector<uint8_t> bytes) :
+    bytes(std::move(bytes))
+{
+}
+
+ROMSpan ROMImage::span(size_t offset, size_t size) const
+{
+    ROMSpan span;
+    offset = std::min(offset, bytes.size());
+    span.data = bytes.data() + offset;
+    span.size = std::min(size, bytes.size() - offset);
+    return span;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+//Part of a ROM image, eg the PRG or CHR data. Doesn't own what it points at
+struct ROMSpan {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+};
+
+//A whole .nes file in memory. Mappers read their ROM straight out of it, so it has to outlive them
+//Files are read in one go rather than mapped, so the image can't change or vanish if the file does
+class ROMImage {
+    public:
+    //Null if the file can't be opened
+    static std::unique_ptr<ROMImage> open(const std::string &filename);
+    //Takes over a file that has already been read, or unpacked from somewhere
+    explicit ROMImage(std::vector<uint8_t> bytes);
+
+    ROMImage(const ROMImage&) = delete;
+    ROMImage &operator=(const ROMImage&) = delete;
+
+    const uint8_t *data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+    //Clamped to the end of the image
+    ROMSpan span(size_t offset, size_t size) const;
+
+    private:
+    std::vector<uint8_t> bytes;
+};
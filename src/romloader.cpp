@@ -0,0 +1,346 @@
+#include "romloader.h"
+#include <zlib.h>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+namespace ROMLOADER {
+
+namespace {
+
+const size_t MAX_ROM_SIZE = 64 << 20;	//Sizes come from archive headers, so don't trust them blindly
+
+struct ZipEntry {
+    std::string name;
+    uint16_t method;
+    uint32_t crc;
+    uint32_t compressedSize;
+    uint32_t size;
+    uint32_t localOffset;
+};
+
+//CRC32 and size of the .nes contents. Different ROMs can share one, so a hit also has to match byte for byte
+//Entries don't keep images alive. Once the last console using one lets go, the entry expires
+typedef std::pair<uint32_t, size_t> CacheKey;
+std::multimap<CacheKey, std::weak_ptr<const ROMImage>> cache;
+//Files already loaded, by canonical path, entry, modification time and size. A hit here returns the image
+//without reading or inflating anything. A file rewritten in place with the same size and time isn't noticed
+typedef std::tuple<std::string, std::string, long long, uintmax_t> FileKey;
+std::map<FileKey, std::weak_ptr<const ROMImage>> files;
+std::mutex cacheMutex;
+
+uint16_t read16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+uint32_t read32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+bool isNES(const uint8_t *data, size_t size) { return size >= 4 && memcmp(data, "NES\x1A", 4) == 0; }
+bool isGzip(const uint8_t *data, size_t size) { return size >= 18 && data[0] == 0x1F && data[1] == 0x8B; }
+bool isZip(const uint8_t *data, size_t size) { return size >= 22 && read32(data) == 0x04034B50; }
+
+bool hasExtension(const std::string &name, const std::string &ext)
+{
+    if(name.size() < ext.size()) return false;
+    return std::equal(ext.begin(), ext.end(), name.end() - ext.size(), [](char a, char b) {
+        return a == std::tolower((unsigned char)b);
+    });
+}
+
+uint32_t checksum(const uint8_t *data, size_t size)
+{
+    //zlib takes lengths as uInt
+    uLong crc = crc32(0L, Z_NULL, 0);
+    while(size > 0) {
+        uInt chunk = (uInt)std::min(size, (size_t)1 << 30);
+        crc = crc32(crc, data, chunk);
+        data += chunk;
+        size -= chunk;
+    }
+    return (uint32_t)crc;
+}
+
+//Caller holds cacheMutex. Entries of images nobody uses any more are removed on each insert, so neither
+//map grows past the number of ROMs in use
+template<typename Map>
+void dropExpired(Map &map)
+{
+    for(auto it = map.begin(); it != map.end();) {
+        if(it->second.expired()) it = map.erase(it);
+        else ++it;
+    }
+}
+
+//Caller holds cacheMutex. Drops any expired entries under the key on the way
+std::shared_ptr<const ROMImage> find(CacheKey key, const uint8_t *data)
+{
+    auto range = cache.equal_range(key);
+    for(auto it = range.first; it != range.second;) {
+        std::shared_ptr<const ROMImage> image = it->second.lock();
+        if(image == nullptr) {
+            it = cache.erase(it);
+            continue;
+        }
+        if(memcmp(image->data(), data, key.second) == 0) return image;
+        ++it;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const ROMImage> cached(CacheKey key, const uint8_t *data)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return find(key, data);
+}
+
+std::shared_ptr<const ROMImage> insert(CacheKey key, std::shared_ptr<const ROMImage> image)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    //If the same ROM was loaded from somewhere else, or by another thread meanwhile, that copy wins
+    if(auto existing = find(key, image->data())) return existing;
+    dropExpired(cache);
+    cache.emplace(key, image);
+    return image;
+}
+
+bool makeFileKey(const std::string &path, const std::string &entry, FileKey &key)
+{
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::canonical(path, error);
+    if(error) return false;
+    auto modified = std::filesystem::last_write_time(canonical, error);
+    if(error) return false;
+    uintmax_t size = std::filesystem::file_size(canonical, error);
+    if(error) return false;
+    key = FileKey(canonical.string(), entry, (long long)modified.time_since_epoch().count(), size);
+    return true;
+}
+
+std::shared_ptr<const ROMImage> cachedFile(const FileKey &key)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = files.find(key);
+    if(it == files.end()) return nullptr;
+    std::shared_ptr<const ROMImage> image = it->second.lock();
+    if(image == nullptr) files.erase(it);
+    return image;
+}
+
+void insertFile(const FileKey &key, const std::shared_ptr<const ROMImage> &image)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    dropExpired(files);
+    files[key] = image;
+}
+
+//Inflates exactly out.size() bytes. windowBits picks the framing, raw deflate for zip or gzip's own
+bool inflateInto(const uint8_t *in, size_t inSize, std::vector<uint8_t> &out, int windowBits)
+{
+    z_stream stream = {};
+    if(inflateInit2(&stream, windowBits) != Z_OK) return false;
+    stream.next_in = const_cast<Bytef*>(in);
+    stream.avail_in = (uInt)std::min(inSize, (size_t)UINT_MAX);
+    stream.next_out = out.data();
+    stream.avail_out = (uInt)out.size();
+    bool complete = (inflate(&stream, Z_FINISH) == Z_STREAM_END && stream.total_out == out.size());
+    inflateEnd(&stream);
+    return complete;
+}
+
+bool readZipDirectory(const uint8_t *data, size_t size, std::vector<ZipEntry> &entries)
+{
+    //End of central directory record. It's 22 bytes, followed by a comment of up to 64k
+    size_t end = size - 22;
+    while(read32(data + end) != 0x06054B50) {
+        if(end == 0 || size - end >= 22 + 0xFFFF) return false;
+        --end;
+    }
+    uint16_t count = read16(data + end + 10);
+    size_t pos = read32(data + end + 16);
+    for(int i = 0; i < count; ++i) {
+        if(pos + 46 > size || read32(data + pos) != 0x02014B50) return false;
+        const uint8_t *record = data + pos;
+        ZipEntry entry;
+        entry.method = read16(record + 10);
+        entry.crc = read32(record + 16);
+        entry.compressedSize = read32(record + 20);
+        entry.size = read32(record + 24);
+        entry.localOffset = read32(record + 42);
+        uint16_t nameLength = read16(record + 28);
+        if(pos + 46 + nameLength > size) return false;
+        entry.name.assign((const char*)record + 46, nameLength);
+        if(!entry.name.empty() && entry.name.back() != '/')
+            entries.push_back(entry);
+        pos += 46 + nameLength + read16(record + 30) + read16(record + 32);
+    }
+    return true;
+}
+
+std::shared_ptr<const ROMImage> decodeNES(const uint8_t *data, size_t size, std::shared_ptr<const ROMImage> file)
+{
+    CacheKey key(checksum(data, size), size);
+    if(auto image = cached(key, data)) return image;
+    //A file that was read can be kept as it is. Memory belongs to the caller, so that has to be copied
+    if(file == nullptr)
+        file = std::make_shared<const ROMImage>(std::vector<uint8_t>(data, data + size));
+    return insert(key, std::move(file));
+}
+
+std::shared_ptr<const ROMImage> decodeGzip(const uint8_t *data, size_t size)
+{
+    //The trailer has the CRC and size of what's inside. That isn't enough to tell ROMs apart, so it's
+    //inflated either way and only checked against the cache after
+    uint32_t crc = read32(data + size - 8);
+    uint32_t romSize = read32(data + size - 4);
+    CacheKey key(crc, romSize);
+
+    if(romSize > MAX_ROM_SIZE) {
+        std::cerr << "ROM in gzip file is too large" << std::endl;
+        return nullptr;
+    }
+    std::vector<uint8_t> bytes(romSize);
+    if(!inflateInto(data, size, bytes, 16 + MAX_WBITS) || checksum(bytes.data(), bytes.size()) != crc) {
+        std::cerr << "Damaged gzip file" << std::endl;
+        return nullptr;
+    }
+    return insert(key, std::make_shared<const ROMImage>(std::move(bytes)));
+}
+
+std::shared_ptr<const ROMImage> decodeZip(const uint8_t *data, size_t size, const std::string &name)
+{
+    std::vector<ZipEntry> entries;
+    if(!readZipDirectory(data, size, entries)) {
+        std::cerr << "Damaged zip file" << std::endl;
+        return nullptr;
+    }
+    auto entry = std::find_if(entries.begin(), entries.end(), [&name](const ZipEntry &e) {
+        return name.empty() ? hasExtension(e.name, ".nes") : e.name == name;
+    });
+    if(entry == entries.end()) {
+        std::cerr << "No ROM found in zip file" << std::endl;
+        return nullptr;
+    }
+    //Directory has the CRC too, same as gzip
+    CacheKey key(entry->crc, entry->size);
+
+    //Local header repeats the name and has its own extra field, so find where the data starts from it
+    size_t local = entry->localOffset;
+    if(local + 30 > size || read32(data + local) != 0x04034B50) {
+        std::cerr << "Damaged zip file" << std::endl;
+        return nullptr;
+    }
+    size_t start = local + 30 + read16(data + local + 26) + read16(data + local + 28);
+    if(start > size || entry->compressedSize > size - start) {
+        std::cerr << "Damaged zip file" << std::endl;
+        return nullptr;
+    }
+    if(entry->size > MAX_ROM_SIZE) {
+        std::cerr << "ROM in zip file is too large" << std::endl;
+        return nullptr;
+    }
+
+    std::vector<uint8_t> bytes(entry->size);
+    bool complete = false;
+    if(entry->method == 0) {
+        complete = (entry->compressedSize == entry->size);
+        if(complete) std::copy(data + start, data + start + entry->size, bytes.begin());
+    }
+    else if(entry->method == 8)
+        complete = inflateInto(data + start, entry->compressedSize, bytes, -MAX_WBITS);
+    else {
+        std::cerr << "Unsupported zip compression method " << entry->method << std::endl;
+        return nullptr;
+    }
+    if(!complete || checksum(bytes.data(), bytes.size()) != entry->crc) {
+        std::cerr << "Damaged zip file" << std::endl;
+        return nullptr;
+    }
+    return insert(key, std::make_shared<const ROMImage>(std::move(bytes)));
+}
+
+std::shared_ptr<const ROMImage> decode(const uint8_t *data, size_t size, const std::string &entry,
+                                       std::shared_ptr<const ROMImage> file)
+{
+    if(isNES(data, size)) return decodeNES(data, size, std::move(file));
+    if(isGzip(data, size)) return decodeGzip(data, size);
+    if(isZip(data, size)) return decodeZip(data, size, entry);
+    std::cerr << "Invalid file format" << std::endl;
+    return nullptr;
+}
+
+} //namespace
+
+std::shared_ptr<const ROMImage> load(const std::string &path, const std::string &entry)
+{
+    std::error_code error;
+    if(std::filesystem::is_directory(path, error)) {
+        std::string name = entry;
+        if(name.empty()) {
+            std::vector<std::string> roms = listROMs(path);
+            if(roms.empty()) {
+                std::cerr << "No ROM found in " << path << std::endl;
+                return nullptr;
+            }
+            name = roms.front();
+        }
+        return load((std::filesystem::path(path) / name).string());
+    }
+
+    FileKey key;
+    bool keyed = makeFileKey(path, entry, key);
+    if(keyed) {
+        if(auto image = cachedFile(key)) return image;
+    }
+
+    std::shared_ptr<const ROMImage> file = ROMImage::open(path);
+    if(file == nullptr) {
+        std::cerr << "Unable to open file" << std::endl;
+        return nullptr;
+    }
+    std::shared_ptr<const ROMImage> image = decode(file->data(), file->size(), entry, file);
+    if(image && keyed) insertFile(key, image);
+    return image;
+}
+
+std::shared_ptr<const ROMImage> load(const uint8_t *data, size_t size, const std::string &entry)
+{
+    return decode(data, size, entry, nullptr);
+}
+
+std::vector<std::string> listROMs(const std::string &path)
+{
+    std::vector<std::string> names;
+    std::error_code error;
+    if(std::filesystem::is_directory(path, error)) {
+        for(const auto &file : std::filesystem::directory_iterator(path, error)) {
+            std::string name = file.path().filename().string();
+            if(file.is_regular_file(error) &&
+               (hasExtension(name, ".nes") || hasExtension(name, ".zip") || hasExtension(name, ".gz")))
+                names.push_back(name);
+        }
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    std::unique_ptr<ROMImage> file = ROMImage::open(path);
+    std::vector<ZipEntry> entries;
+    if(file && isZip(file->data(), file->size()) && readZipDirectory(file->data(), file->size(), entries)) {
+        for(const ZipEntry &entry : entries)
+            if(hasExtension(entry.name, ".nes")) names.push_back(entry.name);
+    }
+    return names;
+}
+
+size_t cachedImages()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    dropExpired(cache);
+    dropExpired(files);
+    return cache.size();
+}
+
+} //ROMLOADER
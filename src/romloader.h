@@ -0,0 +1,31 @@
+#pragma once
+
+#include "romimage.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+//Finds ROM images in files, archives, directories or memory, and shares them between loads
+//.nes files are used as read. .gz files and .zip entries are inflated once, straight into the image
+//the mapper reads from. Every image is cached by the CRC32 and size of its .nes contents, and only
+//shared with a load whose bytes match it exactly, so the same ROM from any source is kept once
+//Loading a file again while it's unchanged (same path, entry, size and modification time) returns the
+//image without reading the file. Loads from memory are always checksummed and compared
+//The cache doesn't keep images alive itself, each one goes when the last console using it lets go
+namespace ROMLOADER {
+
+//Path can be a .nes, .gz or .zip file, or a directory. Entry picks a file in a .zip or directory,
+//otherwise the first one listROMs gives is used. Null, after printing why, if nothing loadable is found
+std::shared_ptr<const ROMImage> load(const std::string &path, const std::string &entry = "");
+//Same for a file that's already in memory. The bytes are copied if they need to be kept
+std::shared_ptr<const ROMImage> load(const uint8_t *data, size_t size, const std::string &entry = "");
+
+//ROM files in a .zip or directory, in the order load looks through them
+std::vector<std::string> listROMs(const std::string &path);
+
+//Images in the cache. It only refers to them, so this is how many are still in use by something
+size_t cachedImages();
+
+} //ROMLOADER
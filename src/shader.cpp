@@ -28,12 +28,26 @@ const char* fShaderCode = "#version 330 core\n"
 "FragColor = texture(texture1, TexCoord);\n"
 "}";
 
+//Same as Resources/palette.frag. Looks up 8-bit palette indices in a 64x8 palette texture,
+//one row per combination of emphasis bits
+const char* fPaletteShaderCode = "#version 330 core\n"
+"out vec4 FragColor;\n"
+"in vec2 TexCoord;\n"
+"uniform usampler2D indexTexture;\n"
+"uniform sampler2D paletteTexture;\n"
+"uniform int emphasis;\n"
+"void main()\n"
+"{\n"
+"uint index = texture(indexTexture, TexCoord).r & 0x3Fu;\n"
+"FragColor = texelFetch(paletteTexture, ivec2(int(index), emphasis), 0);\n"
+"}";
+
 Shader::Shader()
 {
 	//init();
 }
 
-void Shader::init()
+void Shader::init(bool paletteLookup)
 {
 	// compile shaders
 	unsigned int vertex, fragment;
@@ -55,7 +69,7 @@ void Shader::init()
 
 	// similiar for Fragment Shader
 	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
+	glShaderSource(fragment, 1, paletteLookup ? &fPaletteShaderCode : &fShaderCode, NULL);
 	glCompileShader(fragment);
 	// print compile errors if any
 	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
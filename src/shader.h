@@ -10,7 +10,8 @@ public:
 
 	// Constructor reads and builds the shader
 	Shader();
-	void init();
+	// paletteLookup builds the shader for palette index textures instead of RGB ones
+	void init(bool paletteLookup = false);
 
 	// Use/activate the shader
 	void use();
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+//Wait-free ring buffer for one producer thread and one consumer thread
+//Both sides move whole spans at a time, and neither ever blocks. The indices count up forever and
+//are masked on use, so capacity has to be a power of two. Each index sits on its own cache line,
+//next to the owning side's cached copy of the other one
+template<typename T>
+class SPSCRing {
+    public:
+    explicit SPSCRing(size_t capacity) : buffer(capacity), mask(capacity - 1) {}
+
+    size_t capacity() const { return buffer.size(); }
+
+    //Fill level. Exact from either thread for its own side, a snapshot from anywhere else
+    size_t size() const
+    {
+        return writeIdx.load(std::memory_order_acquire) - readIdx.load(std::memory_order_acquire);
+    }
+
+    //Producer. Copies up to count items and returns how many fit
+    size_t push(const T *data, size_t count)
+    {
+        size_t write = writeIdx.load(std::memory_order_relaxed);
+        if(buffer.size() - (write - cachedRead) < count)
+            cachedRead = readIdx.load(std::memory_order_acquire);
+        count = std::min(count, buffer.size() - (write - cachedRead));
+        copyIn(data, count, write);
+        writeIdx.store(write + count, std::memory_order_release);
+        return count;
+    }
+
+    //Consumer. Copies up to count items out and returns how many there were
+    size_t pop(T *data, size_t count)
+    {
+        size_t read = readIdx.load(std::memory_order_relaxed);
+        if(cachedWrite - read < count)
+            cachedWrite = writeIdx.load(std::memory_order_acquire);
+        count = std::min(count, cachedWrite - read);
+        copyOut(data, count, read);
+        readIdx.store(read + count, std::memory_order_release);
+        return count;
+    }
+
+    private:
+    static const size_t CACHE_LINE = 64;
+
+    std::vector<T> buffer;
+    size_t mask;
+    alignas(CACHE_LINE) std::atomic<size_t> writeIdx{0};
+    size_t cachedRead = 0;		//Producer's last look at readIdx
+    alignas(CACHE_LINE) std::atomic<size_t> readIdx{0};
+    size_t cachedWrite = 0;		//Consumer's last look at writeIdx
+
+    //Both copies are done in at most two pieces, split where the ring wraps
+    void copyIn(const T *data, size_t count, size_t index)
+    {
+        size_t start = index & mask;
+        size_t first = std::min(count, buffer.size() - start);
+        std::copy(data, data + first, buffer.begin() + start);
+        std::copy(data + first, data + count, buffer.begin());
+    }
+
+    void copyOut(T *data, size_t count, size_t index) const
+    {
+        size_t start = index & mask;
+        size_t first = std::min(count, buffer.size() - start);
+        std::copy(buffer.begin() + start, buffer.begin() + start + first, data);
+        std::copy(buffer.begin(), buffer.begin() + (count - first), data + first);
+    }
+};
@@ -0,0 +1,229 @@
+#include "trace.h"
+#include "cpu.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+
+namespace TRACE {
+
+const char FILE_MAGIC[8] = {'P','N','T','R','A','C','E','1'};
+const size_t BLOCK_RECORDS = 16384;	//512KB per disk write
+const size_t RING_BLOCKS = 64;		//32MB of records in flight
+
+std::vector<Record> ring;
+std::ofstream file;
+std::thread writer;
+std::mutex ringMutex;
+std::condition_variable blockReady, blockFree;
+size_t recordsWritten;	//Producer side, count of records put in the ring
+size_t blocksFilled;	//Blocks handed to the writer thread
+size_t blocksFlushed;	//Blocks the writer thread has put on disk
+bool stopping;
+bool tracing = false;
+
+void writerLoop()
+{
+	std::unique_lock<std::mutex> lock(ringMutex);
+	while(true) {
+		blockReady.wait(lock, []{ return stopping || blocksFilled > blocksFlushed; });
+		if(blocksFilled == blocksFlushed) break;	//Stopping with nothing pending
+
+		size_t block = blocksFlushed % RING_BLOCKS;
+		lock.unlock();
+		file.write(reinterpret_cast<const char*>(&ring[block * BLOCK_RECORDS]), BLOCK_RECORDS * sizeof(Record));
+		lock.lock();
+		++blocksFlushed;
+		blockFree.notify_one();
+	}
+}
+
+bool open(std::string filename)
+{
+	close();
+	file.open(filename, std::ios::binary | std::ios::trunc);
+	if(file.fail()) {
+		std::cerr << "Unable to open trace file " << filename << std::endl;
+		return false;
+	}
+	uint32_t header[2] = {sizeof(Record), 1};
+	file.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	ring.resize(BLOCK_RECORDS * RING_BLOCKS);
+	recordsWritten = blocksFilled = blocksFlushed = 0;
+	stopping = false;
+	writer = std::thread(writerLoop);
+	tracing = true;
+	return true;
+}
+
+void close()
+{
+	if(!tracing) return;
+	{
+		std::lock_guard<std::mutex> lock(ringMutex);
+		stopping = true;
+	}
+	blockReady.notify_one();
+	writer.join();
+
+	//Flush the partially filled block
+	size_t partial = recordsWritten - blocksFilled * BLOCK_RECORDS;
+	size_t block = blocksFilled % RING_BLOCKS;
+	file.write(reinterpret_cast<const char*>(&ring[block * BLOCK_RECORDS]), partial * sizeof(Record));
+	file.close();
+	ring.clear();
+	ring.shrink_to_fit();
+	tracing = false;
+}
+
+bool isOpen()
+{
+	return tracing;
+}
+
+void write(const Record &record)
+{
+	ring[recordsWritten % ring.size()] = record;
+	++recordsWritten;
+	if(recordsWritten % BLOCK_RECORDS == 0) {
+		std::unique_lock<std::mutex> lock(ringMutex);
+		++blocksFilled;
+		blockReady.notify_one();
+		//Block the emulator rather than drop records if the disk falls behind
+		blockFree.wait(lock, []{ return blocksFilled - blocksFlushed < RING_BLOCKS; });
+	}
+}
+
+int readHeader(std::istream &in)
+{
+	char magic[sizeof(FILE_MAGIC)];
+	uint32_t header[2];
+	in.read(magic, sizeof(magic));
+	in.read(reinterpret_cast<char*>(header), sizeof(header));
+	if(in.fail() || memcmp(magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+		std::cerr << "Not a plainNES trace file" << std::endl;
+		return 1;
+	}
+	if(header[0] != sizeof(Record)) {
+		std::cerr << "Unsupported trace record size: " << header[0] << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+void format(std::ostream &out, const Record &record)
+{
+	switch(record.type) {
+		case NMI_TRIGGERED:
+			out << "[NMI Triggered]\n";
+			return;
+		case IRQ_TRIGGERED:
+			out << "[IRQ Triggered]\n";
+			return;
+		case NMI_DURING_BRK:
+			out << "[NMI Interrupt during BRK]\n";
+			return;
+		case SPRITE_DMA_START:
+			out << "[Sprite DMA Start - Cycle: " << std::dec << record.cpuCycle << "]\n";
+			return;
+		case SPRITE_DMA_END:
+			out << "[Sprite DMA End - Cycle: " << std::dec << record.cpuCycle << "]\n";
+			return;
+		default:
+			break;
+	}
+
+	const char *opName = CPU::getMnemonic(record.opcode);
+	int addrL = record.operand[0];
+	int addrH = record.operand[1];
+	int actAddr = record.effectiveAddr;
+
+	out << std::hex << std::uppercase << std::setfill('0')
+		<< std::setw(4) << static_cast<int>(record.PC) << "  "
+		<< std::setw(2) << static_cast<int>(record.opcode) << " ";
+
+	switch (CPU::getAddressingMode(record.opcode)) {
+		case CPU::ABSOLUTE:
+			out << std::setw(2) << addrL << " " << std::setw(2) << addrH << "  " << opName
+				<< " $" << std::setw(4) << actAddr
+				<< "\t\t\t\t\t";
+			break;
+		case CPU::ABSOLUTEX:
+			out << std::setw(2) << addrL << " " << std::setw(2) << addrH << "  " << opName
+				<< " $" << std::setw(2) << addrH << std::setw(2) << addrL
+				<< ",X @ $" << std::setw(4) << actAddr
+				<< "\t\t\t";
+			break;
+		case CPU::ABSOLUTEY:
+			out << std::setw(2) << addrL << " " << std::setw(2) << addrH << "  " << opName
+				<< " $" << std::setw(2) << addrH << std::setw(2) << addrL
+				<< ",Y @ $" << std::setw(4) << actAddr
+				<< "\t\t\t";
+			break;
+		case CPU::ZEROPAGE:
+			out << std::setw(2) << addrL << "     " << opName
+				<< " $" << std::setw(2) << addrL
+				<< "\t\t\t\t\t\t";
+			break;
+		case CPU::ZEROPAGEX:
+			out << std::setw(2) << addrL << "     " << opName
+				<< " $" << std::setw(2) << addrL
+				<< ",X @ $" << std::setw(4) << actAddr
+				<< "\t\t\t";
+			break;
+		case CPU::ZEROPAGEY:
+			out << std::setw(2) << addrL << "     " << opName
+				<< " $" << std::setw(2) << addrL
+				<< ",Y @ $" << std::setw(4) << actAddr
+				<< "\t\t\t";
+			break;
+		case CPU::IMMEDIATE:
+			out << std::setw(2) << addrL << "     " << opName
+				<< " #$" << std::setw(2) << addrL
+				<< "\t\t\t\t\t";
+			break;
+		case CPU::RELATIVE:
+			out << std::setw(2) << addrL << "     " << opName
+				<< " $" << std::setw(2) << addrL
+				<< "\t\t\t\t\t\t";
+			break;
+		case CPU::IMPLICIT:
+			out << "       " << opName << "\t\t\t\t\t\t\t";
+			break;
+		case CPU::INDIRECT:
+			out << std::setw(2) << addrL << " " << std::setw(2) << addrH << "  " << opName
+				<< " $" << std::setw(2) << addrH << std::setw(2) << addrL
+				<< " @ $" << std::setw(4) << actAddr
+				<< "\t\t\t";
+			break;
+		case CPU::IDX_INDIRECT:
+			out << std::setw(2) << addrL << "     " << opName
+				<< " ($" << std::setw(2) << addrL
+				<< ",X) @ $" << std::setw(4) << actAddr
+				<< "\t\t\t";
+			break;
+		case CPU::INDIRECT_IDX:
+			out << std::setw(2) << addrL << "     " << opName
+				<< " ($" << std::setw(2) << addrL
+				<< "),Y @ $" << std::setw(4) << actAddr
+				<< "\t\t\t";
+			break;
+	}
+
+	out << "A:" << std::setw(2) << static_cast<int>(record.A)
+		<< " X:" << std::setw(2) << static_cast<int>(record.X)
+		<< " Y:" << std::setw(2) << static_cast<int>(record.Y)
+		<< " P:" << std::setw(2) << static_cast<int>(record.P)
+		<< " SP:" << std::setw(2) << static_cast<int>(record.SP)
+		<< " CYC:" << std::dec << std::setfill(' ') << std::setw(3) << record.dot
+		<< " SL:" << std::setw(3) << record.scanline
+		<< " CPUCyc:" << record.cpuCycle << "\n";
+}
+
+} //TRACE
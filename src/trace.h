@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <istream>
+#include <ostream>
+
+//Binary CPU trace
+//Records are buffered in a ring and written to disk in blocks by a background thread
+//Use the tracefmt tool to render a trace as text
+namespace TRACE {
+
+enum RecordType : uint8_t {
+	INSTRUCTION,
+	NMI_TRIGGERED,
+	IRQ_TRIGGERED,
+	NMI_DURING_BRK,
+	SPRITE_DMA_START,
+	SPRITE_DMA_END,
+};
+
+//Registers and PPU position are captured before the instruction executes
+//Event records only use type and cpuCycle
+struct Record {
+	uint64_t cpuCycle;
+	uint16_t PC;
+	uint16_t effectiveAddr;
+	uint16_t dot;
+	uint16_t scanline;
+	uint8_t type;
+	uint8_t opcode;
+	uint8_t operand[2];
+	uint8_t A;
+	uint8_t X;
+	uint8_t Y;
+	uint8_t P;
+	uint8_t SP;
+	uint8_t reserved[7];
+};
+static_assert(sizeof(Record) == 32, "Trace records are written to disk as-is");
+
+bool open(std::string filename);
+void close();
+bool isOpen();
+void write(const Record &record);
+
+int readHeader(std::istream &in);
+void format(std::ostream &out, const Record &record);
+
+} //TRACE
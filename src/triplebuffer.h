@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+
+//Lock-free hand-off of the latest value from one producer thread to one consumer thread
+//The producer fills back() and publishes it, the consumer picks up the newest published one.
+//Neither side ever waits, and values published faster than they're consumed are skipped
+template<typename T>
+class TripleBuffer {
+    public:
+    //Producer
+    T &back() { return buffers[backIdx]; }
+    void publish()
+    {
+        uint8_t previous = middle.exchange(backIdx | NEW_DATA, std::memory_order_acq_rel);
+        backIdx = previous & INDEX_MASK;
+    }
+
+    //Consumer. Returns true if something new was published since the last call
+    bool update()
+    {
+        if((middle.load(std::memory_order_relaxed) & NEW_DATA) == 0) return false;
+        uint8_t previous = middle.exchange(frontIdx, std::memory_order_acq_rel);
+        frontIdx = previous & INDEX_MASK;
+        return true;
+    }
+    const T &front() const { return buffers[frontIdx]; }
+
+    private:
+    static const uint8_t INDEX_MASK = 0x03;
+    static const uint8_t NEW_DATA = 0x04;
+
+    std::array<T, 3> buffers;
+    uint8_t backIdx = 0, frontIdx = 1;
+    std::atomic<uint8_t> middle{2};	//Index of the spare buffer, with NEW_DATA if it was just published
+};
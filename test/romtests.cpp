@@ -1,10 +1,19 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <set>
 #include <string>
+#include <thread>
+#include <vector>
 #include <zlib.h>
+#include "console.h"
 #include "nes.h"
+#include "render.h"
+#include "romloader.h"
 
 const uint32_t CRC_check = 0xCBF43926;
 
@@ -238,6 +247,200 @@ TEST_CASE( "MMC3 Test", "[!mayfail][notWorking]" ) {
     CHECK( getROM_CRC("roms/mmc3_test_2/rom_singles/6-MMC3_alt.nes", 0) == 0 );
 }
 
+//Rendering
+TEST_CASE( "ARGB Palette Emphasis", "[Working]" ) {
+    //Each emphasis bit (red, green, blue) darkens the other two components
+    RENDER::init();
+    std::array<uint32_t, 512> table = RENDER::buildARGBPalette();
+    auto darken = [](uint32_t color, int channels) {
+        uint32_t result = 0xFF000000;
+        for(int channel = 0; channel < 3; ++channel) {
+            float value = (color >> (16 - channel*8)) & 0xFF;
+            if(channels & (1 << channel)) value *= 0.816328f;
+            result |= (uint32_t)value << (16 - channel*8);
+        }
+        return result;
+    };
+    for(int i = 0; i < 0x40; ++i) {
+        CHECK( table[1 << 6 | i] == darken(table[i], 0x6) );
+        CHECK( table[3 << 6 | i] == darken(table[i], 0x7) );
+        CHECK( table[4 << 6 | i] == darken(table[i], 0x3) );
+        CHECK( table[7 << 6 | i] == darken(table[i], 0x7) );
+    }
+}
+
+TEST_CASE( "ARGB Output Buffer", "[Working]" ) {
+    RENDER::init();
+    std::array<uint32_t, 512> table = RENDER::buildARGBPalette();
+    std::vector<uint32_t> buffer(256*240);
+
+    //Emphasis stays the same all frame, so every pixel is the palette entry for it
+    {
+        Console console;
+        REQUIRE( console.loadROM("roms/cpu_dummy_reads/cpu_dummy_reads.nes") == 0 );
+        console.powerOn();
+        console.setOutputBuffer(buffer.data(), table);
+        while(console.getFrameNum() < 200 && console.running)
+            console.frameStep();
+        const uint8_t *pixelMap = console.getPixelMap();
+        unsigned int emphasis = console.getEmphasis();
+        unsigned int mismatches = 0;
+        for(unsigned int i = 0; i < buffer.size(); ++i)
+            if(buffer[i] != table[emphasis << 6 | pixelMap[i]]) ++mismatches;
+        CHECK( mismatches == 0 );
+    }
+
+    //full_palette changes emphasis while the frame is drawn, so each pixel has to match the entry for
+    //one of the emphasis values, and the frame has to use all of them. Emphasis 3, 5, 6 and 7 darken
+    //every channel and so give the same colors, which leaves 5 distinct sets of matching values
+    {
+        Console console;
+        REQUIRE( console.loadROM("roms/full_palette/full_palette.nes") == 0 );
+        console.powerOn();
+        console.setOutputBuffer(buffer.data(), table);
+        while(console.getFrameNum() < 100 && console.running)
+            console.frameStep();
+        const uint8_t *pixelMap = console.getPixelMap();
+        unsigned int mismatches = 0;
+        std::set<unsigned int> matchSets;
+        for(unsigned int i = 0; i < buffer.size(); ++i) {
+            unsigned int matching = 0;
+            for(unsigned int emphasis = 0; emphasis < 8; ++emphasis)
+                if(buffer[i] == table[emphasis << 6 | pixelMap[i]]) matching |= 1 << emphasis;
+            if(matching == 0) ++mismatches;
+            else if(matching != 0xFF) matchSets.insert(matching);
+        }
+        CHECK( mismatches == 0 );
+        CHECK( matchSets.size() == 5 );
+    }
+}
+
+//ROM loading
+TEST_CASE( "ROM Loaders", "[Working]" ) {
+    //The same ROM from every kind of source should run the same
+    CHECK( getROM_CRC("roms/loader/good/cpu_dummy_reads.nes.gz", 200) == 0x31a9c633 );
+    CHECK( getROM_CRC("roms/loader/good/cpu_dummy_reads.zip", 200) == 0x31a9c633 );
+    CHECK( getROM_CRC("roms/loader/good", 200) == 0x31a9c633 );
+
+    REQUIRE( NES::loadROM("roms/loader/good/cpu_dummy_reads.zip", "cpu_dummy_reads.nes") == 0 );
+    NES::powerOn();
+    CHECK( getROM_CRC(200) == 0x31a9c633 );
+
+    REQUIRE( NES::loadROM("roms/loader/good", "cpu_dummy_reads.zip") == 0 );
+    NES::powerOn();
+    CHECK( getROM_CRC(200) == 0x31a9c633 );
+
+    std::ifstream file("roms/cpu_dummy_reads/cpu_dummy_reads.nes", std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    REQUIRE( NES::loadROM(data.data(), data.size()) == 0 );
+    NES::powerOn();
+    CHECK( getROM_CRC(200) == 0x31a9c633 );
+}
+
+TEST_CASE( "ROM Loader Failures", "[Working]" ) {
+    CHECK( NES::loadROM("roms/loader/bad/missing.nes") != 0 );
+    CHECK( NES::loadROM("roms/loader/bad/damaged.zip") != 0 );
+    CHECK( NES::loadROM("roms/loader/bad/badcrc.gz") != 0 );
+    CHECK( NES::loadROM("roms/loader/bad/noroms.zip") != 0 );
+    CHECK( NES::loadROM("roms/loader/bad/notarom.bin") != 0 );
+    CHECK( NES::loadROM("roms/loader/good/cpu_dummy_reads.zip", "missing.nes") != 0 );
+    CHECK( NES::loadROM("roms/loader/good", "missing.nes") != 0 );
+    CHECK( NES::loadROM("roms/loader/empty_dir_does_not_exist") != 0 );
+}
+
+TEST_CASE( "ROM Loader Cache", "[Working]" ) {
+    //Same bytes from different sources share one image
+    auto nes = ROMLOADER::load("roms/cpu_dummy_reads/cpu_dummy_reads.nes");
+    auto gz = ROMLOADER::load("roms/loader/good/cpu_dummy_reads.nes.gz");
+    auto zip = ROMLOADER::load("roms/loader/good/cpu_dummy_reads.zip");
+    REQUIRE( nes != nullptr );
+    CHECK( (nes == gz) );
+    CHECK( (nes == zip) );
+
+    //Different bytes with the same CRC32 and size mustn't. XORing in these 5 bytes leaves the CRC unchanged
+    std::vector<uint8_t> first(0x4010 + 0x2000, 0);
+    const uint8_t header[] = {'N', 'E', 'S', 0x1A, 1, 1};
+    std::copy(header, header + sizeof(header), first.begin());
+    std::vector<uint8_t> second = first;
+    const uint8_t collide[] = {0x41, 0x06, 0x71, 0xDB, 0x01};
+    for(size_t i = 0; i < sizeof(collide); ++i)
+        second[0x100 + i] ^= collide[i];
+    REQUIRE( crc32(0L, first.data(), first.size()) == crc32(0L, second.data(), second.size()) );
+
+    auto firstImage = ROMLOADER::load(first.data(), first.size());
+    auto secondImage = ROMLOADER::load(second.data(), second.size());
+    REQUIRE( firstImage != nullptr );
+    REQUIRE( secondImage != nullptr );
+    CHECK( (firstImage != secondImage) );
+    CHECK( std::equal(first.begin(), first.end(), firstImage->data()) );
+    CHECK( std::equal(second.begin(), second.end(), secondImage->data()) );
+    CHECK( (ROMLOADER::load(second.data(), second.size()) == secondImage) );
+}
+
+TEST_CASE( "ROM Loader File Cache", "[Working]" ) {
+    //An unchanged file isn't read again. Shown by damaging a copy without changing its size or time
+    namespace fs = std::filesystem;
+    fs::path copy = fs::temp_directory_path() / "romtests_file_cache.nes.gz";
+    fs::copy_file("roms/loader/good/cpu_dummy_reads.nes.gz", copy, fs::copy_options::overwrite_existing);
+    auto image = ROMLOADER::load(copy.string());
+    REQUIRE( image != nullptr );
+
+    auto modified = fs::last_write_time(copy);
+    std::vector<uint8_t> junk(fs::file_size(copy), 0xFF);
+    std::ofstream(copy, std::ios::binary).write((const char*)junk.data(), junk.size());
+    fs::last_write_time(copy, modified);
+    CHECK( (ROMLOADER::load(copy.string()) == image) );
+
+    //A new modification time means it's read again, and now it isn't a ROM
+    fs::last_write_time(copy, modified + std::chrono::seconds(10));
+    CHECK( (ROMLOADER::load(copy.string()) == nullptr) );
+    fs::remove(copy);
+}
+
+TEST_CASE( "ROM Loader Cache Release", "[Working]" ) {
+    //The cache only refers to images. The default console still holds the ROM it loaded last, so count from there
+    size_t held = ROMLOADER::cachedImages();
+    std::weak_ptr<const ROMImage> gzImage, consoleImage;
+    {
+        auto gz = ROMLOADER::load("roms/loader/good/cpu_dummy_reads.nes.gz");
+        REQUIRE( gz != nullptr );
+        gzImage = gz;
+        Console console;
+        auto image = ROMLOADER::load("roms/branch_timing_tests/1.Branch_Basics.nes");
+        REQUIRE( image != nullptr );
+        consoleImage = image;
+        REQUIRE( console.loadROM(std::move(image)) == 0 );
+        CHECK( (ROMLOADER::cachedImages() >= 2) );
+    }
+    CHECK( ROMLOADER::cachedImages() == held );
+    CHECK( (consoleImage.expired()) );
+
+    //Once the default console moves on from its ROM, that goes too
+    REQUIRE( NES::loadROM("roms/branch_timing_tests/1.Branch_Basics.nes") == 0 );
+    CHECK( (gzImage.expired()) );
+    CHECK( ROMLOADER::cachedImages() == 1 );
+}
+
+//Consoles share nothing but cached ROM images, so several can run at once
+TEST_CASE( "Concurrent Consoles", "[Working]" ) {
+    auto run = [](std::string ROMfile, unsigned long atFrame, uint32_t &crc) {
+        Console console;
+        if(console.loadROM(ROMfile) != 0) return;
+        console.powerOn();
+        while(console.getFrameNum() < atFrame && console.running) {
+            console.frameStep();
+        }
+        crc = crc32(0L, console.getPixelMap(), 240*256);
+    };
+    uint32_t first = 0, second = 0;
+    std::thread firstThread(run, "roms/cpu_dummy_reads/cpu_dummy_reads.nes", 200, std::ref(first));
+    std::thread secondThread(run, "roms/branch_timing_tests/1.Branch_Basics.nes", 200, std::ref(second));
+    firstThread.join();
+    secondThread.join();
+    CHECK( first == 0x31a9c633 );
+    CHECK( second == 0x649bfc95 );
+}
+
 void loadROM(std::string ROMfile)
 {
     if(NES::loadROM(ROMfile) != 0) {
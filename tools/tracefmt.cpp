@@ -0,0 +1,38 @@
+#include "trace.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+
+//Renders a binary CPU trace written with --log as text
+//Usage: tracefmt log.bin [log.txt]
+int main(int argc, char *argv[])
+{
+	if(argc < 2) {
+		std::cerr << "Usage: tracefmt <trace file> [output file]" << std::endl;
+		return 1;
+	}
+
+	std::ifstream in(argv[1], std::ios::binary);
+	if(in.fail()) {
+		std::cerr << "Unable to open " << argv[1] << std::endl;
+		return 1;
+	}
+	if(TRACE::readHeader(in)) return 1;
+
+	std::ofstream outFile;
+	if(argc > 2) {
+		outFile.open(argv[2], std::ios::trunc);
+		if(outFile.fail()) {
+			std::cerr << "Unable to open " << argv[2] << std::endl;
+			return 1;
+		}
+	}
+	std::ostream &out = (argc > 2) ? outFile : std::cout;
+
+	TRACE::Record record;
+	while(in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+		TRACE::format(out, record);
+	}
+	out.flush();
+	return 0;
+}